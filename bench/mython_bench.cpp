@@ -0,0 +1,483 @@
+// Macro benchmark driver: runs every program of the corpus in a separate process, measures
+// wall time, peak RSS and the number of heap allocations, and compares them with a stored baseline.
+//
+// Usage: mython_bench <corpus_dir> <baseline_file> [--update] [--repeat N]
+//                     [--time-tolerance X] [--rss-tolerance X] [--alloc-tolerance X]
+//                     [--op-counts FILE]
+//
+// With --op-counts, which needs a build with MYTHON_OP_COUNTS, abstract operation counts
+// are compared with FILE exactly instead of checking measurements against the baseline.
+
+#include "fold.h"
+#include "lexer.h"
+#include "opcount.h"
+#include "parse.h"
+#include "range.h"
+#include "runtime.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+atomic<size_t> allocation_count{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t /*size*/) noexcept {
+    free(p);
+}
+
+namespace {
+
+// Program sources are kept in memory, so generated programs need no temporary files
+struct BenchProgram {
+    string name;
+    string source;
+};
+
+struct Measurement {
+    double wall_ms = 0.0;
+    long peak_rss_kb = 0;
+    size_t allocations = 0;
+};
+
+// Operation name -> count, see opcount::Write
+using OpCounts = map<string, uint64_t>;
+
+struct Options {
+    filesystem::path corpus_dir;
+    filesystem::path baseline_file;
+    bool update = false;
+    int repeat = 3;
+    double time_tolerance = 2.0;
+    double rss_tolerance = 1.25;
+    double alloc_tolerance = 1.05;
+    filesystem::path op_counts_file;
+};
+
+// Discards the output of print: the corpus is measured, not checked
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    streamsize xsputn(const char* /*s*/, streamsize n) override {
+        return n;
+    }
+};
+
+string ReadFile(const filesystem::path& path) {
+    ifstream input(path, ios::binary);
+    if (!input)
+    {
+        throw runtime_error("Cannot open "s + path.string());
+    }
+    ostringstream oss;
+    oss << input.rdbuf();
+    return oss.str();
+}
+
+// A flat script of global assignments, which stresses the lexer, the parser
+// and the global closure rather than method calls
+string GenerateFlatGlobals(size_t count) {
+    ostringstream oss;
+    oss << "g0 = 1\n";
+    for (size_t i = 1; i < count; ++i)
+    {
+        oss << 'g' << i << " = ";
+        if (i % 3 == 0)
+        {
+            oss << 'g' << i - 1 << " + " << i % 97 << '\n';
+        }
+        else
+        {
+            oss << i << '\n';
+        }
+    }
+    oss << "print g" << count - 1 << ", g" << count / 2 << '\n';
+    return oss.str();
+}
+
+vector<BenchProgram> LoadCorpus(const filesystem::path& dir) {
+    vector<BenchProgram> programs;
+    for (const auto& entry : filesystem::directory_iterator(dir))
+    {
+        if (entry.path().extension() == ".my")
+        {
+            programs.push_back({entry.path().stem().string(), ReadFile(entry.path())});
+        }
+    }
+    programs.push_back({"flat_globals"s, GenerateFlatGlobals(100'000)});
+    sort(programs.begin(), programs.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.name < rhs.name;
+    });
+    return programs;
+}
+
+void RunProgram(const string& source, ostream& output) {
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    fold::FoldConstants(*program);
+    range::ElideOverflowChecks(*program);
+
+    runtime::SimpleContext context{output};
+    runtime::Closure closure;
+    program->Execute(closure, context);
+}
+
+// Parses "<operation> <count>" lines. Operation names may contain spaces
+OpCounts ParseOpCounts(istream& input) {
+    OpCounts counts;
+    string line;
+    while (getline(input, line))
+    {
+        size_t space = line.rfind(' ');
+        if (space != string::npos)
+        {
+            counts[line.substr(0, space)] = stoull(line.substr(space + 1));
+        }
+    }
+    return counts;
+}
+
+// Runs the program in a child process, so that peak RSS is measured for this program alone.
+// Operation counts are stored to op_counts if it is not null
+Measurement MeasureOnce(const BenchProgram& program, OpCounts* op_counts = nullptr) {
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        throw runtime_error("pipe() failed"s);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        throw runtime_error("fork() failed"s);
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Measurement result;
+        int exit_code = 0;
+        try
+        {
+            NullBuffer null_buffer;
+            ostream output(&null_buffer);
+
+            size_t allocations_before = allocation_count.load();
+            opcount::Reset();
+            auto start = chrono::steady_clock::now();
+            RunProgram(program.source, output);
+            auto finish = chrono::steady_clock::now();
+
+            result.wall_ms = chrono::duration<double, milli>(finish - start).count();
+            result.allocations = allocation_count.load() - allocations_before;
+        }
+        catch (const exception& e)
+        {
+            cerr << program.name << ": " << e.what() << endl;
+            exit_code = 1;
+        }
+        [[maybe_unused]] auto written = write(fds[1], &result, sizeof(result));
+        ostringstream counts;
+        opcount::Write(counts);
+        written = write(fds[1], counts.str().data(), counts.str().size());
+        close(fds[1]);
+        _exit(exit_code);
+    }
+
+    close(fds[1]);
+    Measurement result;
+    bool received = read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    string counts;
+    char buffer[4096];
+    for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;)
+    {
+        counts.append(buffer, static_cast<size_t>(n));
+    }
+    close(fds[0]);
+    if (op_counts != nullptr)
+    {
+        istringstream counts_input(counts);
+        *op_counts = ParseOpCounts(counts_input);
+    }
+
+    int status = 0;
+    rusage usage{};
+    if (wait4(pid, &status, 0, &usage) < 0 || !received || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        throw runtime_error("Benchmark "s + program.name + " failed"s);
+    }
+    result.peak_rss_kb = usage.ru_maxrss;
+    return result;
+}
+
+// The fastest of several runs is the least noisy estimate of wall time
+Measurement Measure(const BenchProgram& program, int repeat) {
+    Measurement best = MeasureOnce(program);
+    for (int i = 1; i < repeat; ++i)
+    {
+        Measurement current = MeasureOnce(program);
+        best.wall_ms = min(best.wall_ms, current.wall_ms);
+        best.peak_rss_kb = min(best.peak_rss_kb, current.peak_rss_kb);
+        best.allocations = min(best.allocations, current.allocations);
+    }
+    return best;
+}
+
+map<string, Measurement> ReadBaseline(const filesystem::path& path) {
+    map<string, Measurement> baseline;
+    ifstream input(path);
+    string line;
+    while (getline(input, line))
+    {
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        istringstream iss(line);
+        string name;
+        Measurement m;
+        if (iss >> name >> m.wall_ms >> m.peak_rss_kb >> m.allocations)
+        {
+            baseline[name] = m;
+        }
+    }
+    return baseline;
+}
+
+void WriteBaseline(const filesystem::path& path, const map<string, Measurement>& measurements) {
+    ofstream output(path);
+    output << "# program wall_ms peak_rss_kb allocations\n";
+    for (const auto& [name, m] : measurements)
+    {
+        output << name << ' ' << fixed << setprecision(1) << m.wall_ms << ' ' << m.peak_rss_kb
+               << ' ' << m.allocations << '\n';
+    }
+}
+
+map<string, OpCounts> ReadOpCounts(const filesystem::path& path) {
+    map<string, OpCounts> op_counts;
+    ifstream input(path);
+    string line;
+    while (getline(input, line))
+    {
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        size_t space = line.find(' ');
+        istringstream rest(line.substr(space + 1));
+        auto counts = ParseOpCounts(rest);
+        op_counts[line.substr(0, space)].insert(counts.begin(), counts.end());
+    }
+    return op_counts;
+}
+
+void WriteOpCounts(const filesystem::path& path, const map<string, OpCounts>& op_counts) {
+    ofstream output(path);
+    output << "# program operation count\n";
+    for (const auto& [name, counts] : op_counts)
+    {
+        for (const auto& [operation, count] : counts)
+        {
+            output << name << ' ' << operation << ' ' << count << '\n';
+        }
+    }
+}
+
+// Every difference is reported: fewer operations mean the file should be re-recorded
+bool CheckOpCounts(const string& program, const OpCounts& counts, const OpCounts& base) {
+    bool ok = true;
+    OpCounts all = base;
+    all.insert(counts.begin(), counts.end());
+    for (const auto& [operation, unused] : all)
+    {
+        auto value_it = counts.find(operation);
+        auto base_it = base.find(operation);
+        uint64_t value = value_it == counts.end() ? 0u : value_it->second;
+        uint64_t base_value = base_it == base.end() ? 0u : base_it->second;
+        if (value != base_value)
+        {
+            cout << "OPCOUNT " << program << ": " << operation << ' ' << value << " (baseline "
+                 << base_value << ", delta " << showpos
+                 << static_cast<int64_t>(value) - static_cast<int64_t>(base_value) << noshowpos
+                 << ")\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool CheckMetric(const string& program, const string& metric, double value, double base,
+                 double tolerance) {
+    if (base > 0 && value > base * tolerance)
+    {
+        cout << "REGRESSION " << program << ": " << metric << ' ' << value << " exceeds baseline "
+             << base << " x " << tolerance << '\n';
+        return false;
+    }
+    return true;
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+    if (argc < 3)
+    {
+        throw runtime_error("Usage: mython_bench <corpus_dir> <baseline_file> [--update] [--repeat N] "
+                            "[--time-tolerance X] [--rss-tolerance X] [--alloc-tolerance X] "
+                            "[--op-counts FILE]"s);
+    }
+    Options options;
+    options.corpus_dir = argv[1];
+    options.baseline_file = argv[2];
+    for (int i = 3; i < argc; ++i)
+    {
+        string arg = argv[i];
+        auto next_value = [&]() {
+            if (i + 1 >= argc)
+            {
+                throw runtime_error("Missing value for "s + arg);
+            }
+            return stod(argv[++i]);
+        };
+        if (arg == "--update")
+        {
+            options.update = true;
+        }
+        else if (arg == "--repeat")
+        {
+            options.repeat = max(1, static_cast<int>(next_value()));
+        }
+        else if (arg == "--time-tolerance")
+        {
+            options.time_tolerance = next_value();
+        }
+        else if (arg == "--rss-tolerance")
+        {
+            options.rss_tolerance = next_value();
+        }
+        else if (arg == "--alloc-tolerance")
+        {
+            options.alloc_tolerance = next_value();
+        }
+        else if (arg == "--op-counts" && i + 1 < argc)
+        {
+            if (!opcount::kEnabled)
+            {
+                throw runtime_error("--op-counts needs a build with -DMYTHON_OP_COUNTS=ON"s);
+            }
+            options.op_counts_file = argv[++i];
+        }
+        else
+        {
+            throw runtime_error("Unknown option "s + arg);
+        }
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    try
+    {
+        Options options = ParseOptions(argc, argv);
+        map<string, Measurement> baseline = ReadBaseline(options.baseline_file);
+        map<string, Measurement> measurements;
+        const bool counting = !options.op_counts_file.empty();
+        map<string, OpCounts> base_op_counts;
+        if (counting)
+        {
+            base_op_counts = ReadOpCounts(options.op_counts_file);
+        }
+        map<string, OpCounts> op_counts;
+        bool ok = true;
+
+        cout << left << setw(24) << "program" << right << setw(12) << "wall_ms" << setw(14)
+             << "peak_rss_kb" << setw(14) << "allocations" << '\n';
+        for (const BenchProgram& program : LoadCorpus(options.corpus_dir))
+        {
+            Measurement m = Measure(program, options.repeat);
+            measurements[program.name] = m;
+            if (counting)
+            {
+                // Counts are deterministic, one more run is enough
+                MeasureOnce(program, &op_counts[program.name]);
+            }
+            cout << left << setw(24) << program.name << right << fixed << setprecision(1)
+                 << setw(12) << m.wall_ms << setw(14) << m.peak_rss_kb << setw(14) << m.allocations
+                 << '\n';
+
+            if (options.update)
+            {
+                continue;
+            }
+            if (counting)
+            {
+                // Counting slows the interpreter down, so measurements are not checked
+                ok = CheckOpCounts(program.name, op_counts[program.name], base_op_counts[program.name]) && ok;
+                continue;
+            }
+            auto it = baseline.find(program.name);
+            if (it == baseline.end())
+            {
+                cout << "no baseline for " << program.name << '\n';
+                continue;
+            }
+            const Measurement& base = it->second;
+            ok = CheckMetric(program.name, "wall_ms", m.wall_ms, base.wall_ms, options.time_tolerance) && ok;
+            ok = CheckMetric(program.name, "peak_rss_kb", m.peak_rss_kb, base.peak_rss_kb, options.rss_tolerance) && ok;
+            ok = CheckMetric(program.name, "allocations", m.allocations, base.allocations, options.alloc_tolerance) && ok;
+        }
+
+        if (options.update && counting)
+        {
+            WriteOpCounts(options.op_counts_file, op_counts);
+            cout << "operation counts written to " << options.op_counts_file << '\n';
+        }
+        else if (options.update)
+        {
+            WriteBaseline(options.baseline_file, measurements);
+            cout << "baseline written to " << options.baseline_file << '\n';
+        }
+        return ok ? 0 : 1;
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,446 @@
+#include "bigint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace bigint {
+
+namespace {
+
+// Magnitude as 32-bit limbs, the least significant first, without leading zero limbs
+using Limbs = vector<uint32_t>;
+
+constexpr uint64_t BASE = uint64_t{1} << 32u;
+// The largest power of ten that fits in a limb and its number of digits
+constexpr uint32_t DECIMAL_BASE = 1'000'000'000u;
+constexpr size_t DECIMAL_DIGITS = 9u;
+
+void Trim(Limbs& value) {
+    while (!value.empty() && value.back() == 0u)
+    {
+        value.pop_back();
+    }
+}
+
+Limbs FromUint64(uint64_t value) {
+    Limbs result = {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32u)};
+    Trim(result);
+    return result;
+}
+
+int CompareLimbs(const Limbs& lhs, const Limbs& rhs) {
+    if (lhs.size() != rhs.size())
+    {
+        return lhs.size() < rhs.size() ? -1 : 1;
+    }
+    for (size_t i = lhs.size(); i-- > 0u;)
+    {
+        if (lhs[i] != rhs[i])
+        {
+            return lhs[i] < rhs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Adds value multiplied by BASE^shift to target, which is long enough for the sum
+void AddShifted(Limbs& target, const Limbs& value, size_t shift) {
+    uint64_t carry = 0u;
+    size_t i = 0u;
+    for (; i < value.size(); ++i)
+    {
+        const uint64_t sum = uint64_t{target[i + shift]} + value[i] + carry;
+        target[i + shift] = static_cast<uint32_t>(sum);
+        carry = sum >> 32u;
+    }
+    for (; carry != 0u; ++i)
+    {
+        const uint64_t sum = uint64_t{target[i + shift]} + carry;
+        target[i + shift] = static_cast<uint32_t>(sum);
+        carry = sum >> 32u;
+    }
+}
+
+Limbs AddLimbs(const Limbs& lhs, const Limbs& rhs) {
+    Limbs result(max(lhs.size(), rhs.size()) + 1u);
+    copy(lhs.begin(), lhs.end(), result.begin());
+    AddShifted(result, rhs, 0u);
+    Trim(result);
+    return result;
+}
+
+// lhs must not be less than rhs
+Limbs SubtractLimbs(const Limbs& lhs, const Limbs& rhs) {
+    Limbs result(lhs);
+    int64_t borrow = 0;
+    for (size_t i = 0u; i < result.size(); ++i)
+    {
+        if (i >= rhs.size() && borrow == 0)
+        {
+            break;
+        }
+        const int64_t difference = int64_t{result[i]} - (i < rhs.size() ? int64_t{rhs[i]} : 0) - borrow;
+        result[i] = static_cast<uint32_t>(difference);
+        borrow = difference < 0 ? 1 : 0;
+    }
+    Trim(result);
+    return result;
+}
+
+Limbs MultiplySchoolbook(const Limbs& lhs, const Limbs& rhs) {
+    Limbs result(lhs.size() + rhs.size());
+    for (size_t i = 0u; i < lhs.size(); ++i)
+    {
+        uint64_t carry = 0u;
+        for (size_t j = 0u; j < rhs.size(); ++j)
+        {
+            const uint64_t product = uint64_t{lhs[i]} * rhs[j] + result[i + j] + carry;
+            result[i + j] = static_cast<uint32_t>(product);
+            carry = product >> 32u;
+        }
+        result[i + rhs.size()] = static_cast<uint32_t>(carry);
+    }
+    Trim(result);
+    return result;
+}
+
+// Returns the lower half limbs and the rest
+pair<Limbs, Limbs> Split(const Limbs& value, size_t half) {
+    const auto middle = value.begin() + static_cast<ptrdiff_t>(min(half, value.size()));
+    Limbs low(value.begin(), middle);
+    Trim(low);
+    return {move(low), Limbs(middle, value.end())};
+}
+
+Limbs MultiplyLimbs(const Limbs& lhs, const Limbs& rhs) {
+    if (min(lhs.size(), rhs.size()) < Integer::KARATSUBA_THRESHOLD)
+    {
+        return MultiplySchoolbook(lhs, rhs);
+    }
+    // lhs * rhs = high * BASE^2half + middle * BASE^half + low, where
+    // middle = (lhs_low + lhs_high)(rhs_low + rhs_high) - high - low
+    const size_t half = max(lhs.size(), rhs.size()) / 2u;
+    const auto [lhs_low, lhs_high] = Split(lhs, half);
+    const auto [rhs_low, rhs_high] = Split(rhs, half);
+    const Limbs low = MultiplyLimbs(lhs_low, rhs_low);
+    const Limbs high = MultiplyLimbs(lhs_high, rhs_high);
+    const Limbs sums = MultiplyLimbs(AddLimbs(lhs_low, lhs_high), AddLimbs(rhs_low, rhs_high));
+    const Limbs middle = SubtractLimbs(SubtractLimbs(sums, low), high);
+
+    Limbs result(lhs.size() + rhs.size() + 1u);
+    AddShifted(result, low, 0u);
+    AddShifted(result, middle, half);
+    AddShifted(result, high, 2u * half);
+    Trim(result);
+    return result;
+}
+
+// Divides value in place and returns the remainder
+uint32_t DivideBySmall(Limbs& value, uint32_t divisor) {
+    uint64_t remainder = 0u;
+    for (size_t i = value.size(); i-- > 0u;)
+    {
+        const uint64_t current = (remainder << 32u) | value[i];
+        value[i] = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+    Trim(value);
+    return static_cast<uint32_t>(remainder);
+}
+
+void MultiplyAddSmall(Limbs& value, uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (uint32_t& limb : value)
+    {
+        const uint64_t product = uint64_t{limb} * factor + carry;
+        limb = static_cast<uint32_t>(product);
+        carry = product >> 32u;
+    }
+    if (carry != 0u)
+    {
+        value.push_back(static_cast<uint32_t>(carry));
+    }
+}
+
+// Returns value * 2^shift in size limbs, shift is below 32
+Limbs ShiftLeft(const Limbs& value, unsigned shift, size_t size) {
+    Limbs result(size);
+    uint32_t carry = 0u;
+    for (size_t i = 0u; i < value.size(); ++i)
+    {
+        result[i] = (value[i] << shift) | carry;
+        carry = shift == 0u ? 0u : value[i] >> (32u - shift);
+    }
+    if (value.size() < size)
+    {
+        result[value.size()] = carry;
+    }
+    return result;
+}
+
+// Knuth's algorithm D, The Art of Computer Programming, vol. 2, 4.3.1. Returns the quotient,
+// divisor is not zero
+Limbs DivideLimbs(const Limbs& dividend, const Limbs& divisor) {
+    if (CompareLimbs(dividend, divisor) < 0)
+    {
+        return {};
+    }
+    if (divisor.size() == 1u)
+    {
+        Limbs quotient = dividend;
+        DivideBySmall(quotient, divisor[0]);
+        return quotient;
+    }
+
+    // Both are shifted so that the top limb of the divisor has its high bit set, which keeps
+    // the estimate of every quotient limb at most two above the right one
+    const size_t n = divisor.size();
+    const size_t m = dividend.size() - n;
+    const auto shift = static_cast<unsigned>(__builtin_clz(divisor.back()));
+    const Limbs v = ShiftLeft(divisor, shift, n);
+    Limbs u = ShiftLeft(dividend, shift, dividend.size() + 1u);
+    Limbs quotient(m + 1u);
+
+    for (size_t j = m + 1u; j-- > 0u;)
+    {
+        const uint64_t top = (uint64_t{u[j + n]} << 32u) | u[j + n - 1u];
+        uint64_t estimate = top / v[n - 1u];
+        uint64_t remainder = top % v[n - 1u];
+        while (estimate >= BASE || estimate * v[n - 2u] > ((remainder << 32u) | u[j + n - 2u]))
+        {
+            --estimate;
+            remainder += v[n - 1u];
+            if (remainder >= BASE)
+            {
+                break;
+            }
+        }
+
+        // u -= estimate * v, shifted by j limbs
+        int64_t borrow = 0;
+        uint64_t carry = 0u;
+        for (size_t i = 0u; i < n; ++i)
+        {
+            const uint64_t product = estimate * v[i] + carry;
+            carry = product >> 32u;
+            const int64_t difference = int64_t{u[i + j]} - static_cast<int64_t>(product & 0xFFFF'FFFFu) - borrow;
+            u[i + j] = static_cast<uint32_t>(difference);
+            borrow = difference < 0 ? 1 : 0;
+        }
+        const int64_t difference = int64_t{u[j + n]} - static_cast<int64_t>(carry) - borrow;
+        u[j + n] = static_cast<uint32_t>(difference);
+
+        // The estimate was one too large: add the divisor back
+        if (difference < 0)
+        {
+            --estimate;
+            carry = 0u;
+            for (size_t i = 0u; i < n; ++i)
+            {
+                const uint64_t sum = uint64_t{u[i + j]} + v[i] + carry;
+                u[i + j] = static_cast<uint32_t>(sum);
+                carry = sum >> 32u;
+            }
+            u[j + n] += static_cast<uint32_t>(carry);
+        }
+        quotient[j] = static_cast<uint32_t>(estimate);
+    }
+    Trim(quotient);
+    return quotient;
+}
+
+}  // namespace
+
+struct Integer::Parts {
+    bool negative = false;
+    Limbs limbs;
+};
+
+struct Integer::Big {
+    Parts parts;
+    mutable atomic<size_t> references{1u};
+};
+
+void Integer::Retain(const Big& big) {
+    big.references.fetch_add(1u, memory_order_relaxed);
+}
+
+void Integer::Release(const Big& big) {
+    if (big.references.fetch_sub(1u, memory_order_acq_rel) == 1u)
+    {
+        delete &big;
+    }
+}
+
+Integer::Parts Integer::Unpack(const Integer& value) {
+    if (!value.IsSmall())
+    {
+        return value.big_->parts;
+    }
+    const bool negative = value.small_ < 0;
+    // Negated as unsigned, so INT64_MIN gets its magnitude too
+    const auto magnitude = static_cast<uint64_t>(value.small_);
+    return {negative, FromUint64(negative ? 0u - magnitude : magnitude)};
+}
+
+Integer Integer::Pack(Parts value) {
+    Trim(value.limbs);
+    if (value.limbs.size() <= 2u)
+    {
+        uint64_t magnitude = 0u;
+        for (size_t i = value.limbs.size(); i-- > 0u;)
+        {
+            magnitude = (magnitude << 32u) | value.limbs[i];
+        }
+        const auto limit = static_cast<uint64_t>(INT64_MAX) + (value.negative ? 1u : 0u);
+        if (magnitude <= limit)
+        {
+            return static_cast<int64_t>(value.negative ? 0u - magnitude : magnitude);
+        }
+    }
+    Integer result;
+    result.big_ = new Big{move(value)};
+    return result;
+}
+
+Integer Integer::Parse(string_view text) {
+    const bool negative = !text.empty() && text.front() == '-';
+    const string_view digits = negative ? text.substr(1u) : text;
+    if (digits.empty() || !all_of(digits.begin(), digits.end(), [](char c) {
+            return c >= '0' && c <= '9';
+        }))
+    {
+        throw invalid_argument("Not a number: "s + string(text));
+    }
+
+    // Any 18 digits fit in 64 bits
+    if (digits.size() <= 18u)
+    {
+        int64_t value = 0;
+        for (const char c : digits)
+        {
+            value = value * 10 + (c - '0');
+        }
+        return negative ? -value : value;
+    }
+
+    // The first chunk takes the digits that do not fill a whole one
+    Parts result{negative, {}};
+    size_t chunk = digits.size() % DECIMAL_DIGITS == 0u ? DECIMAL_DIGITS : digits.size() % DECIMAL_DIGITS;
+    for (size_t pos = 0u; pos < digits.size(); pos += chunk, chunk = DECIMAL_DIGITS)
+    {
+        uint32_t factor = 1u;
+        uint32_t value = 0u;
+        for (const char c : digits.substr(pos, chunk))
+        {
+            factor *= 10u;
+            value = value * 10u + static_cast<uint32_t>(c - '0');
+        }
+        MultiplyAddSmall(result.limbs, factor, value);
+    }
+    return Pack(move(result));
+}
+
+int Integer::Sign() const {
+    if (IsSmall())
+    {
+        return (small_ > 0 ? 1 : 0) - (small_ < 0 ? 1 : 0);
+    }
+    return big_->parts.negative ? -1 : 1;
+}
+
+string Integer::ToString() const {
+    if (IsSmall())
+    {
+        return to_string(small_);
+    }
+    Limbs rest = big_->parts.limbs;
+    vector<uint32_t> chunks;
+    while (!rest.empty())
+    {
+        chunks.push_back(DivideBySmall(rest, DECIMAL_BASE));
+    }
+    string result = big_->parts.negative ? "-"s : ""s;
+    result += to_string(chunks.back());
+    for (size_t i = chunks.size() - 1u; i-- > 0u;)
+    {
+        const string chunk = to_string(chunks[i]);
+        result.append(DECIMAL_DIGITS - chunk.size(), '0');
+        result += chunk;
+    }
+    return result;
+}
+
+size_t Integer::Hash() const {
+    if (IsSmall())
+    {
+        return std::hash<int64_t>{}(small_);
+    }
+    size_t result = big_->parts.negative ? 1u : 0u;
+    for (const uint32_t limb : big_->parts.limbs)
+    {
+        result = result * 31u + std::hash<uint32_t>{}(limb);
+    }
+    return result;
+}
+
+Integer Integer::Add(const Integer& lhs, const Integer& rhs, bool subtract) {
+    Parts a = Unpack(lhs);
+    Parts b = Unpack(rhs);
+    if (subtract)
+    {
+        b.negative = !b.negative;
+    }
+    if (a.negative == b.negative)
+    {
+        return Pack({a.negative, AddLimbs(a.limbs, b.limbs)});
+    }
+    if (CompareLimbs(a.limbs, b.limbs) >= 0)
+    {
+        return Pack({a.negative, SubtractLimbs(a.limbs, b.limbs)});
+    }
+    return Pack({b.negative, SubtractLimbs(b.limbs, a.limbs)});
+}
+
+Integer Integer::Multiply(const Integer& lhs, const Integer& rhs) {
+    const Parts a = Unpack(lhs);
+    const Parts b = Unpack(rhs);
+    return Pack({a.negative != b.negative, MultiplyLimbs(a.limbs, b.limbs)});
+}
+
+Integer Integer::Divide(const Integer& lhs, const Integer& rhs) {
+    const Parts a = Unpack(lhs);
+    const Parts b = Unpack(rhs);
+    if (b.limbs.empty())
+    {
+        throw domain_error("Division by zero"s);
+    }
+    return Pack({a.negative != b.negative, DivideLimbs(a.limbs, b.limbs)});
+}
+
+int Integer::Compare(const Integer& lhs, const Integer& rhs) {
+    const int lhs_sign = lhs.Sign();
+    const int rhs_sign = rhs.Sign();
+    if (lhs_sign != rhs_sign)
+    {
+        return lhs_sign < rhs_sign ? -1 : 1;
+    }
+    const int magnitudes = CompareLimbs(Unpack(lhs).limbs, Unpack(rhs).limbs);
+    return lhs_sign < 0 ? -magnitudes : magnitudes;
+}
+
+ostream& operator<<(ostream& os, const Integer& value) {
+    if (value.IsSmall())
+    {
+        return os << value.GetSmall();
+    }
+    return os << value.ToString();
+}
+
+}  // namespace bigint
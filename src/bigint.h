@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Integers of any size. Values that fit in 64 bits are kept inline and added, subtracted and
+// multiplied with the overflow checks of the compiler, so they never touch the heap. A result
+// that overflows is promoted to a magnitude of 32-bit limbs shared between copies
+namespace bigint {
+
+class Integer {
+public:
+    // Products of operands with at least this many limbs each are computed by Karatsuba's method
+    static constexpr size_t KARATSUBA_THRESHOLD = 32u;
+
+    Integer() = default;
+    Integer(int64_t value)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        :small_(value) {}
+
+    Integer(const Integer& other)
+        :small_(other.small_), big_(other.big_) {
+        if (big_ != nullptr)
+        {
+            Retain(*big_);
+        }
+    }
+
+    Integer(Integer&& other) noexcept
+        :small_(other.small_), big_(std::exchange(other.big_, nullptr)) {}
+
+    Integer& operator=(Integer other) noexcept {
+        small_ = other.small_;
+        std::swap(big_, other.big_);
+        return *this;
+    }
+
+    ~Integer() {
+        if (big_ != nullptr)
+        {
+            Release(*big_);
+        }
+    }
+
+    // Parses decimal digits with an optional leading minus. Throws std::invalid_argument if the
+    // text is not a number
+    static Integer Parse(std::string_view text);
+
+    // Returns true if the value fits in 64 bits, then GetSmall returns it
+    [[nodiscard]] bool IsSmall() const {
+        return big_ == nullptr;
+    }
+
+    [[nodiscard]] int64_t GetSmall() const {
+        return small_;
+    }
+
+    [[nodiscard]] bool IsZero() const {
+        return IsSmall() && small_ == 0;
+    }
+
+    // Returns -1, 0 or 1
+    [[nodiscard]] int Sign() const;
+
+    [[nodiscard]] std::string ToString() const;
+    [[nodiscard]] size_t Hash() const;
+
+    friend Integer operator+(const Integer& lhs, const Integer& rhs) {
+        int64_t result = 0;
+        if (lhs.big_ == nullptr && rhs.big_ == nullptr && !__builtin_add_overflow(lhs.small_, rhs.small_, &result))
+        {
+            return result;
+        }
+        return Add(lhs, rhs, false);
+    }
+
+    friend Integer operator-(const Integer& lhs, const Integer& rhs) {
+        int64_t result = 0;
+        if (lhs.big_ == nullptr && rhs.big_ == nullptr && !__builtin_sub_overflow(lhs.small_, rhs.small_, &result))
+        {
+            return result;
+        }
+        return Add(lhs, rhs, true);
+    }
+
+    friend Integer operator*(const Integer& lhs, const Integer& rhs) {
+        int64_t result = 0;
+        if (lhs.big_ == nullptr && rhs.big_ == nullptr && !__builtin_mul_overflow(lhs.small_, rhs.small_, &result))
+        {
+            return result;
+        }
+        return Multiply(lhs, rhs);
+    }
+
+    // Rounds toward zero. The divisor must not be zero
+    friend Integer operator/(const Integer& lhs, const Integer& rhs) {
+        if (lhs.big_ == nullptr && rhs.big_ == nullptr && !(lhs.small_ == INT64_MIN && rhs.small_ == -1))
+        {
+            return lhs.small_ / rhs.small_;
+        }
+        return Divide(lhs, rhs);
+    }
+
+    friend bool operator==(const Integer& lhs, const Integer& rhs) {
+        if (lhs.big_ == nullptr || rhs.big_ == nullptr)
+        {
+            return lhs.big_ == rhs.big_ && lhs.small_ == rhs.small_;
+        }
+        return Compare(lhs, rhs) == 0;
+    }
+
+    friend bool operator<(const Integer& lhs, const Integer& rhs) {
+        if (lhs.big_ == nullptr && rhs.big_ == nullptr)
+        {
+            return lhs.small_ < rhs.small_;
+        }
+        return Compare(lhs, rhs) < 0;
+    }
+
+    friend bool operator!=(const Integer& lhs, const Integer& rhs) {
+        return !(lhs == rhs);
+    }
+
+    friend bool operator>(const Integer& lhs, const Integer& rhs) {
+        return rhs < lhs;
+    }
+
+    friend bool operator<=(const Integer& lhs, const Integer& rhs) {
+        return !(rhs < lhs);
+    }
+
+    friend bool operator>=(const Integer& lhs, const Integer& rhs) {
+        return !(lhs < rhs);
+    }
+
+private:
+    // The value as a sign and a magnitude
+    struct Parts;
+    // Parts of a large value with the number of Integers sharing them
+    struct Big;
+
+    static void Retain(const Big& big);
+    static void Release(const Big& big);
+
+    static Parts Unpack(const Integer& value);
+    // Keeps the value inline if it fits in 64 bits
+    static Integer Pack(Parts value);
+
+    static Integer Add(const Integer& lhs, const Integer& rhs, bool subtract);
+    static Integer Multiply(const Integer& lhs, const Integer& rhs);
+    static Integer Divide(const Integer& lhs, const Integer& rhs);
+    static int Compare(const Integer& lhs, const Integer& rhs);
+
+    int64_t small_ = 0;
+    // Set only for values outside the 64-bit range
+    const Big* big_ = nullptr;
+};
+
+std::ostream& operator<<(std::ostream& os, const Integer& value);
+
+}  // namespace bigint
@@ -0,0 +1,128 @@
+#include "bigint.h"
+
+#include "test_runner_p.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace bigint {
+
+namespace {
+
+// 10^count - 1
+string Nines(size_t count) {
+    return string(count, '9');
+}
+
+void TestSmallValuesStayInline() {
+    const Integer a = 1'000'000;
+    const Integer b = -7;
+    ASSERT((a + b).IsSmall());
+    ASSERT_EQUAL((a + b).GetSmall(), 999'993);
+    ASSERT_EQUAL((a - b).GetSmall(), 1'000'007);
+    ASSERT_EQUAL((a * b).GetSmall(), -7'000'000);
+    ASSERT_EQUAL((a / b).GetSmall(), -142'857);
+    ASSERT_EQUAL((Integer(-7) / Integer(2)).GetSmall(), -3);
+    ASSERT(b < a && a > b && b <= b && a != b);
+    ASSERT(Integer().IsZero());
+    ASSERT_EQUAL(b.Sign(), -1);
+}
+
+void TestOverflowPromotes() {
+    const Integer max = INT64_MAX;
+    const Integer min = INT64_MIN;
+
+    const Integer above = max + 1;
+    ASSERT(!above.IsSmall());
+    ASSERT_EQUAL(above.ToString(), "9223372036854775808"s);
+    ASSERT_EQUAL(above.Sign(), 1);
+    ASSERT(above > max);
+    // Results that fit again go back inline
+    ASSERT((above - 1).IsSmall());
+    ASSERT_EQUAL((above - 1).GetSmall(), INT64_MAX);
+
+    ASSERT_EQUAL((min - 1).ToString(), "-9223372036854775809"s);
+    ASSERT((min - 1) < min);
+    ASSERT_EQUAL((min / -1).ToString(), "9223372036854775808"s);
+    ASSERT_EQUAL((min * -1) * -1, min);
+    ASSERT((max * max) / max == max);
+    ASSERT_EQUAL((max * max).ToString(), "85070591730234615847396907784232501249"s);
+    ASSERT_EQUAL((min * min).ToString(), "85070591730234615865843651857942052864"s);
+}
+
+void TestParsesAndPrints() {
+    ASSERT_EQUAL(Integer::Parse("0"sv), Integer(0));
+    ASSERT_EQUAL(Integer::Parse("-9223372036854775808"sv).GetSmall(), INT64_MIN);
+    const string digits = "123456789012345678901234567890123456789"s;
+    ASSERT_EQUAL(Integer::Parse(digits).ToString(), digits);
+    ASSERT_EQUAL(Integer::Parse("-"s + digits).ToString(), "-"s + digits);
+    ASSERT_EQUAL(Integer::Parse("000000000000000000000000042"sv), Integer(42));
+    ASSERT_EQUAL(Integer::Parse("1000000000000000000000"sv).ToString(), "1000000000000000000000"s);
+
+    ostringstream out;
+    out << Integer::Parse(digits) << ' ' << Integer(-5);
+    ASSERT_EQUAL(out.str(), digits + " -5"s);
+
+    ASSERT_THROWS(Integer::Parse(""sv), invalid_argument);
+    ASSERT_THROWS(Integer::Parse("-"sv), invalid_argument);
+    ASSERT_THROWS(Integer::Parse("12a"sv), invalid_argument);
+}
+
+void TestMixedSigns() {
+    const Integer big = Integer::Parse("100000000000000000000"sv);
+    ASSERT_EQUAL((big - big), Integer(0));
+    ASSERT((big - big).IsSmall());
+    ASSERT_EQUAL((Integer(1) - big).ToString(), "-99999999999999999999"s);
+    ASSERT_EQUAL((Integer(0) - big + big), Integer(0));
+    ASSERT_EQUAL((big / Integer(-3)).ToString(), "-33333333333333333333"s);
+    ASSERT_EQUAL((Integer(0) - big) / Integer(-3), Integer::Parse("33333333333333333333"sv));
+    ASSERT_EQUAL(Integer(5) / big, Integer(0));
+    ASSERT(Integer(0) - big < Integer(-1));
+    ASSERT(Integer(0) - big < big);
+    ASSERT_EQUAL(big.Hash(), Integer::Parse("100000000000000000000"sv).Hash());
+    ASSERT_THROWS(big / Integer(0), domain_error);
+}
+
+void TestKaratsubaProducts() {
+    // (10^n - 1)^2 = 9...98 0...01, with n - 1 nines and n - 1 zeros. Thousands of digits take
+    // a few levels of Karatsuba's method
+    for (const size_t n : {300u, 1000u, 2500u})
+    {
+        const Integer value = Integer::Parse(Nines(n));
+        const string expected = Nines(n - 1u) + "8"s + string(n - 1u, '0') + "1"s;
+        ASSERT_EQUAL((value * value).ToString(), expected);
+    }
+
+    // Operands of very different lengths
+    const Integer long_value = Integer::Parse(Nines(3000u));
+    const Integer short_value = Integer::Parse("1"s + string(400u, '0'));
+    ASSERT_EQUAL((long_value * short_value).ToString(), Nines(3000u) + string(400u, '0'));
+}
+
+void TestDivisionInvertsMultiplication() {
+    const Integer a = Integer::Parse("31415926535897932384626433832795028841971693993751"s + Nines(700u));
+    const Integer b = Integer::Parse("27182818284590452353602874713526624977572470936999"s);
+    const Integer product = a * b;
+    ASSERT_EQUAL(product / b, a);
+    ASSERT_EQUAL(product / a, b);
+    // The remainder is dropped
+    ASSERT_EQUAL((product + b - 1) / b, a);
+    ASSERT_EQUAL((product - 1) / b, a - 1);
+    ASSERT_EQUAL((Integer(0) - product) / b, Integer(0) - a);
+    ASSERT_EQUAL(b / a, Integer(0));
+}
+
+}  // namespace
+
+void RunBigIntTests(TestRunner& tr) {
+    RUN_TEST(tr, bigint::TestSmallValuesStayInline);
+    RUN_TEST(tr, bigint::TestOverflowPromotes);
+    RUN_TEST(tr, bigint::TestParsesAndPrints);
+    RUN_TEST(tr, bigint::TestMixedSigns);
+    RUN_TEST(tr, bigint::TestKaratsubaProducts);
+    RUN_TEST(tr, bigint::TestDivisionInvertsMultiplication);
+}
+
+}  // namespace bigint
@@ -0,0 +1,181 @@
+#include "census.h"
+
+#include "profiler.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+namespace census {
+
+namespace {
+
+string KindName(const runtime::Object& object) {
+    if (dynamic_cast<const runtime::Number*>(&object) != nullptr)
+    {
+        return "Number"s;
+    }
+    if (dynamic_cast<const runtime::String*>(&object) != nullptr)
+    {
+        return "String"s;
+    }
+    if (dynamic_cast<const runtime::Bool*>(&object) != nullptr)
+    {
+        return "Bool"s;
+    }
+    if (auto instance = dynamic_cast<const runtime::ClassInstance*>(&object))
+    {
+        return "ClassInstance "s + instance->GetClass().GetName();
+    }
+    if (dynamic_cast<const runtime::Class*>(&object) != nullptr)
+    {
+        return "Class"s;
+    }
+    return "Object"s;
+}
+
+// Heap memory owned by the value of the object. Short strings are stored inside the object
+uint64_t PayloadSize(const runtime::Object& object) {
+    if (auto str = dynamic_cast<const runtime::String*>(&object))
+    {
+        const string& value = str->GetValue();
+        const char* begin = reinterpret_cast<const char*>(&value);
+        less<const char*> before;
+        if (before(value.data(), begin) || !before(value.data(), begin + sizeof(value)))
+        {
+            return value.capacity() + 1u;
+        }
+    }
+    return 0u;
+}
+
+void AddAllocation(AllocationStats& stats, uint64_t bytes) {
+    ++stats.allocations;
+    stats.allocated_bytes += bytes;
+    ++stats.live;
+    stats.live_bytes += bytes;
+    stats.peak_live = max(stats.peak_live, stats.live);
+    stats.peak_live_bytes = max(stats.peak_live_bytes, stats.live_bytes);
+}
+
+void RemoveAllocation(AllocationStats& stats, uint64_t bytes) {
+    --stats.live;
+    stats.live_bytes -= bytes;
+}
+
+string SiteName(const runtime::Executable* site) {
+    if (site == nullptr)
+    {
+        return "<runtime>"s;
+    }
+    const runtime::SourcePosition& position = site->GetPosition();
+    return profile::NodeTypeName(*site) + " at "s + to_string(position.line) + ':'
+           + to_string(position.column);
+}
+
+}  // namespace
+
+void HeapCensus::Start() {
+    active_ = this;
+}
+
+void HeapCensus::Stop() {
+    if (active_ == this)
+    {
+        active_ = nullptr;
+    }
+}
+
+void HeapCensus::Allocate(const runtime::Object& object, size_t object_size) {
+    const uint64_t bytes = object_size + PayloadSize(object);
+    auto kind = kinds_.try_emplace(KindName(object)).first;
+
+    AddAllocation(totals_, bytes);
+    AddAllocation(kind->second, bytes);
+    AddAllocation(sites_[SiteKey{current_node_, &kind->first}], bytes);
+    live_[&object] = Allocation{&kind->first, current_node_, bytes};
+}
+
+void HeapCensus::Free(const runtime::Object& object) {
+    auto it = live_.find(&object);
+    if (it == live_.end())
+    {
+        return;
+    }
+    const Allocation& allocation = it->second;
+    RemoveAllocation(totals_, allocation.bytes);
+    RemoveAllocation(kinds_.at(*allocation.kind), allocation.bytes);
+    RemoveAllocation(sites_.at(SiteKey{allocation.site, allocation.kind}), allocation.bytes);
+    live_.erase(it);
+}
+
+const AllocationStats* HeapCensus::GetKindStats(const string& kind) const {
+    auto it = kinds_.find(kind);
+    return it == kinds_.end() ? nullptr : &it->second;
+}
+
+void HeapCensus::ReportHeap(ostream& os, size_t top) const {
+    os << "Heap census: " << totals_.allocations << " allocations, " << totals_.allocated_bytes
+       << " bytes, peak " << totals_.peak_live << " live objects, " << totals_.peak_live_bytes
+       << " live bytes\n";
+    os << left << setw(28) << "kind" << right << setw(12) << "allocs" << setw(14) << "bytes"
+       << setw(12) << "peak_live" << setw(14) << "peak_bytes" << setw(10) << "live" << '\n';
+    for (const auto& [kind, stats] : kinds_)
+    {
+        os << left << setw(28) << kind << right << setw(12) << stats.allocations << setw(14)
+           << stats.allocated_bytes << setw(12) << stats.peak_live << setw(14)
+           << stats.peak_live_bytes << setw(10) << stats.live << '\n';
+    }
+
+    vector<pair<Site, AllocationStats>> sites = CollectSites();
+    sort(sites.begin(), sites.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.allocated_bytes > rhs.second.allocated_bytes;
+    });
+    if (sites.size() > top)
+    {
+        sites.resize(top);
+    }
+    os << "Allocation sites (bytes allocated):\n";
+    os << setw(12) << "allocs" << setw(14) << "bytes" << setw(10) << "live" << "  " << left
+       << setw(28) << "kind" << right << "site\n";
+    for (const auto& [site, stats] : sites)
+    {
+        os << setw(12) << stats.allocations << setw(14) << stats.allocated_bytes << setw(10)
+           << stats.live << "  " << left << setw(28) << site.second << right << site.first << '\n';
+    }
+}
+
+void HeapCensus::ReportLeaks(ostream& os) const {
+    os << "Leaks: " << totals_.live << " objects, " << totals_.live_bytes
+       << " bytes still alive\n";
+    for (const auto& [site, stats] : CollectSites())
+    {
+        if (stats.live > 0u)
+        {
+            os << setw(12) << stats.live << " x " << site.second << " allocated by " << site.first
+               << '\n';
+        }
+    }
+}
+
+// Nodes of one expression may share a position, e.g. additions of a + b + c all start at a.
+// Their sites are merged. Peaks of merged sites are meaningless and left out
+vector<pair<HeapCensus::Site, AllocationStats>> HeapCensus::CollectSites() const {
+    map<Site, AllocationStats> sites;
+    for (const auto& [key, stats] : sites_)
+    {
+        AllocationStats& site = sites[Site{SiteName(key.first), *key.second}];
+        site.allocations += stats.allocations;
+        site.allocated_bytes += stats.allocated_bytes;
+        site.live += stats.live;
+        site.live_bytes += stats.live_bytes;
+    }
+    return {sites.begin(), sites.end()};
+}
+
+}  // namespace census
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace runtime {
+class Executable;
+class Object;
+}  // namespace runtime
+
+namespace census {
+
+// Allocation counters of one kind of objects or of one allocation site
+struct AllocationStats {
+    uint64_t allocations = 0u;
+    uint64_t allocated_bytes = 0u;
+    uint64_t live = 0u;
+    uint64_t live_bytes = 0u;
+    // High-water marks of live and live_bytes
+    uint64_t peak_live = 0u;
+    uint64_t peak_live_bytes = 0u;
+};
+
+// Counts objects created by ObjectHolder::Own by kind ("Number", "ClassInstance Node", ...) and
+// by the AST node that created them, and keeps track of the objects that are still alive
+class HeapCensus {
+public:
+    // Returns the active census or nullptr if it is off
+    static HeapCensus* Active() {
+        return active_;
+    }
+
+    // Makes this census the active one. Objects created before Start are not counted
+    void Start();
+    // Objects freed after Stop are not counted, so the live ones are reported as leaks
+    void Stop();
+
+    // Makes node the allocation site of the objects created from now on. Returns the previous site
+    const runtime::Executable* SetCurrentNode(const runtime::Executable* node) {
+        std::swap(current_node_, node);
+        return node;
+    }
+
+    // object_size is the size of the object itself, the heap memory of its value is added here
+    void Allocate(const runtime::Object& object, size_t object_size);
+    void Free(const runtime::Object& object);
+
+    [[nodiscard]] const AllocationStats& GetTotals() const {
+        return totals_;
+    }
+
+    // Returns counters of the kind or nullptr if no object of the kind was created
+    [[nodiscard]] const AllocationStats* GetKindStats(const std::string& kind) const;
+
+    // Prints counters of every kind and top allocation sites ordered by allocated bytes.
+    // Sites point into the program, so it must be alive
+    void ReportHeap(std::ostream& os, size_t top) const;
+    // Prints objects that are still alive grouped by kind and allocation site. Called after
+    // the variables of the program are gone, it shows objects kept alive by reference cycles
+    void ReportLeaks(std::ostream& os) const;
+
+private:
+    struct Allocation {
+        const std::string* kind = nullptr;
+        const runtime::Executable* site = nullptr;
+        uint64_t bytes = 0u;
+    };
+
+    using SiteKey = std::pair<const runtime::Executable*, const std::string*>;
+    // Readable site name and kind
+    using Site = std::pair<std::string, std::string>;
+
+    [[nodiscard]] std::vector<std::pair<Site, AllocationStats>> CollectSites() const;
+
+    static inline HeapCensus* active_ = nullptr;
+
+    const runtime::Executable* current_node_ = nullptr;
+    AllocationStats totals_;
+    std::map<std::string, AllocationStats> kinds_;
+    std::map<SiteKey, AllocationStats> sites_;
+    std::unordered_map<const runtime::Object*, Allocation> live_;
+};
+
+}  // namespace census
@@ -0,0 +1,108 @@
+#include "census.h"
+#include "statement.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace census {
+
+namespace {
+
+void TestCountsObjectsByKind() {
+    HeapCensus census;
+    runtime::DummyContext context;
+    RunOptions options;
+    options.before = [&census](runtime::Executable& /*program*/) {
+        census.Start();
+    };
+    options.after = [&census] {
+        census.Stop();
+        ostringstream report;
+        census.ReportHeap(report, 10u);
+        ASSERT(report.str().find("ast::Stringify at 8:12"s) != string::npos);
+        ASSERT(report.str().find("ast::NewInstance at 10:5"s) != string::npos);
+    };
+    ExecuteProgram(R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return str(self.x) + ',' + str(self.y)
+
+p = Point(1, 2 + 3)
+q = Point(4, 5)
+print p, q
+)"s, context, options);
+
+    const AllocationStats* points = census.GetKindStats("ClassInstance Point"s);
+    ASSERT(points != nullptr);
+    ASSERT_EQUAL(points->allocations, 2u);
+    ASSERT_EQUAL(points->peak_live, 2u);
+    ASSERT_EQUAL(points->live, 0u);
+
+    // 2 + 3
+    const AllocationStats* numbers = census.GetKindStats("Number"s);
+    ASSERT(numbers != nullptr);
+    ASSERT_EQUAL(numbers->allocations, 1u);
+
+    // Four str() results. Concatenations extend the temporary str() results in place
+    const AllocationStats* strings = census.GetKindStats("String"s);
+    ASSERT(strings != nullptr);
+    ASSERT_EQUAL(strings->allocations, 4u);
+    ASSERT(census.GetKindStats("Bool"s) == nullptr);
+
+    ASSERT_EQUAL(census.GetTotals().live, 0u);
+    ASSERT_EQUAL(census.GetTotals().allocations, 7u);
+}
+
+void TestReportsCycles() {
+    HeapCensus census;
+    runtime::DummyContext context;
+    // Keeps a after the globals are gone, so that the cycle can be broken once it is reported
+    runtime::ObjectHolder a;
+    RunOptions options;
+    options.before = [&census](runtime::Executable& /*program*/) {
+        census.Start();
+    };
+    options.executed = [&a](runtime::Closure& globals) {
+        a = globals.at("a"s);
+    };
+    options.after = [&census] {
+        census.Stop();
+        ostringstream report;
+        census.ReportLeaks(report);
+        ASSERT(report.str().find("Leaks: 2 objects"s) != string::npos);
+        ASSERT(report.str().find("1 x ClassInstance Node allocated by ast::NewInstance at 6:5"s)
+               != string::npos);
+        ASSERT(report.str().find("1 x ClassInstance Node allocated by ast::NewInstance at 7:5"s)
+               != string::npos);
+        ASSERT(report.str().find(" at 10:"s) == string::npos);
+    };
+    ExecuteProgram(R"(
+class Node:
+  def link(other):
+    self.next = other
+
+a = Node()
+b = Node()
+a.link(b)
+b.link(a)
+c = Node()
+)"s, context, options);
+    ASSERT_EQUAL(census.GetTotals().live, 2u);
+
+    a.TryAs<runtime::ClassInstance>()->Fields().erase("next"s);
+}
+
+}  // namespace
+
+void RunCensusTests(TestRunner& tr) {
+    RUN_TEST(tr, census::TestCountsObjectsByKind);
+    RUN_TEST(tr, census::TestReportsCycles);
+}
+
+}  // namespace census
@@ -0,0 +1,424 @@
+#include "fold.h"
+
+#include "profiler.h"
+#include "statement.h"
+
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <variant>
+
+using namespace std;
+
+namespace fold {
+
+namespace {
+
+// Value of a constant expression. monostate stands for None
+using Constant = variant<monostate, bigint::Integer, string, bool>;
+
+// The same as runtime::IsTrue
+bool IsTrue(const Constant& value) {
+    if (const bigint::Integer* number = get_if<bigint::Integer>(&value))
+    {
+        return !number->IsZero();
+    }
+    if (const string* str = get_if<string>(&value))
+    {
+        return !str->empty();
+    }
+    if (const bool* flag = get_if<bool>(&value))
+    {
+        return *flag;
+    }
+    return false;
+}
+
+// The same as str()
+string ToString(const Constant& value) {
+    if (const bigint::Integer* number = get_if<bigint::Integer>(&value))
+    {
+        return number->ToString();
+    }
+    if (const string* str = get_if<string>(&value))
+    {
+        return *str;
+    }
+    if (const bool* flag = get_if<bool>(&value))
+    {
+        return *flag ? "True"s : "False"s;
+    }
+    return "None"s;
+}
+
+runtime::ObjectHolder ToObject(const Constant& value) {
+    if (const bigint::Integer* number = get_if<bigint::Integer>(&value))
+    {
+        return runtime::ObjectHolder::Own(runtime::Number(*number));
+    }
+    if (const string* str = get_if<string>(&value))
+    {
+        return runtime::ObjectHolder::Own(runtime::String(*str));
+    }
+    if (const bool* flag = get_if<bool>(&value))
+    {
+        return runtime::ObjectHolder::Own(runtime::Bool(*flag));
+    }
+    return runtime::ObjectHolder::None();
+}
+
+unique_ptr<ast::Statement> MakeConstant(const Constant& value) {
+    if (const bigint::Integer* number = get_if<bigint::Integer>(&value))
+    {
+        return make_unique<ast::NumericConst>(runtime::Number(*number));
+    }
+    if (const string* str = get_if<string>(&value))
+    {
+        return make_unique<ast::StringConst>(runtime::String(*str));
+    }
+    if (const bool* flag = get_if<bool>(&value))
+    {
+        return make_unique<ast::BoolConst>(runtime::Bool(*flag));
+    }
+    return make_unique<ast::None>();
+}
+
+// Integer arithmetic of Add, Sub, Mult and Div. Division by zero is not folded
+optional<bigint::Integer> Calculate(const ast::Statement& operation, const bigint::Integer& lhs,
+                                    const bigint::Integer& rhs) {
+    if (dynamic_cast<const ast::Add*>(&operation) != nullptr)
+    {
+        return lhs + rhs;
+    }
+    if (dynamic_cast<const ast::Sub*>(&operation) != nullptr)
+    {
+        return lhs - rhs;
+    }
+    if (dynamic_cast<const ast::Mult*>(&operation) != nullptr)
+    {
+        return lhs * rhs;
+    }
+    if (dynamic_cast<const ast::Div*>(&operation) != nullptr && !rhs.IsZero())
+    {
+        return lhs / rhs;
+    }
+    return nullopt;
+}
+
+}  // namespace
+
+class ConstantFolder {
+public:
+    // Statements left in the program are collected for the profiler only
+    explicit ConstantFolder(bool collect_statements)
+        :collect_statements_(collect_statements) {}
+
+    // Folds the children of node, node itself is kept
+    void FoldChildren(ast::Statement& node);
+
+    [[nodiscard]] const Stats& GetStats() const {
+        return stats_;
+    }
+
+    // Statements left in the program
+    [[nodiscard]] const unordered_set<const runtime::Executable*>& GetStatements() const {
+        return statements_;
+    }
+
+private:
+    // Folds the children of node and replaces node with a constant if it can be computed
+    void Fold(unique_ptr<ast::Statement>& node);
+    void FoldCompound(ast::Compound& compound);
+    void FoldIfElse(ast::IfElse& if_else);
+
+    static optional<Constant> ConstantOf(const ast::Statement& node);
+    static optional<Constant> Evaluate(const ast::Statement& node);
+
+    bool collect_statements_;
+    Stats stats_;
+    unordered_set<const runtime::Executable*> statements_;
+};
+
+optional<Constant> ConstantFolder::ConstantOf(const ast::Statement& node) {
+    if (const auto* number = dynamic_cast<const ast::NumericConst*>(&node))
+    {
+        return Constant(number->GetValue().GetValue());
+    }
+    if (const auto* str = dynamic_cast<const ast::StringConst*>(&node))
+    {
+        return Constant(str->GetValue().GetValue());
+    }
+    if (const auto* flag = dynamic_cast<const ast::BoolConst*>(&node))
+    {
+        return Constant(flag->GetValue().GetValue());
+    }
+    if (dynamic_cast<const ast::None*>(&node) != nullptr)
+    {
+        return Constant();
+    }
+    return nullopt;
+}
+
+optional<Constant> ConstantFolder::Evaluate(const ast::Statement& node) {
+    if (const auto* unary = dynamic_cast<const ast::UnaryOperation*>(&node))
+    {
+        optional<Constant> argument = ConstantOf(*unary->GetArgument());
+        if (!argument)
+        {
+            return nullopt;
+        }
+        if (dynamic_cast<const ast::Not*>(&node) != nullptr)
+        {
+            return Constant(!IsTrue(*argument));
+        }
+        if (dynamic_cast<const ast::Stringify*>(&node) != nullptr)
+        {
+            return Constant(ToString(*argument));
+        }
+        return nullopt;
+    }
+
+    const auto* binary = dynamic_cast<const ast::BinaryOperation*>(&node);
+    if (binary == nullptr)
+    {
+        return nullopt;
+    }
+    optional<Constant> lhs = ConstantOf(*binary->GetLhs());
+    optional<Constant> rhs = ConstantOf(*binary->GetRhs());
+
+    // The right operand of or and and is not evaluated when the left one decides the result
+    if (dynamic_cast<const ast::Or*>(&node) != nullptr)
+    {
+        if (lhs && IsTrue(*lhs))
+        {
+            return Constant(true);
+        }
+        return lhs && rhs ? optional<Constant>(Constant(IsTrue(*rhs))) : nullopt;
+    }
+    if (dynamic_cast<const ast::And*>(&node) != nullptr)
+    {
+        if (lhs && !IsTrue(*lhs))
+        {
+            return Constant(false);
+        }
+        return lhs && rhs ? optional<Constant>(Constant(IsTrue(*rhs))) : nullopt;
+    }
+    if (!lhs || !rhs)
+    {
+        return nullopt;
+    }
+
+    if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&node))
+    {
+        // Comparisons of constants never call methods, so any context will do
+        runtime::DummyContext context;
+        try
+        {
+            return Constant(runtime::Compare(comparison->GetOp(), ToObject(*lhs), ToObject(*rhs), context));
+        }
+        catch (const runtime_error&)
+        {
+            return nullopt;
+        }
+    }
+    if (holds_alternative<bigint::Integer>(*lhs) && holds_alternative<bigint::Integer>(*rhs))
+    {
+        if (optional<bigint::Integer> result = Calculate(node, get<bigint::Integer>(*lhs), get<bigint::Integer>(*rhs)))
+        {
+            return Constant(*result);
+        }
+        return nullopt;
+    }
+    if (holds_alternative<string>(*lhs) && holds_alternative<string>(*rhs)
+        && dynamic_cast<const ast::Add*>(&node) != nullptr)
+    {
+        return Constant(get<string>(*lhs) + get<string>(*rhs));
+    }
+    return nullopt;
+}
+
+void ConstantFolder::Fold(unique_ptr<ast::Statement>& node) {
+    if (!node)
+    {
+        return;
+    }
+    FoldChildren(*node);
+    if (optional<Constant> value = Evaluate(*node))
+    {
+        const runtime::SourcePosition position = node->GetPosition();
+        node = MakeConstant(*value);
+        node->SetPosition(position);
+        ++stats_.folded_expressions;
+    }
+}
+
+void ConstantFolder::FoldCompound(ast::Compound& compound) {
+    vector<unique_ptr<ast::Statement>> statements;
+    bool returned = false;
+    const auto add = [&](unique_ptr<ast::Statement> stmt) {
+        returned = returned || dynamic_cast<ast::Return*>(stmt.get()) != nullptr;
+        statements.push_back(move(stmt));
+    };
+
+    for (auto& stmt : compound.GetStatements())
+    {
+        if (returned)
+        {
+            ++stats_.removed_statements;
+            continue;
+        }
+        auto* if_else = dynamic_cast<ast::IfElse*>(stmt.get());
+        if (if_else == nullptr)
+        {
+            FoldChildren(*stmt);
+            add(move(stmt));
+            continue;
+        }
+
+        Fold(if_else->GetCondition());
+        optional<Constant> condition = ConstantOf(*if_else->GetCondition());
+        if (!condition)
+        {
+            FoldIfElse(*if_else);
+            add(move(stmt));
+            continue;
+        }
+        // The statements of the branch that is taken replace the if
+        ++stats_.pruned_branches;
+        unique_ptr<ast::Statement>& branch = IsTrue(*condition) ? if_else->GetIfBody() : if_else->GetElseBody();
+        if (!branch)
+        {
+            continue;
+        }
+        FoldChildren(*branch);
+        if (auto* body = dynamic_cast<ast::Compound*>(branch.get()))
+        {
+            for (auto& body_stmt : body->GetStatements())
+            {
+                add(move(body_stmt));
+            }
+        }
+        else
+        {
+            add(move(branch));
+        }
+    }
+
+    compound.GetStatements() = move(statements);
+    if (collect_statements_)
+    {
+        for (const auto& stmt : compound.GetStatements())
+        {
+            statements_.insert(stmt.get());
+        }
+    }
+}
+
+void ConstantFolder::FoldIfElse(ast::IfElse& if_else) {
+    // if not x: a else: b is the same as if x: b else: a without creating a Bool
+    if (auto* negation = dynamic_cast<ast::Not*>(if_else.GetCondition().get()); negation && if_else.GetElseBody())
+    {
+        if_else.GetCondition() = move(negation->GetArgument());
+        swap(if_else.GetIfBody(), if_else.GetElseBody());
+        ++stats_.folded_expressions;
+    }
+    if (if_else.GetIfBody())
+    {
+        FoldChildren(*if_else.GetIfBody());
+    }
+    if (if_else.GetElseBody())
+    {
+        FoldChildren(*if_else.GetElseBody());
+    }
+}
+
+void ConstantFolder::FoldChildren(ast::Statement& node) {
+    if (auto* compound = dynamic_cast<ast::Compound*>(&node))
+    {
+        FoldCompound(*compound);
+    }
+    else if (auto* if_else = dynamic_cast<ast::IfElse*>(&node))
+    {
+        Fold(if_else->GetCondition());
+        FoldIfElse(*if_else);
+    }
+    else if (auto* while_loop = dynamic_cast<ast::While*>(&node))
+    {
+        Fold(while_loop->GetCondition());
+        FoldChildren(*while_loop->GetBody());
+    }
+    else if (auto* for_range = dynamic_cast<ast::ForRange*>(&node))
+    {
+        Fold(for_range->GetBegin());
+        Fold(for_range->GetEnd());
+        FoldChildren(*for_range->GetBody());
+    }
+    else if (auto* method_body = dynamic_cast<ast::MethodBody*>(&node))
+    {
+        FoldChildren(*method_body->GetBody());
+    }
+    else if (auto* class_definition = dynamic_cast<ast::ClassDefinition*>(&node))
+    {
+        const auto& cls = class_definition->GetClass();
+        for (const runtime::Method& method : cls.GetMethods())
+        {
+            FoldChildren(*method.body);
+        }
+    }
+    else if (auto* assignment = dynamic_cast<ast::Assignment*>(&node))
+    {
+        Fold(assignment->GetRv());
+    }
+    else if (auto* field_assignment = dynamic_cast<ast::FieldAssignment*>(&node))
+    {
+        Fold(field_assignment->GetRv());
+    }
+    else if (auto* print = dynamic_cast<ast::Print*>(&node))
+    {
+        for (auto& arg : print->GetArgs())
+        {
+            Fold(arg);
+        }
+    }
+    else if (auto* method_call = dynamic_cast<ast::MethodCall*>(&node))
+    {
+        Fold(method_call->GetObject());
+        for (auto& arg : method_call->GetArgs())
+        {
+            Fold(arg);
+        }
+    }
+    else if (auto* new_instance = dynamic_cast<ast::NewInstance*>(&node))
+    {
+        for (auto& arg : new_instance->GetArgs())
+        {
+            Fold(arg);
+        }
+    }
+    else if (auto* return_stmt = dynamic_cast<ast::Return*>(&node))
+    {
+        Fold(return_stmt->GetStatement());
+    }
+    else if (auto* unary = dynamic_cast<ast::UnaryOperation*>(&node))
+    {
+        Fold(unary->GetArgument());
+    }
+    else if (auto* binary = dynamic_cast<ast::BinaryOperation*>(&node))
+    {
+        Fold(binary->GetLhs());
+        Fold(binary->GetRhs());
+    }
+}
+
+Stats FoldConstants(runtime::Executable& program) {
+    profile::NodeProfiler* profiler = profile::NodeProfiler::Active();
+    ConstantFolder folder(profiler != nullptr);
+    folder.FoldChildren(program);
+    if (profiler != nullptr)
+    {
+        profiler->RetainStatements(folder.GetStatements());
+    }
+    return folder.GetStats();
+}
+
+}  // namespace fold
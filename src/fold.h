@@ -0,0 +1,26 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstddef>
+
+namespace fold {
+
+// What the pass changed in the program
+struct Stats {
+    // Operations replaced by constants or simplified
+    size_t folded_expressions = 0u;
+    // if statements with constant conditions, replaced by the branch that is taken
+    size_t pruned_branches = 0u;
+    // Statements that can never run because they follow a return
+    size_t removed_statements = 0u;
+};
+
+// Simplifies the program returned by ParseProgram in place: folds arithmetic, concatenation,
+// comparisons, logic and str() of constants, prunes if statements with constant conditions and
+// drops statements after return, including those in method bodies. Operations that would fail
+// at run time, e.g. division by zero or an overflow, are left to fail at run time.
+// Statements registered in the active profiler are kept in sync with the program
+Stats FoldConstants(runtime::Executable& program);
+
+}  // namespace fold
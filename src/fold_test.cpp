@@ -0,0 +1,134 @@
+#include "fold.h"
+#include "lexer.h"
+#include "parse.h"
+#include "profiler.h"
+#include "statement.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace fold {
+
+namespace {
+
+// Folds the program passed to RunProgram and stores what was changed in stats
+auto Fold(Stats& stats) {
+    return [&stats](runtime::Executable& program) {
+        stats = FoldConstants(program);
+    };
+}
+
+void TestFoldsConstantExpressions() {
+    const string source = R"(
+x = 2 * 3 + 4 - -1
+s = "con" + "cat"
+print x, s, str(10 / 3), -5, 7 > 3, "a" == "b", not False, True and 0 or "z"
+
+class Checker:
+  def check(n):
+    if not n < 3:
+      return "big"
+    else:
+      return "small"
+
+c = Checker()
+print c.check(1), c.check(5)
+)"s;
+    Stats stats;
+    const string folded = RunProgram(source, Fold(stats));
+    ASSERT_EQUAL(folded, "11 concat 3 -5 True False True True\nsmall big\n"s);
+    ASSERT_EQUAL(folded, RunProgram(source));
+    // Every operation of the first three lines and the negated condition
+    ASSERT_EQUAL(stats.folded_expressions, 14u);
+    ASSERT_EQUAL(stats.pruned_branches, 0u);
+    ASSERT_EQUAL(stats.removed_statements, 0u);
+}
+
+void TestPrunesUnreachableCode() {
+    const string source = R"(class Shape:
+  def area():
+    return 0
+    print "unreachable"
+  def kind():
+    if True:
+      return "shape"
+    print "unreachable too"
+if 1 > 2:
+  print "never"
+else:
+  print "always"
+if "":
+  print "never"
+s = Shape()
+print s.area(), s.kind()
+)"s;
+    istringstream input(source);
+    parse::Lexer lexer(input);
+
+    profile::NodeProfiler profiler;
+    profiler.Start();
+    auto program = ParseProgram(lexer);
+    const Stats stats = FoldConstants(*program);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program->Execute(closure, context);
+    profiler.Stop();
+
+    ASSERT_EQUAL(context.output.str(), "always\n0 shape\n"s);
+    ASSERT_EQUAL(stats.folded_expressions, 1u);
+    ASSERT_EQUAL(stats.pruned_branches, 3u);
+    ASSERT_EQUAL(stats.removed_statements, 2u);
+
+    // Removed statements and the pruned if statements are not reported
+    vector<string> source_lines;
+    istringstream lines(source);
+    for (string line; getline(lines, line);)
+    {
+        source_lines.push_back(line);
+    }
+    ostringstream report;
+    profiler.ReportCoverage(report, source_lines);
+    ASSERT(report.str().find("Line coverage: 6 of 6 lines executed"s) != string::npos);
+    ASSERT(report.str().find("-:     4:     print \"unreachable\""s) != string::npos);
+}
+
+void TestFoldsLargeNumbers() {
+    const string source = "print 9223372036854775807 + 1, 2147483647 * 2147483647 * 2147483647 / 2147483647\n"s;
+    Stats stats;
+    const string folded = RunProgram(source, Fold(stats));
+    ASSERT_EQUAL(folded, "9223372036854775808 4611686014132420609\n"s);
+    ASSERT_EQUAL(folded, RunProgram(source));
+    ASSERT_EQUAL(stats.folded_expressions, 4u);
+}
+
+void TestRunTimeErrorsAreNotFolded() {
+    istringstream input("print 1 / 0\nprint \"a\" + 1\nprint 1 < \"a\"\n"s);
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    const Stats stats = FoldConstants(*program);
+    ASSERT_EQUAL(stats.folded_expressions, 0u);
+
+    try
+    {
+        Stats run_stats;
+        RunProgram("print 1 / 0\n"s, Fold(run_stats));
+    }
+    catch (const runtime_error&)
+    {
+        return;
+    }
+    ASSERT(false);
+}
+
+}  // namespace
+
+void RunFoldTests(TestRunner& tr) {
+    RUN_TEST(tr, fold::TestFoldsConstantExpressions);
+    RUN_TEST(tr, fold::TestPrunesUnreachableCode);
+    RUN_TEST(tr, fold::TestFoldsLargeNumbers);
+    RUN_TEST(tr, fold::TestRunTimeErrorsAreNotFolded);
+}
+
+}  // namespace fold
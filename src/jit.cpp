@@ -0,0 +1,1208 @@
+#include "jit.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace jit {
+
+using runtime::ObjectHolder;
+
+namespace {
+
+#if defined(__x86_64__)
+constexpr bool SUPPORTED = true;
+#else
+constexpr bool SUPPORTED = false;
+#endif
+
+// A slot of a frame holds a 64-bit word. An odd word is an inline number n stored as 2n + 1,
+// so numbers in [-2^62, 2^62) are added and compared without touching the heap. Any other
+// value, None included, is kept in the ObjectHolder of the slot, and the word is BOXED.
+// A local variable not assigned yet is UNBOUND, reading it fails like in the interpreter
+constexpr int64_t BOXED = 0;
+constexpr int64_t UNBOUND = 2;
+constexpr int64_t MIN_INLINE = -(int64_t{1} << 62);
+constexpr int64_t MAX_INLINE = (int64_t{1} << 62) - 1;
+
+constexpr int64_t Tag(int64_t value) {
+    return value * 2 + 1;
+}
+
+// Results of compiled code: the slot of the returned value or one of these
+constexpr int64_t NO_RESULT = -1;
+constexpr int64_t FAILED_RESULT = -2;
+
+// Results of helpers called from compiled code. Conditions return 0 or 1
+constexpr int DONE = 0;
+constexpr int FAILED = 2;
+
+// Values of comparisons and logical operations used as values
+runtime::Bool TRUE_VALUE{true};
+runtime::Bool FALSE_VALUE{false};
+
+size_t PageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+// Native frame of a compiled method. Slot 0 is self, the parameters follow, then the local
+// variables and the temporaries of expressions. Values are owned by the frame, so compiled
+// code never has to release anything, and its exits are plain returns
+struct Frame {
+    runtime::Context& context;
+    int64_t* words;
+    ObjectHolder* boxes;
+    // Exceptions cannot unwind through the generated code, a helper stores it here
+    exception_ptr error;
+
+    [[nodiscard]] ObjectHolder Get(uint32_t slot) const {
+        const int64_t word = words[slot];
+        if ((word & 1) != 0)
+        {
+            return ObjectHolder::Own(runtime::Number(word >> 1));
+        }
+        return boxes[slot];
+    }
+
+    void Set(uint32_t slot, ObjectHolder value) {
+        if (value.GetKind() == runtime::ObjectKind::Number)
+        {
+            const bigint::Integer& number = runtime::ValueOf<bigint::Integer>(value);
+            if (number.IsSmall() && number.GetSmall() >= MIN_INLINE && number.GetSmall() <= MAX_INLINE)
+            {
+                // The stale box is dropped when the slot gets the next boxed value
+                words[slot] = Tag(number.GetSmall());
+                return;
+            }
+        }
+        words[slot] = BOXED;
+        boxes[slot] = move(value);
+    }
+
+    [[nodiscard]] runtime::ClassInstance& Instance(uint32_t slot) const {
+        if (words[slot] != BOXED || boxes[slot].GetKind() != runtime::ObjectKind::ClassInstance)
+        {
+            throw std::runtime_error("Not implemented"s);
+        }
+        return static_cast<runtime::ClassInstance&>(*boxes[slot]);
+    }
+};
+
+// Method call in compiled code. The method is looked up once for each class of the object
+struct CallSite {
+    const string* method = nullptr;
+    vector<uint32_t> args;
+    uint32_t object = 0u;
+    const runtime::Class* cls = nullptr;
+    const runtime::Method* target = nullptr;
+
+    const runtime::Method& Resolve(const runtime::ClassInstance& instance) {
+        if (&instance.GetClass() != cls)
+        {
+            target = instance.GetClass().GetMethod(*method);
+            if (target == nullptr)
+            {
+                throw std::runtime_error("Not implemented"s);
+            }
+            cls = &instance.GetClass();
+        }
+        return *target;
+    }
+};
+
+// Runs the body of a helper. Generated code has no unwind information, so no exception may
+// leave a helper: it is stored in the frame, and the helper returns FAILED
+template <typename F>
+int Guarded(Frame& frame, F f) {
+    try
+    {
+        return f();
+    }
+    catch (...)
+    {
+        frame.error = current_exception();
+        return FAILED;
+    }
+}
+
+// Helpers called from compiled code with the frame in the first argument
+
+int ArithmeticHelper(Frame* frame, uint32_t op, uint32_t lhs, uint32_t rhs, uint32_t target) {
+    return Guarded(*frame, [&] {
+        ObjectHolder result = ast::Calculate(static_cast<runtime::ArithmeticOp>(op), frame->Get(lhs),
+                                             frame->Get(rhs), frame->context);
+        frame->Set(target, move(result));
+        return DONE;
+    });
+}
+
+int CompareHelper(Frame* frame, uint32_t op, uint32_t lhs, uint32_t rhs) {
+    return Guarded(*frame, [&] {
+        return runtime::Compare(static_cast<runtime::CompareOp>(op), frame->Get(lhs), frame->Get(rhs),
+                                frame->context) ? 1 : 0;
+    });
+}
+
+int TruthHelper(Frame* frame, uint32_t slot) {
+    return Guarded(*frame, [&] {
+        return runtime::IsTrue(frame->boxes[slot]) ? 1 : 0;
+    });
+}
+
+int CopyHelper(Frame* frame, uint32_t source, uint32_t target) {
+    return Guarded(*frame, [&] {
+        frame->words[target] = frame->words[source];
+        frame->boxes[target] = frame->boxes[source];
+        return DONE;
+    });
+}
+
+int ConstantHelper(Frame* frame, runtime::Object* constant, uint32_t target) {
+    return Guarded(*frame, [&] {
+        // Share allocates the control block of the holder
+        frame->Set(target, constant != nullptr ? ObjectHolder::Share(*constant) : ObjectHolder::None());
+        return DONE;
+    });
+}
+
+int LoadFieldHelper(Frame* frame, uint32_t object, const string* name, uint32_t target) {
+    return Guarded(*frame, [&] {
+        const runtime::Closure& fields = frame->Instance(object).Fields();
+        const auto it = fields.find(*name);
+        if (it == fields.end())
+        {
+            throw std::runtime_error("Not implemented"s);
+        }
+        // The field may hold the only reference to the object in the target slot
+        ObjectHolder value = it->second;
+        frame->Set(target, move(value));
+        return DONE;
+    });
+}
+
+int StoreFieldHelper(Frame* frame, uint32_t object, const string* name, uint32_t value) {
+    return Guarded(*frame, [&] {
+        frame->Instance(object).Fields()[*name] = frame->Get(value);
+        return DONE;
+    });
+}
+
+int MethodCallHelper(Frame* frame, CallSite* site, uint32_t target) {
+    return Guarded(*frame, [&] {
+        vector<ObjectHolder> args;
+        args.reserve(site->args.size());
+        for (const uint32_t slot : site->args)
+        {
+            args.push_back(frame->Get(slot));
+        }
+        runtime::ClassInstance& instance = frame->Instance(site->object);
+        ObjectHolder result = instance.Call(site->Resolve(instance), args, frame->context);
+        frame->Set(target, move(result));
+        return DONE;
+    });
+}
+
+// Records the call in the context like Return::Execute does, the caller makes it
+int TailCallHelper(Frame* frame, CallSite* site) {
+    return Guarded(*frame, [&] {
+        runtime::TailCall& call = *frame->context.GetTailCall();
+        call.args.clear();
+        for (const uint32_t slot : site->args)
+        {
+            call.args.push_back(frame->Get(slot));
+        }
+        call.instance = frame->Get(site->object);
+        call.method = site->method;
+        frame->context.SetCompletion(runtime::Completion::TailCall);
+        return DONE;
+    });
+}
+
+int RangeHelper(Frame* frame, uint32_t begin, uint32_t end) {
+    return Guarded(*frame, [&] {
+        if (frame->Get(begin).GetKind() != runtime::ObjectKind::Number
+            || frame->Get(end).GetKind() != runtime::ObjectKind::Number)
+        {
+            throw std::runtime_error("range() arguments must be numbers"s);
+        }
+        return DONE;
+    });
+}
+
+int UnboundHelper(Frame* frame) {
+    frame->error = make_exception_ptr(std::runtime_error("Not implemented"s));
+    return FAILED;
+}
+
+// Pages holding the code of a method. They are written first and then made executable,
+// so that no page is ever writable and executable
+class ExecutableCode {
+public:
+    explicit ExecutableCode(const vector<uint8_t>& code)
+        :size_((code.size() + PageSize() - 1u) / PageSize() * PageSize()) {
+        memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory_ == MAP_FAILED)
+        {
+            throw runtime_error("Cannot map pages for compiled code"s);
+        }
+        memcpy(memory_, code.data(), code.size());
+        if (mprotect(memory_, size_, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(memory_, size_);
+            throw runtime_error("Cannot make compiled code executable"s);
+        }
+    }
+
+    ~ExecutableCode() {
+        munmap(memory_, size_);
+    }
+
+    ExecutableCode(const ExecutableCode&) = delete;
+    ExecutableCode& operator=(const ExecutableCode&) = delete;
+
+    [[nodiscard]] const void* Get() const {
+        return memory_;
+    }
+
+private:
+    size_t size_;
+    void* memory_ = nullptr;
+};
+
+enum class Reg : uint8_t {
+    Rax = 0,
+    Rcx = 1,
+    Rdx = 2,
+    Rbx = 3,
+    Rsp = 4,
+    Rbp = 5,
+    Rsi = 6,
+    Rdi = 7,
+    R8 = 8,
+    R9 = 9,
+    R12 = 12,
+};
+
+// Condition codes of jcc. A condition and its negation differ in the lowest bit
+enum class Condition : uint8_t {
+    Overflow = 0x0,
+    Equal = 0x4,
+    NotEqual = 0x5,
+    Less = 0xc,
+    GreaterOrEqual = 0xd,
+    LessOrEqual = 0xe,
+    Greater = 0xf,
+};
+
+Condition Negate(Condition condition) {
+    return static_cast<Condition>(static_cast<uint8_t>(condition) ^ 1u);
+}
+
+Condition ConditionOf(runtime::CompareOp op) {
+    switch (op)
+    {
+    case runtime::CompareOp::Equal:
+        return Condition::Equal;
+    case runtime::CompareOp::NotEqual:
+        return Condition::NotEqual;
+    case runtime::CompareOp::Less:
+        return Condition::Less;
+    case runtime::CompareOp::Greater:
+        return Condition::Greater;
+    case runtime::CompareOp::LessOrEqual:
+        return Condition::LessOrEqual;
+    case runtime::CompareOp::GreaterOrEqual:
+        break;
+    }
+    return Condition::GreaterOrEqual;
+}
+
+// Opcodes of the register forms of two-operand instructions
+enum class Alu : uint8_t {
+    Add = 0x01,
+    Or = 0x09,
+    And = 0x21,
+    Sub = 0x29,
+    Cmp = 0x39,
+};
+
+// Opcode extensions of the 83 /n forms with an 8-bit immediate
+enum class AluImmediate : uint8_t {
+    Add = 0,
+    Or = 1,
+    Sub = 5,
+    Cmp = 7,
+};
+
+class Label {
+    friend class Assembler;
+
+    static constexpr size_t UNBOUND_LABEL = static_cast<size_t>(-1);
+
+    size_t position_ = UNBOUND_LABEL;
+    // Offsets of the rel32 fields of jumps made before the label was bound
+    vector<size_t> jumps_;
+};
+
+// Encoder of the few x86-64 instructions compiled code needs. rbx points to the slot words,
+// so slots are addressed as [rbx + 8 * slot]
+class Assembler {
+public:
+    void Load(Reg reg, uint32_t slot) {
+        Rex(reg, Reg::Rbx);
+        Byte(0x8b);
+        SlotOperand(static_cast<uint8_t>(reg), slot);
+    }
+
+    void Store(uint32_t slot, Reg reg) {
+        Rex(reg, Reg::Rbx);
+        Byte(0x89);
+        SlotOperand(static_cast<uint8_t>(reg), slot);
+    }
+
+    // cmp qword [rbx + 8 * slot], value
+    void CompareSlot(uint32_t slot, int8_t value) {
+        Rex(Reg::Rax, Reg::Rbx);
+        Byte(0x83);
+        SlotOperand(7u, slot);
+        Byte(static_cast<uint8_t>(value));
+    }
+
+    void MoveImmediate(Reg reg, int64_t value) {
+        if (value >= INT32_MIN && value <= INT32_MAX)
+        {
+            Rex(Reg::Rax, reg);
+            Byte(0xc7);
+            Direct(0u, reg);
+            Int32(static_cast<int32_t>(value));
+            return;
+        }
+        Rex(Reg::Rax, reg);
+        Byte(0xb8 + (static_cast<uint8_t>(reg) & 7u));
+        for (size_t i = 0u; i < sizeof(value); ++i)
+        {
+            Byte(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8u * i)));
+        }
+    }
+
+    void Move(Reg target, Reg source) {
+        RegisterForm(0x89, target, source);
+    }
+
+    void Apply(Alu op, Reg target, Reg source) {
+        RegisterForm(static_cast<uint8_t>(op), target, source);
+    }
+
+    void Apply(AluImmediate op, Reg target, int8_t value) {
+        Rex(Reg::Rax, target);
+        Byte(0x83);
+        Direct(static_cast<uint8_t>(op), target);
+        Byte(static_cast<uint8_t>(value));
+    }
+
+    // sar reg, 1
+    void ShiftRight(Reg reg) {
+        Rex(Reg::Rax, reg);
+        Byte(0xd1);
+        Direct(7u, reg);
+    }
+
+    // imul target, source
+    void Multiply(Reg target, Reg source) {
+        Rex(target, source);
+        Byte(0x0f);
+        Byte(0xaf);
+        Direct(static_cast<uint8_t>(target), source);
+    }
+
+    // cqo; idiv divisor
+    void Divide(Reg divisor) {
+        Byte(0x48);
+        Byte(0x99);
+        Rex(Reg::Rax, divisor);
+        Byte(0xf7);
+        Direct(7u, divisor);
+    }
+
+    // test reg8, 1 for al, cl, dl or bl
+    void TestLowBit(Reg reg) {
+        Byte(0xf6);
+        Direct(0u, reg);
+        Byte(1u);
+    }
+
+    // cmp eax, value, for the int results of helpers
+    void CompareResult(int8_t value) {
+        Byte(0x83);
+        Direct(7u, Reg::Rax);
+        Byte(static_cast<uint8_t>(value));
+    }
+
+    void Push(Reg reg) {
+        if (static_cast<uint8_t>(reg) >= 8u)
+        {
+            Byte(0x41);
+        }
+        Byte(0x50 + (static_cast<uint8_t>(reg) & 7u));
+    }
+
+    void Pop(Reg reg) {
+        if (static_cast<uint8_t>(reg) >= 8u)
+        {
+            Byte(0x41);
+        }
+        Byte(0x58 + (static_cast<uint8_t>(reg) & 7u));
+    }
+
+    // mov rax, function; call rax
+    void Call(const void* function) {
+        MoveImmediate(Reg::Rax, static_cast<int64_t>(reinterpret_cast<uintptr_t>(function)));
+        Byte(0xff);
+        Byte(0xd0);
+    }
+
+    void Return() {
+        Byte(0xc3);
+    }
+
+    void Jump(Label& label) {
+        Byte(0xe9);
+        Target(label);
+    }
+
+    void JumpIf(Condition condition, Label& label) {
+        Byte(0x0f);
+        Byte(0x80 + static_cast<uint8_t>(condition));
+        Target(label);
+    }
+
+    void Bind(Label& label) {
+        label.position_ = code_.size();
+        for (const size_t jump : label.jumps_)
+        {
+            Patch(jump, label.position_);
+        }
+        label.jumps_.clear();
+    }
+
+    [[nodiscard]] const vector<uint8_t>& GetCode() const {
+        return code_;
+    }
+
+private:
+    void Byte(uint8_t byte) {
+        code_.push_back(byte);
+    }
+
+    void Int32(int32_t value) {
+        for (size_t i = 0u; i < sizeof(value); ++i)
+        {
+            Byte(static_cast<uint8_t>(static_cast<uint32_t>(value) >> (8u * i)));
+        }
+    }
+
+    // REX.W with the high bits of the reg and rm fields
+    void Rex(Reg reg, Reg rm) {
+        Byte(0x48 | (static_cast<uint8_t>(reg) >= 8u ? 0x04 : 0x00)
+             | (static_cast<uint8_t>(rm) >= 8u ? 0x01 : 0x00));
+    }
+
+    void Direct(uint8_t reg, Reg rm) {
+        Byte(0xc0 | (reg & 7u) << 3u | (static_cast<uint8_t>(rm) & 7u));
+    }
+
+    void SlotOperand(uint8_t reg, uint32_t slot) {
+        Byte(0x80 | (reg & 7u) << 3u | static_cast<uint8_t>(Reg::Rbx));
+        Int32(static_cast<int32_t>(slot * sizeof(int64_t)));
+    }
+
+    // op target, source with the source in the reg field
+    void RegisterForm(uint8_t opcode, Reg target, Reg source) {
+        Rex(source, target);
+        Byte(opcode);
+        Direct(static_cast<uint8_t>(source), target);
+    }
+
+    void Target(Label& label) {
+        const size_t field = code_.size();
+        Int32(0);
+        if (label.position_ != Label::UNBOUND_LABEL)
+        {
+            Patch(field, label.position_);
+        }
+        else
+        {
+            label.jumps_.push_back(field);
+        }
+    }
+
+    void Patch(size_t field, size_t position) {
+        const auto offset = static_cast<int32_t>(static_cast<int64_t>(position) - static_cast<int64_t>(field + 4u));
+        for (size_t i = 0u; i < sizeof(offset); ++i)
+        {
+            code_[field + i] = static_cast<uint8_t>(static_cast<uint32_t>(offset) >> (8u * i));
+        }
+    }
+
+    vector<uint8_t> code_;
+};
+
+// Thrown when a body has a statement compiled code does not support
+struct Unsupported {};
+
+}  // namespace
+
+class CompiledMethod {
+public:
+    using Entry = int64_t (*)(Frame* frame, int64_t* words);
+
+    CompiledMethod(const vector<uint8_t>& code, size_t slot_count, vector<unique_ptr<CallSite>> call_sites)
+        :code_(code), slot_count_(slot_count), call_sites_(move(call_sites)) {}
+
+    ObjectHolder Run(runtime::ClassInstance& self, const vector<ObjectHolder>& args,
+                     runtime::Context& context) const {
+        // Frames of small methods stay on the native stack
+        static constexpr size_t INLINE_SLOTS = 16u;
+        array<int64_t, INLINE_SLOTS> inline_words;
+        array<ObjectHolder, INLINE_SLOTS> inline_boxes;
+        vector<int64_t> heap_words;
+        vector<ObjectHolder> heap_boxes;
+        int64_t* words = inline_words.data();
+        ObjectHolder* boxes = inline_boxes.data();
+        if (slot_count_ > INLINE_SLOTS)
+        {
+            heap_words.resize(slot_count_);
+            heap_boxes.resize(slot_count_);
+            words = heap_words.data();
+            boxes = heap_boxes.data();
+        }
+        fill(words, words + slot_count_, UNBOUND);
+
+        Frame frame{context, words, boxes, nullptr};
+        words[0] = BOXED;
+        boxes[0] = ObjectHolder::Share(self);
+        for (size_t i = 0u; i < args.size(); ++i)
+        {
+            frame.Set(static_cast<uint32_t>(i + 1u), args[i]);
+        }
+        const int64_t result = reinterpret_cast<Entry>(const_cast<void*>(code_.Get()))(&frame, words);
+        if (result == FAILED_RESULT)
+        {
+            rethrow_exception(frame.error);
+        }
+        if (result == NO_RESULT)
+        {
+            return {};
+        }
+        return frame.Get(static_cast<uint32_t>(result));
+    }
+
+private:
+    ExecutableCode code_;
+    size_t slot_count_;
+    // Compiled code points to the call sites
+    vector<unique_ptr<CallSite>> call_sites_;
+};
+
+// Translates a method body to machine code. The body is compiled twice: the first pass finds
+// the local variables, so that the second one can place the temporaries after them
+class MethodCompiler {
+public:
+    MethodCompiler(const runtime::Method& method, unordered_map<string, uint32_t> variables)
+        :method_(method), variables_(move(variables)) {
+        variables_["self"s] = 0u;
+        for (size_t i = 0u; i < method.formal_params.size(); ++i)
+        {
+            variables_[method.formal_params[i]] = static_cast<uint32_t>(i + 1u);
+        }
+        parameters_end_ = static_cast<uint32_t>(method.formal_params.size() + 1u);
+        temporaries_begin_ = static_cast<uint32_t>(variables_.size());
+        next_temporary_ = temporaries_begin_;
+    }
+
+    // Generates the code, throws Unsupported if the body cannot be compiled
+    void Compile();
+
+    unordered_map<string, uint32_t> TakeVariables() {
+        return move(variables_);
+    }
+
+    unique_ptr<CompiledMethod> Finish() {
+        return make_unique<CompiledMethod>(assembler_.GetCode(), temporaries_begin_ + temporaries_used_,
+                                           move(call_sites_));
+    }
+
+private:
+    // Temporaries taken inside the scope are free again when it ends
+    class TemporaryScope {
+    public:
+        explicit TemporaryScope(MethodCompiler& compiler)
+            :compiler_(compiler), next_(compiler.next_temporary_) {}
+
+        ~TemporaryScope() {
+            compiler_.next_temporary_ = next_;
+        }
+
+        TemporaryScope(const TemporaryScope&) = delete;
+        TemporaryScope& operator=(const TemporaryScope&) = delete;
+
+    private:
+        MethodCompiler& compiler_;
+        uint32_t next_;
+    };
+
+    uint32_t Variable(const string& name);
+    uint32_t Temporary();
+
+    void Statement(const runtime::Executable& node);
+    // Computes the value of the expression into target and returns target, or returns the slot
+    // of the variable the expression reads
+    uint32_t Expression(const runtime::Executable& node, uint32_t target);
+    // Jumps to label if the truth value of the condition equals truth
+    void Branch(const runtime::Executable& condition, bool truth, Label& label);
+
+    void ReadVariable(uint32_t slot);
+    void Arithmetic(runtime::ArithmeticOp op, uint32_t lhs, uint32_t rhs, uint32_t target);
+    void Compare(runtime::CompareOp op, uint32_t lhs, uint32_t rhs, bool truth, Label& label);
+    void Copy(uint32_t source, uint32_t target);
+    void Constant(runtime::Object* constant, uint32_t target);
+    void ForRange(const ast::ForRange& loop);
+    // Computes the arguments and the object of the call into temporaries of the current scope
+    CallSite* PrepareCall(const ast::MethodCall& call);
+
+    // Loads both slots into rax and rcx and jumps to slow unless both hold inline numbers
+    void LoadNumbers(uint32_t lhs, uint32_t rhs, Label& slow);
+    void CallHelper(const void* helper, initializer_list<uint64_t> args);
+    void CheckFailure();
+
+    const runtime::Method& method_;
+    unordered_map<string, uint32_t> variables_;
+    uint32_t parameters_end_ = 0u;
+    uint32_t temporaries_begin_ = 0u;
+    uint32_t next_temporary_ = 0u;
+    uint32_t temporaries_used_ = 0u;
+    vector<unique_ptr<CallSite>> call_sites_;
+
+    Assembler assembler_;
+    Label epilogue_;
+    Label failure_;
+    Label unbound_;
+};
+
+void MethodCompiler::Compile() {
+    // rbx and r12 are callee-saved and keep the slot words and the frame across helper calls.
+    // Three pushes after the return address keep the stack aligned for calls
+    assembler_.Push(Reg::Rbp);
+    assembler_.Move(Reg::Rbp, Reg::Rsp);
+    assembler_.Push(Reg::Rbx);
+    assembler_.Push(Reg::R12);
+    assembler_.Move(Reg::R12, Reg::Rdi);
+    assembler_.Move(Reg::Rbx, Reg::Rsi);
+
+    Statement(*method_.body);
+    assembler_.MoveImmediate(Reg::Rax, NO_RESULT);
+
+    assembler_.Bind(epilogue_);
+    assembler_.Pop(Reg::R12);
+    assembler_.Pop(Reg::Rbx);
+    assembler_.Pop(Reg::Rbp);
+    assembler_.Return();
+
+    assembler_.Bind(unbound_);
+    CallHelper(reinterpret_cast<const void*>(&UnboundHelper), {});
+    assembler_.Bind(failure_);
+    assembler_.MoveImmediate(Reg::Rax, FAILED_RESULT);
+    assembler_.Jump(epilogue_);
+}
+
+uint32_t MethodCompiler::Variable(const string& name) {
+    return variables_.emplace(name, static_cast<uint32_t>(variables_.size())).first->second;
+}
+
+uint32_t MethodCompiler::Temporary() {
+    const uint32_t slot = next_temporary_++;
+    temporaries_used_ = max(temporaries_used_, next_temporary_ - temporaries_begin_);
+    return slot;
+}
+
+void MethodCompiler::Statement(const runtime::Executable& node) {
+    TemporaryScope scope(*this);
+    if (const auto* body = dynamic_cast<const ast::MethodBody*>(&node))
+    {
+        Statement(*body->GetBody());
+        return;
+    }
+    if (const auto* compound = dynamic_cast<const ast::Compound*>(&node))
+    {
+        for (const auto& statement : compound->GetStatements())
+        {
+            Statement(*statement);
+        }
+        return;
+    }
+    if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&node))
+    {
+        const uint32_t target = Variable(assignment->GetVar());
+        Copy(Expression(*assignment->GetRv(), target), target);
+        return;
+    }
+    if (const auto* assignment = dynamic_cast<const ast::FieldAssignment*>(&node))
+    {
+        // The value is computed before the object, as in the interpreter
+        const uint32_t value = Expression(*assignment->GetRv(), Temporary());
+        const uint32_t object = Expression(assignment->GetObject(), Temporary());
+        CallHelper(reinterpret_cast<const void*>(&StoreFieldHelper),
+                   {object, reinterpret_cast<uintptr_t>(&assignment->GetFieldName()), value});
+        CheckFailure();
+        return;
+    }
+    if (const auto* return_statement = dynamic_cast<const ast::Return*>(&node))
+    {
+        if (return_statement->GetTailCall() != nullptr)
+        {
+            CallSite* site = PrepareCall(*return_statement->GetTailCall());
+            CallHelper(reinterpret_cast<const void*>(&TailCallHelper), {reinterpret_cast<uintptr_t>(site)});
+            CheckFailure();
+            assembler_.MoveImmediate(Reg::Rax, NO_RESULT);
+        }
+        else
+        {
+            assembler_.MoveImmediate(Reg::Rax, Expression(*return_statement->GetStatement(), Temporary()));
+        }
+        assembler_.Jump(epilogue_);
+        return;
+    }
+    if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&node))
+    {
+        Label otherwise;
+        Branch(*if_else->GetCondition(), false, otherwise);
+        Statement(*if_else->GetIfBody());
+        if (if_else->GetElseBody())
+        {
+            Label done;
+            assembler_.Jump(done);
+            assembler_.Bind(otherwise);
+            Statement(*if_else->GetElseBody());
+            assembler_.Bind(done);
+        }
+        else
+        {
+            assembler_.Bind(otherwise);
+        }
+        return;
+    }
+    if (const auto* loop = dynamic_cast<const ast::While*>(&node))
+    {
+        Label head;
+        Label exit;
+        assembler_.Bind(head);
+        Branch(*loop->GetCondition(), false, exit);
+        Statement(*loop->GetBody());
+        assembler_.Jump(head);
+        assembler_.Bind(exit);
+        return;
+    }
+    if (const auto* loop = dynamic_cast<const ast::ForRange*>(&node))
+    {
+        ForRange(*loop);
+        return;
+    }
+    // An expression whose value is dropped, usually a method call
+    Expression(node, Temporary());
+}
+
+uint32_t MethodCompiler::Expression(const runtime::Executable& node, uint32_t target) {
+    TemporaryScope scope(*this);
+    if (const auto* number = dynamic_cast<const ast::NumericConst*>(&node))
+    {
+        const bigint::Integer& value = number->GetValue().GetValue();
+        if (value.IsSmall() && value.GetSmall() >= MIN_INLINE && value.GetSmall() <= MAX_INLINE)
+        {
+            assembler_.MoveImmediate(Reg::Rax, Tag(value.GetSmall()));
+            assembler_.Store(target, Reg::Rax);
+        }
+        else
+        {
+            Constant(const_cast<runtime::Number*>(&number->GetValue()), target);
+        }
+        return target;
+    }
+    if (const auto* text = dynamic_cast<const ast::StringConst*>(&node))
+    {
+        Constant(const_cast<runtime::String*>(&text->GetValue()), target);
+        return target;
+    }
+    if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&node))
+    {
+        Constant(const_cast<runtime::Bool*>(&boolean->GetValue()), target);
+        return target;
+    }
+    if (dynamic_cast<const ast::None*>(&node) != nullptr)
+    {
+        Constant(nullptr, target);
+        return target;
+    }
+    if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&node))
+    {
+        if (const string* name = variable->GetVariableName())
+        {
+            const uint32_t slot = Variable(*name);
+            ReadVariable(slot);
+            return slot;
+        }
+        // Longer chains are looked up in the closure at every step, which only the
+        // interpreter reproduces
+        const auto [begin, end] = variable->GetIds();
+        if (end - begin != 2)
+        {
+            throw Unsupported{};
+        }
+        const uint32_t object = Variable(begin[0]);
+        ReadVariable(object);
+        CallHelper(reinterpret_cast<const void*>(&LoadFieldHelper),
+                   {object, reinterpret_cast<uintptr_t>(&begin[1]), target});
+        CheckFailure();
+        return target;
+    }
+    if (const auto* call = dynamic_cast<const ast::MethodCall*>(&node))
+    {
+        CallSite* site = PrepareCall(*call);
+        CallHelper(reinterpret_cast<const void*>(&MethodCallHelper), {reinterpret_cast<uintptr_t>(site), target});
+        CheckFailure();
+        return target;
+    }
+    const auto* binary = dynamic_cast<const ast::BinaryOperation*>(&node);
+    const bool logical = dynamic_cast<const ast::Comparison*>(&node) != nullptr
+                         || dynamic_cast<const ast::And*>(&node) != nullptr
+                         || dynamic_cast<const ast::Or*>(&node) != nullptr
+                         || dynamic_cast<const ast::Not*>(&node) != nullptr;
+    if (logical)
+    {
+        Label otherwise;
+        Label done;
+        Branch(node, false, otherwise);
+        Constant(&TRUE_VALUE, target);
+        assembler_.Jump(done);
+        assembler_.Bind(otherwise);
+        Constant(&FALSE_VALUE, target);
+        assembler_.Bind(done);
+        return target;
+    }
+    if (binary != nullptr)
+    {
+        runtime::ArithmeticOp op = runtime::ArithmeticOp::Add;
+        if (dynamic_cast<const ast::Sub*>(&node) != nullptr)
+        {
+            op = runtime::ArithmeticOp::Sub;
+        }
+        else if (dynamic_cast<const ast::Mult*>(&node) != nullptr)
+        {
+            op = runtime::ArithmeticOp::Mult;
+        }
+        else if (dynamic_cast<const ast::Div*>(&node) != nullptr)
+        {
+            op = runtime::ArithmeticOp::Div;
+        }
+        else if (dynamic_cast<const ast::Add*>(&node) == nullptr)
+        {
+            throw Unsupported{};
+        }
+        const uint32_t lhs = Expression(*binary->GetLhs(), Temporary());
+        const uint32_t rhs = Expression(*binary->GetRhs(), Temporary());
+        Arithmetic(op, lhs, rhs, target);
+        return target;
+    }
+    throw Unsupported{};
+}
+
+void MethodCompiler::Branch(const runtime::Executable& condition, bool truth, Label& label) {
+    TemporaryScope scope(*this);
+    if (const auto* negation = dynamic_cast<const ast::Not*>(&condition))
+    {
+        Branch(*negation->GetArgument(), !truth, label);
+        return;
+    }
+    const bool conjunction = dynamic_cast<const ast::And*>(&condition) != nullptr;
+    if (conjunction || dynamic_cast<const ast::Or*>(&condition) != nullptr)
+    {
+        const auto& logical = static_cast<const ast::BinaryOperation&>(condition);
+        // The left operand decides alone when it is false for and, true for or
+        if (truth != conjunction)
+        {
+            Branch(*logical.GetLhs(), truth, label);
+            Branch(*logical.GetRhs(), truth, label);
+        }
+        else
+        {
+            Label decided;
+            Branch(*logical.GetLhs(), !truth, decided);
+            Branch(*logical.GetRhs(), truth, label);
+            assembler_.Bind(decided);
+        }
+        return;
+    }
+    if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&condition))
+    {
+        const uint32_t lhs = Expression(*comparison->GetLhs(), Temporary());
+        const uint32_t rhs = Expression(*comparison->GetRhs(), Temporary());
+        Compare(comparison->GetOp(), lhs, rhs, truth, label);
+        return;
+    }
+
+    const uint32_t slot = Expression(condition, Temporary());
+    Label slow;
+    Label done;
+    assembler_.Load(Reg::Rax, slot);
+    assembler_.TestLowBit(Reg::Rax);
+    assembler_.JumpIf(Condition::Equal, slow);
+    assembler_.Apply(AluImmediate::Cmp, Reg::Rax, static_cast<int8_t>(Tag(0)));
+    assembler_.JumpIf(truth ? Condition::NotEqual : Condition::Equal, label);
+    assembler_.Jump(done);
+    assembler_.Bind(slow);
+    CallHelper(reinterpret_cast<const void*>(&TruthHelper), {slot});
+    CheckFailure();
+    assembler_.CompareResult(0);
+    assembler_.JumpIf(truth ? Condition::NotEqual : Condition::Equal, label);
+    assembler_.Bind(done);
+}
+
+void MethodCompiler::ReadVariable(uint32_t slot) {
+    // self and the parameters are always set
+    if (slot >= parameters_end_)
+    {
+        assembler_.CompareSlot(slot, static_cast<int8_t>(UNBOUND));
+        assembler_.JumpIf(Condition::Equal, unbound_);
+    }
+}
+
+void MethodCompiler::LoadNumbers(uint32_t lhs, uint32_t rhs, Label& slow) {
+    assembler_.Load(Reg::Rax, lhs);
+    assembler_.Load(Reg::Rcx, rhs);
+    assembler_.Move(Reg::Rdx, Reg::Rax);
+    assembler_.Apply(Alu::And, Reg::Rdx, Reg::Rcx);
+    assembler_.TestLowBit(Reg::Rdx);
+    assembler_.JumpIf(Condition::Equal, slow);
+}
+
+void MethodCompiler::Arithmetic(runtime::ArithmeticOp op, uint32_t lhs, uint32_t rhs, uint32_t target) {
+    Label slow;
+    Label done;
+    LoadNumbers(lhs, rhs, slow);
+    // With a = 2x + 1 and b = 2y + 1, a + b - 1 = 2(x + y) + 1, a - b = 2(x - y) and
+    // x * (b - 1) = 2xy. Each of them overflows exactly when the result does not fit inline
+    switch (op)
+    {
+    case runtime::ArithmeticOp::Add:
+        assembler_.Apply(AluImmediate::Sub, Reg::Rcx, 1);
+        assembler_.Apply(Alu::Add, Reg::Rax, Reg::Rcx);
+        assembler_.JumpIf(Condition::Overflow, slow);
+        break;
+    case runtime::ArithmeticOp::Sub:
+        assembler_.Apply(Alu::Sub, Reg::Rax, Reg::Rcx);
+        assembler_.JumpIf(Condition::Overflow, slow);
+        assembler_.Apply(AluImmediate::Or, Reg::Rax, 1);
+        break;
+    case runtime::ArithmeticOp::Mult:
+        assembler_.ShiftRight(Reg::Rax);
+        assembler_.Apply(AluImmediate::Sub, Reg::Rcx, 1);
+        assembler_.Multiply(Reg::Rax, Reg::Rcx);
+        assembler_.JumpIf(Condition::Overflow, slow);
+        assembler_.Apply(AluImmediate::Or, Reg::Rax, 1);
+        break;
+    case runtime::ArithmeticOp::Div:
+        // Division by zero is reported by the runtime
+        assembler_.ShiftRight(Reg::Rax);
+        assembler_.ShiftRight(Reg::Rcx);
+        assembler_.Apply(AluImmediate::Cmp, Reg::Rcx, 0);
+        assembler_.JumpIf(Condition::Equal, slow);
+        assembler_.Divide(Reg::Rcx);
+        assembler_.Apply(Alu::Add, Reg::Rax, Reg::Rax);
+        assembler_.JumpIf(Condition::Overflow, slow);
+        assembler_.Apply(AluImmediate::Or, Reg::Rax, 1);
+        break;
+    }
+    assembler_.Store(target, Reg::Rax);
+    assembler_.Jump(done);
+    assembler_.Bind(slow);
+    CallHelper(reinterpret_cast<const void*>(&ArithmeticHelper),
+               {static_cast<uint64_t>(op), lhs, rhs, target});
+    CheckFailure();
+    assembler_.Bind(done);
+}
+
+void MethodCompiler::Compare(runtime::CompareOp op, uint32_t lhs, uint32_t rhs, bool truth, Label& label) {
+    Label slow;
+    Label done;
+    LoadNumbers(lhs, rhs, slow);
+    // Inline numbers are ordered like the numbers themselves
+    assembler_.Apply(Alu::Cmp, Reg::Rax, Reg::Rcx);
+    assembler_.JumpIf(truth ? ConditionOf(op) : Negate(ConditionOf(op)), label);
+    assembler_.Jump(done);
+    assembler_.Bind(slow);
+    CallHelper(reinterpret_cast<const void*>(&CompareHelper), {static_cast<uint64_t>(op), lhs, rhs});
+    CheckFailure();
+    assembler_.CompareResult(0);
+    assembler_.JumpIf(truth ? Condition::NotEqual : Condition::Equal, label);
+    assembler_.Bind(done);
+}
+
+void MethodCompiler::Copy(uint32_t source, uint32_t target) {
+    if (source == target)
+    {
+        return;
+    }
+    Label slow;
+    Label done;
+    assembler_.Load(Reg::Rax, source);
+    assembler_.TestLowBit(Reg::Rax);
+    assembler_.JumpIf(Condition::Equal, slow);
+    assembler_.Store(target, Reg::Rax);
+    assembler_.Jump(done);
+    assembler_.Bind(slow);
+    CallHelper(reinterpret_cast<const void*>(&CopyHelper), {source, target});
+    CheckFailure();
+    assembler_.Bind(done);
+}
+
+void MethodCompiler::Constant(runtime::Object* constant, uint32_t target) {
+    CallHelper(reinterpret_cast<const void*>(&ConstantHelper), {reinterpret_cast<uintptr_t>(constant), target});
+    CheckFailure();
+}
+
+void MethodCompiler::ForRange(const ast::ForRange& loop) {
+    // The bounds are computed once, the counter is hidden from the body like in the interpreter
+    const uint32_t counter = Temporary();
+    const uint32_t end = Temporary();
+    const uint32_t one = Temporary();
+    Copy(Expression(*loop.GetBegin(), counter), counter);
+    Copy(Expression(*loop.GetEnd(), end), end);
+
+    Label checked;
+    Label slow;
+    LoadNumbers(counter, end, slow);
+    assembler_.Jump(checked);
+    assembler_.Bind(slow);
+    CallHelper(reinterpret_cast<const void*>(&RangeHelper), {counter, end});
+    CheckFailure();
+    assembler_.Bind(checked);
+    assembler_.MoveImmediate(Reg::Rax, Tag(1));
+    assembler_.Store(one, Reg::Rax);
+
+    const uint32_t variable = Variable(loop.GetVar());
+    Label head;
+    Label exit;
+    assembler_.Bind(head);
+    Compare(runtime::CompareOp::Less, counter, end, false, exit);
+    Copy(counter, variable);
+    Statement(*loop.GetBody());
+    Arithmetic(runtime::ArithmeticOp::Add, counter, one, counter);
+    assembler_.Jump(head);
+    assembler_.Bind(exit);
+}
+
+CallSite* MethodCompiler::PrepareCall(const ast::MethodCall& call) {
+    auto site = make_unique<CallSite>();
+    site->method = &call.GetMethod();
+    // Arguments are computed before the object, as in the interpreter
+    for (const auto& arg : call.GetArgs())
+    {
+        site->args.push_back(Expression(*arg, Temporary()));
+    }
+    site->object = Expression(*call.GetObject(), Temporary());
+    call_sites_.push_back(move(site));
+    return call_sites_.back().get();
+}
+
+void MethodCompiler::CallHelper(const void* helper, initializer_list<uint64_t> args) {
+    static constexpr array<Reg, 5> ARGUMENT_REGISTERS = {Reg::Rsi, Reg::Rdx, Reg::Rcx, Reg::R8, Reg::R9};
+    assembler_.Move(Reg::Rdi, Reg::R12);
+    size_t index = 0u;
+    for (const uint64_t arg : args)
+    {
+        assembler_.MoveImmediate(ARGUMENT_REGISTERS.at(index++), static_cast<int64_t>(arg));
+    }
+    assembler_.Call(helper);
+}
+
+void MethodCompiler::CheckFailure() {
+    assembler_.CompareResult(FAILED);
+    assembler_.JumpIf(Condition::Equal, failure_);
+}
+
+namespace {
+
+unique_ptr<CompiledMethod> CompileMethod(const runtime::Method& method) {
+    try
+    {
+        MethodCompiler first(method, {});
+        first.Compile();
+        MethodCompiler second(method, first.TakeVariables());
+        second.Compile();
+        return second.Finish();
+    }
+    catch (const Unsupported&)
+    {
+        return nullptr;
+    }
+}
+
+}  // namespace
+
+bool Compiler::IsSupported() {
+    return SUPPORTED;
+}
+
+Compiler::Compiler(size_t threshold)
+    :threshold_(threshold) {
+    if (!IsSupported())
+    {
+        throw runtime_error("The JIT compiler is not supported on this platform"s);
+    }
+}
+
+Compiler::~Compiler() = default;
+
+Compiler::Compiler(Compiler&& other) noexcept = default;
+
+Compiler& Compiler::operator=(Compiler&& other) noexcept = default;
+
+optional<ObjectHolder> Compiler::Call(const runtime::Method& method, runtime::ClassInstance& self,
+                                      const vector<ObjectHolder>& args, runtime::Context& context) {
+    MethodState& state = methods_[&method];
+    if (state.code == nullptr)
+    {
+        if (state.rejected || ++state.calls < threshold_)
+        {
+            return nullopt;
+        }
+        state.code = CompileMethod(method);
+        if (state.code == nullptr)
+        {
+            state.rejected = true;
+            ++stats_.rejected;
+            return nullopt;
+        }
+        ++stats_.compiled;
+    }
+    ++stats_.compiled_calls;
+    return state.code->Run(self, args, context);
+}
+
+void Compiler::WriteStats(ostream& os) const {
+    os << "JIT: "sv << stats_.compiled << " methods compiled, "sv << stats_.rejected
+       << " left to the interpreter, "sv << stats_.compiled_calls << " compiled calls\n"sv;
+}
+
+}  // namespace jit
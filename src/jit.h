@@ -0,0 +1,77 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Baseline compiler of hot methods to x86-64 machine code. Calls are counted as they enter
+// ClassInstance::Call, and a method called often enough has its body compiled into executable
+// pages. Compiled code keeps variables in the slots of a native frame instead of a Closure and
+// computes with numbers that fit in 63 bits inline; every other value and operation goes
+// through the same runtime functions the interpreter uses, so the output does not change.
+// Bodies with statements other than arithmetic, comparisons, logical operations, constants,
+// variables, fields, method calls, assignments, if, while, for-range and return stay with the
+// interpreter. Statements of compiled methods are invisible to the statement profiler
+namespace jit {
+
+struct Stats {
+    // Methods compiled to machine code
+    uint64_t compiled = 0u;
+    // Hot methods left to the interpreter because their bodies have unsupported statements
+    uint64_t rejected = 0u;
+    // Calls executed by compiled code
+    uint64_t compiled_calls = 0u;
+};
+
+class CompiledMethod;
+
+class Compiler {
+public:
+    // Calls of a method before it is compiled
+    static constexpr size_t DEFAULT_THRESHOLD = 100u;
+
+    // Returns true if machine code can be generated for this platform (x86-64 only)
+    static bool IsSupported();
+
+    // Compiles methods on their threshold-th call, or on the first one if threshold is 0.
+    // Throws runtime_error on other platforms than x86-64
+    explicit Compiler(size_t threshold = DEFAULT_THRESHOLD);
+    ~Compiler();
+
+    Compiler(Compiler&& other) noexcept;
+    Compiler& operator=(Compiler&& other) noexcept;
+
+    // Counts the call of method and runs its compiled code if the method is hot. Returns
+    // nullopt if the interpreter has to run the method. The number of arguments is checked
+    // by the caller
+    std::optional<runtime::ObjectHolder> Call(const runtime::Method& method,
+                                              runtime::ClassInstance& self,
+                                              const std::vector<runtime::ObjectHolder>& args,
+                                              runtime::Context& context);
+
+    [[nodiscard]] const Stats& GetStats() const {
+        return stats_;
+    }
+
+    // Writes the numbers of compiled and rejected methods and of compiled calls
+    void WriteStats(std::ostream& os) const;
+
+private:
+    struct MethodState {
+        size_t calls = 0u;
+        bool rejected = false;
+        std::unique_ptr<CompiledMethod> code;
+    };
+
+    size_t threshold_;
+    std::unordered_map<const runtime::Method*, MethodState> methods_;
+    Stats stats_;
+};
+
+}  // namespace jit
@@ -0,0 +1,210 @@
+#include "jit.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace jit {
+
+namespace {
+
+// Runs the program by the interpreter alone or with every method compiled on its first call
+// and returns its output, or the message of the error it fails with
+string Run(const string& source, bool compile, Stats* stats = nullptr) {
+    runtime::DummyContext context;
+    optional<Compiler> compiler;
+    if (compile)
+    {
+        compiler.emplace(1u);
+        context.SetJit(&*compiler);
+    }
+    try
+    {
+        RunProgram(source, context);
+    }
+    catch (const runtime_error& error)
+    {
+        context.output << "error: "s << error.what();
+    }
+    ASSERT_EQUAL(context.GetCallDepth(), 0u);
+    if (stats != nullptr && compiler)
+    {
+        *stats = compiler->GetStats();
+    }
+    return context.output.str();
+}
+
+void TestArithmeticMatchesInterpreter() {
+    if (!Compiler::IsSupported())
+    {
+        return;
+    }
+    const string source = R"(
+class Math:
+  def mix(a, b):
+    x = a * b - a / b + (a - b) * 3
+    if x > 100 and not x == 1000 or a < 0:
+      x = x - 100
+    return x
+
+  def factorial(n):
+    result = 1
+    for i in range(1, n + 1):
+      result = result * i
+    return result
+
+  def double(n):
+    return n + n
+
+m = Math()
+print m.mix(7, 2), m.mix(-7, 2), m.mix(1000, 3), m.mix(-1, -1)
+print m.factorial(5), m.factorial(25)
+print m.double(4611686018427387903), m.double(-4611686018427387904), m.double(9223372036854775807)
+print m.mix(4611686018427387904, -1)
+)"s;
+    Stats stats;
+    const string compiled = Run(source, true, &stats);
+    ASSERT_EQUAL(compiled, "26 -138 5558 -100\n"
+                           "120 15511210043330985984000000\n"
+                           "9223372036854775806 -9223372036854775808 18446744073709551614\n"
+                           "13835058055282163615\n"s);
+    ASSERT_EQUAL(compiled, Run(source, false));
+    ASSERT_EQUAL(stats.compiled, 3u);
+    ASSERT_EQUAL(stats.rejected, 0u);
+    ASSERT_EQUAL(stats.compiled_calls, 10u);
+}
+
+void TestFieldsAndCallsMatchInterpreter() {
+    if (!Compiler::IsSupported())
+    {
+        return;
+    }
+    const string source = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add(n):
+    self.value = self.value + n
+    return self.value
+
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+  def sum(n, acc):
+    if n == 0:
+      return acc
+    return self.sum(n - 1, acc + n)
+
+c = Counter()
+for i in range(5):
+  c.add(i)
+f = Fib()
+print c.value, c.add(10), f.calc(10), f.sum(1000, 0)
+)"s;
+    Stats stats;
+    const string compiled = Run(source, true, &stats);
+    ASSERT_EQUAL(compiled, "10 20 55 500500\n"s);
+    ASSERT_EQUAL(compiled, Run(source, false));
+    ASSERT_EQUAL(stats.compiled, 4u);
+    // Each call of a chain of tail calls is counted
+    ASSERT_EQUAL(stats.compiled_calls, 1185u);
+}
+
+void TestOtherValuesGoThroughTheRuntime() {
+    if (!Compiler::IsSupported())
+    {
+        return;
+    }
+    const string source = R"(
+class Money:
+  def __init__(amount):
+    self.amount = amount
+
+  def __add__(other):
+    return self.amount + other.amount
+
+  def __lt__(other):
+    return self.amount < other.amount
+
+class Ops:
+  def add(a, b):
+    return a + b
+
+  def less(a, b):
+    return a < b
+
+  def pick(flag, a, b):
+    if flag:
+      return a
+    return b
+
+  def show(a):
+    print a
+
+o = Ops()
+print o.add(2, 3), o.add("ab", "cd"), o.add(Money(1), Money(2))
+print o.less(Money(1), Money(2)), o.less("b", "a"), o.pick(None, 1, 2), o.pick("x", True, None)
+o.show(o.less(1, 2))
+)"s;
+    Stats stats;
+    const string compiled = Run(source, true, &stats);
+    ASSERT_EQUAL(compiled, "5 abcd 3\nTrue False 2 True\nTrue\n"s);
+    ASSERT_EQUAL(compiled, Run(source, false));
+    // Printing is left to the interpreter
+    ASSERT_EQUAL(stats.compiled, 6u);
+    ASSERT_EQUAL(stats.rejected, 1u);
+}
+
+void TestErrorsLeaveCompiledCode() {
+    if (!Compiler::IsSupported())
+    {
+        return;
+    }
+    const string calc = R"(
+class Calc:
+  def div(a, b):
+    return a / b
+
+  def unset(flag):
+    if flag:
+      x = 1
+    return x
+
+  def missing():
+    return self.nothing() + 1
+
+  def deep(n):
+    return 1 + self.deep(n + 1)
+
+c = Calc()
+print c.div(7, 2)
+)"s;
+    const vector<pair<string, string>> cases = {
+        {"print c.div(1, 0)"s, "error: Division by zero"s},
+        {"print c.unset(False)"s, "error: Not implemented"s},
+        {"print c.missing()"s, "error: Not implemented"s},
+        {"print c.deep(0)"s, "error: Recursion limit exceeded"s},
+    };
+    for (const auto& [statement, error] : cases)
+    {
+        const string compiled = Run(calc + statement, true);
+        ASSERT_EQUAL(compiled, "3\n"s + error);
+        ASSERT_EQUAL(compiled, Run(calc + statement, false));
+    }
+}
+
+}  // namespace
+
+void RunJitTests(TestRunner& tr) {
+    RUN_TEST(tr, jit::TestArithmeticMatchesInterpreter);
+    RUN_TEST(tr, jit::TestFieldsAndCallsMatchInterpreter);
+    RUN_TEST(tr, jit::TestOtherValuesGoThroughTheRuntime);
+    RUN_TEST(tr, jit::TestErrorsLeaveCompiledCode);
+}
+
+}  // namespace jit
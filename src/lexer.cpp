@@ -1,5 +1,7 @@
 #include "lexer.h"
 
+#include "metrics.h"
+
 #include <algorithm>
 #include <charconv>
 #include <unordered_map>
@@ -68,6 +70,9 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
     UNVALUED_OUTPUT(None);
     UNVALUED_OUTPUT(True);
     UNVALUED_OUTPUT(False);
+    UNVALUED_OUTPUT(While);
+    UNVALUED_OUTPUT(For);
+    UNVALUED_OUTPUT(In);
     UNVALUED_OUTPUT(Eof);
 
 #undef UNVALUED_OUTPUT
@@ -91,11 +96,14 @@ std::map<std::string, Token> const Lexer::keywords_tokens_ = {
     {">="s, token_type::GreaterOrEq{}},
     {"None"s, token_type::None{}},
     {"True"s, token_type::True{}},
-    {"False"s, token_type::False{}}
+    {"False"s, token_type::False{}},
+    {"while"s, token_type::While{}},
+    {"for"s, token_type::For{}},
+    {"in"s, token_type::In{}}
 };
 
-Lexer::Lexer(std::istream& input)
-    :input_(input)
+Lexer::Lexer(std::istream& input, metrics::Registry* metrics)
+    :input_(input), metrics_(metrics)
 {
     GoToStart();
     current_token_ = NextToken();
@@ -106,11 +114,28 @@ const Token& Lexer::CurrentToken() const {
 }
 
 Token Lexer::NextToken() {
+    if (metrics_ != nullptr)
+    {
+        metrics::PhaseTimer timer(metrics_->Interpreter().lex_seconds);
+        return ReadPositionedToken();
+    }
+    return ReadPositionedToken();
+}
+
+Token Lexer::ReadPositionedToken() {
+    Token token = ReadToken();
+    token.line = token_line_;
+    token.column = token_column_;
+    return current_token_ = token;
+}
+
+Token Lexer::ReadToken() {
 
     if (new_line_)
     {
         static size_t spaces = 0u;
         CountSpaces(spaces);
+        MarkTokenStart();
         size_t indent_lvl = spaces / indent_space_count_;
 
         if (Token* token = GetIndentOrDedentToken(indent_lvl))
@@ -121,7 +146,8 @@ Token Lexer::NextToken() {
     }
 
     SkipSpaces();
-    char peek = input_.get();
+    MarkTokenStart();
+    char peek = Get();
 
     if (isdigit(peek))  // Number
     {
@@ -138,7 +164,7 @@ Token Lexer::NextToken() {
     else if (peek == '#')   // Comment
     {
         SkipComment();
-        return current_token_ = NextToken();
+        return current_token_ = ReadToken();
     }
     else if (peek == '\n')  // NewLine
     {
@@ -158,6 +184,31 @@ Token Lexer::NextToken() {
 
 // Support functions
 
+char Lexer::Get()
+{
+    char c = input_.get();
+    if (input_.eof())
+    {
+        return c;
+    }
+    if (c == '\n')
+    {
+        ++line_;
+        column_ = 1u;
+    }
+    else
+    {
+        ++column_;
+    }
+    return c;
+}
+
+void Lexer::MarkTokenStart()
+{
+    token_line_ = line_;
+    token_column_ = column_;
+}
+
 void Lexer::GoToStart()
 {
     while (input_.peek() == ' ' || input_.peek() == '\n' || input_.peek() == '#')
@@ -167,7 +218,7 @@ void Lexer::GoToStart()
             SkipComment();
             continue;
         }
-        input_.get();
+        Get();
     }
 }
 
@@ -175,7 +226,7 @@ void Lexer::SkipComment()
 {
     while (input_.peek() != '\n' && !input_.eof()) 
     {
-        input_.get();
+        Get();
     }
 }
 
@@ -183,18 +234,18 @@ void Lexer::CountSpaces(size_t& spaces)
 {
     while (input_.peek() == '\n')   // skip for avoiding decreasing indent level
     {
-        input_.get();
+        Get();
     }
 
     while (input_.peek() == ' ')
     {
         ++spaces;
-        input_.get();
+        Get();
 
         if (input_.peek() == '\n')
         {
             spaces = 0u;
-            input_.get();
+            Get();
         }
     }
 }
@@ -203,7 +254,7 @@ void Lexer::SkipSpaces()
 {
     while (input_.peek() == ' ') 
     {
-        input_.get();
+        Get();
     }
 }
 
@@ -236,13 +287,13 @@ Token Lexer::GetNumberToken(char peek)
 {
     empty_line_ = false;
 
-    int number = atoi(&peek);
+    string digits;
+    digits += peek;
     while (isdigit(input_.peek()))
     {
-        peek = input_.get();
-        number = number * 10 + atoi(&peek);
+        digits += Get();
     }
-    return token_type::Number{ number };    
+    return token_type::Number{ bigint::Integer::Parse(digits) };
 }
 
 Token Lexer::GetIdToken(char peek)
@@ -254,7 +305,7 @@ Token Lexer::GetIdToken(char peek)
 
     while (std::isalpha(input_.peek()) || std::isdigit(input_.peek()) || input_.peek() == '_')
     {
-        id += input_.get();
+        id += Get();
     }
     
     if (keywords_tokens_.count(id))
@@ -275,7 +326,7 @@ Token Lexer::GetStringToken(char peek)
     char quote = peek;  // \' or \"
     bool escaped = false;
 
-    peek = input_.get();
+    peek = Get();
     string str;
     while (!input_.eof() && !(!escaped && peek == quote))
     {
@@ -298,7 +349,7 @@ Token Lexer::GetStringToken(char peek)
             }
             escaped = false;
         }
-        peek = input_.get();
+        peek = Get();
     }
     return token_type::String{ str };
 }
@@ -311,7 +362,7 @@ Token Lexer::GetNewLineToken()
         empty_line_ = true;
         return token_type::Newline{};
     }
-    return NextToken();
+    return ReadToken();
 }
 
 Token Lexer::GetEofToken()
@@ -334,7 +385,7 @@ Token Lexer::GetCharToken(char peek)
 
     if (keywords_tokens_.count(str))
     {
-        input_.get();
+        Get();
         return keywords_tokens_.at(str);
     }
     return token_type::Char{ peek };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "bigint.h"
+
 #include <iosfwd>
 #include <optional>
 #include <sstream>
@@ -8,11 +10,15 @@
 #include <variant>
 #include <map>
 
+namespace metrics {
+class Registry;
+}  // namespace metrics
+
 namespace parse {
 
 namespace token_type {
-struct Number {  // Лексема «число»
-    int value;   // число
+struct Number {               // Лексема «число»
+    bigint::Integer value;    // число любой длины
 };
 
 struct Id {             // Лексема «идентификатор»
@@ -47,6 +53,9 @@ struct GreaterOrEq {};  // Лексема «>=»
 struct None {};         // Лексема «None»
 struct True {};         // Лексема «True»
 struct False {};        // Лексема «False»
+struct While {};        // Лексема «while»
+struct For {};          // Лексема «for»
+struct In {};           // Лексема «in»
 }  // namespace token_type
 
 using TokenBase
@@ -55,7 +64,8 @@ using TokenBase
                    token_type::Def, token_type::Newline, token_type::Print, token_type::Indent,
                    token_type::Dedent, token_type::And, token_type::Or, token_type::Not,
                    token_type::Eq, token_type::NotEq, token_type::LessOrEq, token_type::GreaterOrEq,
-                   token_type::None, token_type::True, token_type::False, token_type::Eof>;
+                   token_type::None, token_type::True, token_type::False, token_type::While,
+                   token_type::For, token_type::In, token_type::Eof>;
 
 struct Token : TokenBase {
     using TokenBase::TokenBase;
@@ -74,6 +84,10 @@ struct Token : TokenBase {
     [[nodiscard]] const T* TryAs() const {
         return std::get_if<T>(this);
     }
+
+    // Позиция начала лексемы в исходном тексте (строки и столбцы нумеруются с 1)
+    size_t line = 0u;
+    size_t column = 0u;
 };
 
 bool operator==(const Token& lhs, const Token& rhs);
@@ -88,7 +102,8 @@ public:
 
 class Lexer {
 public:
-    explicit Lexer(std::istream& input);
+    // Если metrics не равен nullptr, время чтения токенов добавляется к метрике mython_lex_seconds
+    explicit Lexer(std::istream& input, metrics::Registry* metrics = nullptr);
 
     // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
     [[nodiscard]] const Token& CurrentToken() const;
@@ -140,6 +155,10 @@ public:
 
 private:
     // Support functions
+    Token ReadPositionedToken();
+    Token ReadToken();
+    char Get();
+    void MarkTokenStart();
     void GoToStart();
     void SkipComment();
     void SkipSpaces();
@@ -165,6 +184,14 @@ private:
 
     bool new_line_ = false;
     bool empty_line_ = true;
+
+    // Position of the next character in input_ and of the start of the token being read
+    size_t line_ = 1u;
+    size_t column_ = 1u;
+    size_t token_line_ = 1u;
+    size_t token_column_ = 1u;
+
+    metrics::Registry* metrics_ = nullptr;
 };
 
 }  // namespace parse
\ No newline at end of file
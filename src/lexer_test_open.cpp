@@ -40,6 +40,18 @@ void TestKeywords() {
     ASSERT_EQUAL(lexer.NextToken(), Token(token_type::False{}));
 }
 
+void TestLoopKeywords() {
+    istringstream input("while for i in range"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::While{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::For{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"i"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::In{}));
+    // range is an ordinary identifier
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"range"s}));
+}
+
 void TestNumbers() {
     istringstream input("42 15 -53"s);
     Lexer lexer(input);
@@ -351,11 +363,40 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestTokenPositions() {
+    istringstream is(R"(
+# comment
+x = 'a'
+if x:
+  print x
+)"s);
+    Lexer lexer(is);
+
+    auto assert_position = [](const Token& token, size_t line, size_t column) {
+        ASSERT_EQUAL(token.line, line);
+        ASSERT_EQUAL(token.column, column);
+    };
+
+    assert_position(lexer.CurrentToken(), 3u, 1u);  // x
+    assert_position(lexer.NextToken(), 3u, 3u);     // =
+    assert_position(lexer.NextToken(), 3u, 5u);     // 'a'
+    assert_position(lexer.NextToken(), 3u, 8u);     // Newline
+    assert_position(lexer.NextToken(), 4u, 1u);     // if
+    assert_position(lexer.NextToken(), 4u, 4u);     // x
+    assert_position(lexer.NextToken(), 4u, 5u);     // :
+    assert_position(lexer.NextToken(), 4u, 6u);     // Newline
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    assert_position(lexer.CurrentToken(), 5u, 3u);
+    assert_position(lexer.NextToken(), 5u, 3u);     // print
+    assert_position(lexer.NextToken(), 5u, 9u);     // x
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestSimpleAssignment);
     RUN_TEST(tr, parse::TestKeywords);
+    RUN_TEST(tr, parse::TestLoopKeywords);
     RUN_TEST(tr, parse::TestNumbers);
     RUN_TEST(tr, parse::TestIds);
     RUN_TEST(tr, parse::TestStrings);
@@ -367,6 +408,7 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestTokenPositions);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,10 +1,35 @@
+#include "census.h"
+#include "fold.h"
+#include "jit.h"
 #include "lexer.h"
+#include "memo.h"
+#include "metrics.h"
+#include "opcount.h"
+#include "output.h"
 #include "parse.h"
+#include "perfcount.h"
+#include "perfmap.h"
+#include "profiler.h"
+#include "range.h"
 #include "runtime.h"
+#include "sampler.h"
 #include "statement.h"
 #include "test_runner_p.h"
+#include "tracer.h"
 
+#include <algorithm>
+#include <csignal>
+#include <exception>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#include <pthread.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -22,17 +47,641 @@ void RunObjectsTests(TestRunner& tr);
 
 void TestParseProgram(TestRunner& tr);
 
+namespace profile {
+void RunProfilerTests(TestRunner& tr);
+}  // namespace profile
+
+namespace trace {
+void RunTracerTests(TestRunner& tr);
+}  // namespace trace
+
+namespace sample {
+void RunSamplerTests(TestRunner& tr);
+}  // namespace sample
+
+namespace census {
+void RunCensusTests(TestRunner& tr);
+}  // namespace census
+
+namespace metrics {
+void RunMetricsTests(TestRunner& tr);
+}  // namespace metrics
+
+namespace opcount {
+void RunOpCountTests(TestRunner& tr);
+}  // namespace opcount
+
+namespace perf {
+void RunPerfCountTests(TestRunner& tr);
+}  // namespace perf
+
+namespace perfmap {
+void RunPerfMapTests(TestRunner& tr);
+}  // namespace perfmap
+
+namespace fold {
+void RunFoldTests(TestRunner& tr);
+}  // namespace fold
+
+namespace output {
+void RunOutputTests(TestRunner& tr);
+}  // namespace output
+
+namespace memo {
+void RunMemoTests(TestRunner& tr);
+}  // namespace memo
+
+namespace bigint {
+void RunBigIntTests(TestRunner& tr);
+}  // namespace bigint
+
+namespace range {
+void RunRangeTests(TestRunner& tr);
+}  // namespace range
+
+namespace jit {
+void RunJitTests(TestRunner& tr);
+}  // namespace jit
+
 namespace {
 
+// Interpreter modes selected from the command line
+struct Options {
+    // --profile: print statements ordered by inclusive time to stderr at exit
+    bool profile = false;
+    // --coverage: print the source annotated with statement execution counts to stderr at exit
+    bool coverage = false;
+    // --profile-top N: number of rows in the hot lines, allocation sites and statement counters reports
+    size_t profile_top = 20u;
+    // --trace-folded FILE: write method call stacks for flamegraph.pl
+    string trace_folded;
+    // --trace-json FILE: write method calls as Chrome trace events
+    string trace_json;
+    // --trace-threshold-us N: log only calls lasting at least N microseconds to the Chrome trace
+    int64_t trace_threshold_us = 0;
+    // --sample-folded FILE: sample the Mython call stack on SIGPROF and write folded stacks
+    string sample_folded;
+    // --sample-frequency HZ: samples per second of CPU time
+    int sample_frequency = 99;
+    // --heap-census: print objects by kind and allocation site and the leaked ones to stderr at exit
+    bool heap_census = false;
+    // --metrics FILE: write interpreter metrics at exit and whenever SIGUSR1 is received
+    string metrics;
+    // --metrics-format prometheus|json
+    metrics::Format metrics_format = metrics::Format::Prometheus;
+    // --op-counts: print counts of abstract operations to stderr at exit. Needs MYTHON_OP_COUNTS
+    bool op_counts = false;
+    // --perf-counters: print hardware counters of the lex, parse and execute phases to stderr
+    bool perf_counters = false;
+    // --perf-statements: also print hardware counters of the top level statements
+    bool perf_statements = false;
+    // --perf-map: call methods through trampolines listed in /tmp/perf-<pid>.map for `perf record`
+    bool perf_map = false;
+    // --output-buffer BYTES: write print output to stdout once BYTES are buffered. Instrumented
+    // runs write through std::cout instead
+    size_t output_buffer = output::BufferedContext::DEFAULT_FLUSH_THRESHOLD;
+    // --async-output: hand print output to a writer thread, so slow consumers of stdout do not
+    // stall the interpreter. Instrumented runs write through std::cout instead
+    bool async_output = false;
+    // --recursion-limit N: fail with "Recursion limit exceeded" instead of nesting more than N
+    // method calls. Tail calls do not nest
+    size_t recursion_limit = runtime::Context::DEFAULT_RECURSION_LIMIT;
+    // --memoize: cache results of pure methods called with Number, String and Bool arguments
+    bool memoize = false;
+    // --memo-size N: results kept in the cache, the least recently used ones are dropped
+    size_t memo_size = memo::MethodCache::DEFAULT_CAPACITY;
+    // --memo-stats: print cache hits and misses to stderr at exit
+    bool memo_stats = false;
+    // --range-stats: print how many Add, Sub and Mult operations were proven not to overflow
+    bool range_stats = false;
+    // --jit: compile hot methods to x86-64 machine code. The output stays the same, so it can be
+    // compared with a run without the flag. Statements of compiled methods are not profiled
+    bool jit = false;
+    // --jit-threshold N: calls of a method before it is compiled
+    size_t jit_threshold = jit::Compiler::DEFAULT_THRESHOLD;
+    // --jit-stats: print the numbers of compiled methods and calls to stderr at exit
+    bool jit_stats = false;
+
+    [[nodiscard]] bool Profiling() const {
+        return profile || coverage;
+    }
+
+    [[nodiscard]] bool Tracing() const {
+        return !trace_folded.empty() || !trace_json.empty();
+    }
+
+    [[nodiscard]] bool Sampling() const {
+        return !sample_folded.empty();
+    }
+
+    [[nodiscard]] bool Metrics() const {
+        return !metrics.empty();
+    }
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        if (arg == "--profile"sv)
+        {
+            options.profile = true;
+        }
+        else if (arg == "--coverage"sv)
+        {
+            options.coverage = true;
+        }
+        else if (arg == "--profile-top"sv && i + 1 < argc)
+        {
+            options.profile_top = stoul(argv[++i]);
+        }
+        else if (arg == "--heap-census"sv)
+        {
+            options.heap_census = true;
+        }
+        else if (arg == "--op-counts"sv)
+        {
+            if (!opcount::kEnabled)
+            {
+                throw runtime_error("--op-counts needs a build with -DMYTHON_OP_COUNTS=ON"s);
+            }
+            options.op_counts = true;
+        }
+        else if (arg == "--perf-counters"sv)
+        {
+            options.perf_counters = true;
+        }
+        else if (arg == "--perf-statements"sv)
+        {
+            options.perf_counters = true;
+            options.perf_statements = true;
+        }
+        else if (arg == "--perf-map"sv)
+        {
+            options.perf_map = true;
+        }
+        else if (arg == "--output-buffer"sv && i + 1 < argc)
+        {
+            options.output_buffer = stoul(argv[++i]);
+        }
+        else if (arg == "--async-output"sv)
+        {
+            options.async_output = true;
+        }
+        else if (arg == "--recursion-limit"sv && i + 1 < argc)
+        {
+            options.recursion_limit = stoul(argv[++i]);
+        }
+        else if (arg == "--memoize"sv)
+        {
+            options.memoize = true;
+        }
+        else if (arg == "--memo-size"sv && i + 1 < argc)
+        {
+            options.memo_size = stoul(argv[++i]);
+        }
+        else if (arg == "--memo-stats"sv)
+        {
+            options.memo_stats = true;
+        }
+        else if (arg == "--range-stats"sv)
+        {
+            options.range_stats = true;
+        }
+        else if (arg == "--jit"sv)
+        {
+            options.jit = true;
+        }
+        else if (arg == "--jit-threshold"sv && i + 1 < argc)
+        {
+            options.jit_threshold = stoul(argv[++i]);
+        }
+        else if (arg == "--jit-stats"sv)
+        {
+            options.jit_stats = true;
+        }
+        else if (arg == "--metrics"sv && i + 1 < argc)
+        {
+            options.metrics = argv[++i];
+        }
+        else if (arg == "--metrics-format"sv && i + 1 < argc)
+        {
+            string_view format = argv[++i];
+            if (format == "json"sv)
+            {
+                options.metrics_format = metrics::Format::Json;
+            }
+            else if (format == "prometheus"sv)
+            {
+                options.metrics_format = metrics::Format::Prometheus;
+            }
+            else
+            {
+                throw runtime_error("Unknown metrics format "s + string(format));
+            }
+        }
+        else if (arg == "--trace-folded"sv && i + 1 < argc)
+        {
+            options.trace_folded = argv[++i];
+        }
+        else if (arg == "--trace-json"sv && i + 1 < argc)
+        {
+            options.trace_json = argv[++i];
+        }
+        else if (arg == "--trace-threshold-us"sv && i + 1 < argc)
+        {
+            options.trace_threshold_us = stoll(argv[++i]);
+        }
+        else if (arg == "--sample-folded"sv && i + 1 < argc)
+        {
+            options.sample_folded = argv[++i];
+        }
+        else if (arg == "--sample-frequency"sv && i + 1 < argc)
+        {
+            options.sample_frequency = stoi(argv[++i]);
+        }
+        else
+        {
+            throw runtime_error("Unknown option "s + string(arg));
+        }
+    }
+    return options;
+}
+
+vector<string> SplitLines(const string& text) {
+    vector<string> lines;
+    istringstream input(text);
+    for (string line; getline(input, line);)
+    {
+        lines.push_back(move(line));
+    }
+    return lines;
+}
+
+ofstream OpenOutputFile(const string& path) {
+    ofstream file(path);
+    if (!file)
+    {
+        throw runtime_error("Cannot open "s + path);
+    }
+    return file;
+}
+
+// Reads all tokens of the source. The parser reads tokens on demand, so this is the only way
+// to measure the lexer alone
+void LexOnly(const string& source) {
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    while (!lexer.CurrentToken().Is<parse::token_type::Eof>())
+    {
+        lexer.NextToken();
+    }
+}
+
+// Returns the cache of pure method results if --memoize is given
+optional<memo::MethodCache> MakeMethodCache(const runtime::Executable& program, const Options& options) {
+    optional<memo::MethodCache> cache;
+    if (options.memoize)
+    {
+        cache.emplace(memo::FindPureMethods(program), options.memo_size);
+    }
+    return cache;
+}
+
+// Runs the passes over the parsed program that leave its behaviour unchanged
+void OptimizeProgram(runtime::Executable& program, const Options& options) {
+    fold::FoldConstants(program);
+    const range::Stats range_stats = range::ElideOverflowChecks(program);
+    if (options.range_stats)
+    {
+        range::WriteStats(range_stats, cerr);
+    }
+}
+
+void ReportMethodCache(const optional<memo::MethodCache>& cache, const Options& options) {
+    if (cache && options.memo_stats)
+    {
+        cache->WriteStats(cerr);
+    }
+}
+
+// Returns the compiler of hot methods if --jit is given
+optional<jit::Compiler> MakeCompiler(const Options& options) {
+    optional<jit::Compiler> compiler;
+    if (options.jit)
+    {
+        compiler.emplace(options.jit_threshold);
+    }
+    return compiler;
+}
+
+void ReportCompiler(const optional<jit::Compiler>& compiler, const Options& options) {
+    if (compiler && options.jit_stats)
+    {
+        compiler->WriteStats(cerr);
+    }
+}
+
+// Executes the top level statements one by one, measuring each of them
+void ExecuteMeasuringStatements(const runtime::Executable& program, runtime::Closure& closure,
+                                runtime::Context& context, perf::RegionCounters& statements) {
+    for (const auto& stmt : dynamic_cast<const ast::Compound&>(program).GetStatements())
+    {
+        auto scope = statements.Measure("line "s + to_string(stmt->GetPosition().line) + ' '
+                                        + profile::NodeTypeName(*stmt));
+        stmt->Execute(closure, context);
+        if (context.GetCompletion() == runtime::Completion::Return)
+        {
+            break;
+        }
+    }
+}
+
+// Runs the program with the requested instrumentation on and writes its reports at exit.
+// The source is read completely first, so that the reports can quote its lines
+void RunInstrumentedMythonProgram(istream& input, ostream& output, const Options& options) {
+    const string source{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+    istringstream source_input(source);
+
+    profile::NodeProfiler profiler;
+    if (options.Profiling())
+    {
+        profiler.Start();
+    }
+
+    ofstream trace_json;
+    optional<trace::Tracer> tracer;
+    if (options.Tracing())
+    {
+        trace::TracerOptions tracer_options;
+        if (!options.trace_json.empty())
+        {
+            trace_json = OpenOutputFile(options.trace_json);
+            tracer_options.chrome_trace = &trace_json;
+        }
+        tracer_options.threshold = chrono::microseconds(options.trace_threshold_us);
+        tracer.emplace(tracer_options);
+        tracer->Start();
+    }
+
+    // The dumping thread must be started before any other thread, see DumpOnSignal
+    optional<metrics::Registry> registry;
+    optional<metrics::DumpOnSignal> metrics_dump;
+    if (options.Metrics())
+    {
+        registry.emplace();
+        metrics_dump.emplace(*registry, options.metrics_format, options.metrics);
+    }
+    metrics::Registry* metrics = registry ? &*registry : nullptr;
+
+    optional<perf::CounterSet> perf_counters;
+    optional<perf::RegionCounters> perf_phases;
+    optional<perf::RegionCounters> perf_statements;
+    if (options.perf_counters)
+    {
+        perf_counters.emplace();
+        perf_phases.emplace(*perf_counters);
+        perf_statements.emplace(*perf_counters);
+        auto scope = perf_phases->Measure("lex"s);
+        LexOnly(source);
+    }
+
+    // Operations of the unit tests are not counted
+    opcount::Reset();
+    const auto parse_start = metrics::Clock::now();
+    optional<perf::RegionCounters::Scope> parse_scope;
+    if (perf_phases)
+    {
+        parse_scope.emplace(*perf_phases, "parse"s);
+    }
+    parse::Lexer lexer(source_input, metrics);
+    auto program = ParseProgram(lexer);
+    OptimizeProgram(*program, options);
+    parse_scope.reset();
+    if (metrics != nullptr)
+    {
+        metrics::InterpreterMetrics& interpreter = metrics->Interpreter();
+        const chrono::duration<double> parse_time = metrics::Clock::now() - parse_start;
+        interpreter.parse_seconds.Set(parse_time.count() - interpreter.lex_seconds.Get());
+    }
+
+    optional<sample::Sampler> sampler;
+    if (options.Sampling())
+    {
+        sample::SamplerOptions sampler_options;
+        sampler_options.frequency = options.sample_frequency;
+        sampler.emplace(sampler_options);
+        sampler->Start();
+    }
+    perfmap::PerfMap perf_map;
+    if (options.perf_map)
+    {
+        perf_map.Start();
+    }
+    // Objects created by the parser live as long as the program and are not counted
+    census::HeapCensus heap_census;
+    if (options.heap_census)
+    {
+        heap_census.Start();
+    }
+    {
+        optional<metrics::CountingOutput> counting_output;
+        optional<metrics::PhaseTimer> execute_timer;
+        if (metrics != nullptr)
+        {
+            counting_output.emplace(output, metrics->Interpreter().print_bytes);
+            execute_timer.emplace(metrics->Interpreter().execute_seconds);
+        }
+        // Cached results are freed before the heap census looks for leaks
+        optional<memo::MethodCache> method_cache = MakeMethodCache(*program, options);
+        optional<jit::Compiler> compiler = MakeCompiler(options);
+        runtime::SimpleContext context{counting_output ? *counting_output : output};
+        context.SetMetrics(metrics);
+        context.SetRecursionLimit(options.recursion_limit);
+        context.SetMethodCache(method_cache ? &*method_cache : nullptr);
+        context.SetJit(compiler ? &*compiler : nullptr);
+        runtime::Closure closure;
+        optional<perf::RegionCounters::Scope> execute_scope;
+        if (perf_phases)
+        {
+            execute_scope.emplace(*perf_phases, "execute"s);
+        }
+        if (options.perf_statements)
+        {
+            ExecuteMeasuringStatements(*program, closure, context, *perf_statements);
+        }
+        else
+        {
+            program->Execute(closure, context);
+        }
+        ReportMethodCache(method_cache, options);
+        ReportCompiler(compiler, options);
+    }
+    profiler.Stop();
+    heap_census.Stop();
+    perf_map.Stop();
+    output.flush();
+
+    if (sampler)
+    {
+        sampler->Stop();
+        ofstream folded = OpenOutputFile(options.sample_folded);
+        sampler->WriteFoldedStacks(folded);
+        cerr << "Sampler: " << sampler->GetSampleCount() << " samples, "
+             << sampler->GetDroppedCount() << " dropped\n";
+    }
+
+    // Names in the trace point into the program, so it is written before the program is gone
+    if (tracer)
+    {
+        tracer->Stop();
+        if (!options.trace_folded.empty())
+        {
+            ofstream folded = OpenOutputFile(options.trace_folded);
+            tracer->WriteFoldedStacks(folded);
+        }
+    }
+
+    if (registry)
+    {
+        metrics_dump.reset();
+        ofstream metrics_file = OpenOutputFile(options.metrics);
+        metrics::Write(*registry, options.metrics_format, metrics_file);
+    }
+
+    if (options.op_counts)
+    {
+        opcount::Write(cerr);
+    }
+
+    if (perf_counters)
+    {
+        if (!perf_counters->GetError().empty())
+        {
+            cerr << "Some hardware counters are unavailable: " << perf_counters->GetError() << '\n';
+        }
+        cerr << "Hardware counters (parse includes lexing):\n";
+        perf_phases->Report(cerr);
+        if (options.perf_statements)
+        {
+            cerr << "Top level statements:\n";
+            perf_statements->Report(cerr, options.profile_top);
+        }
+    }
+
+    if (options.heap_census)
+    {
+        heap_census.ReportHeap(cerr, options.profile_top);
+        heap_census.ReportLeaks(cerr);
+    }
+
+    const vector<string> source_lines = SplitLines(source);
+    if (options.profile)
+    {
+        profiler.ReportHotLines(cerr, source_lines, options.profile_top);
+    }
+    if (options.coverage)
+    {
+        profiler.ReportCoverage(cerr, source_lines);
+    }
+}
+
 void RunMythonProgram(istream& input, ostream& output) {
     parse::Lexer lexer(input);
     auto program = ParseProgram(lexer);
+    fold::FoldConstants(*program);
+    range::ElideOverflowChecks(*program);
 
     runtime::SimpleContext context{output};
     runtime::Closure closure;
     program->Execute(closure, context);
 }
 
+// Native stack reserved for each nested method call. The pages are committed when they are first
+// touched, so the memory used grows with the depth the program actually reaches
+constexpr size_t kStackBytesPerCall = 4u * 1024u;
+constexpr size_t kMinInterpreterStack = 8u * 1024u * 1024u;
+
+// Runs fn on a thread whose stack fits recursion_limit nested method calls and passes the
+// exceptions of fn on to the caller. The caller blocks signals while it waits, so signals sent
+// to the process, e.g. SIGPROF of the sampler, reach the interpreter thread or the threads it
+// starts
+void RunOnInterpreterStack(size_t recursion_limit, const function<void()>& fn) {
+    struct Task {
+        const function<void()>& fn;
+        exception_ptr error;
+    } task{fn, nullptr};
+
+    const size_t max_calls = (numeric_limits<size_t>::max() - kMinInterpreterStack) / kStackBytesPerCall;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    int result = pthread_attr_setstacksize(
+        &attributes, kMinInterpreterStack + min(recursion_limit, max_calls) * kStackBytesPerCall);
+    pthread_t thread;
+    if (result == 0)
+    {
+        result = pthread_create(&thread, &attributes, [](void* argument) -> void* {
+            auto& task = *static_cast<Task*>(argument);
+            try
+            {
+                task.fn();
+            }
+            catch (...)
+            {
+                task.error = current_exception();
+            }
+            return nullptr;
+        }, &task);
+    }
+    pthread_attr_destroy(&attributes);
+    if (result != 0)
+    {
+        throw system_error(result, generic_category(), "Cannot start the interpreter thread"s);
+    }
+    sigset_t all_signals;
+    sigset_t previous_mask;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &previous_mask);
+    pthread_join(thread, nullptr);
+    pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+    if (task.error)
+    {
+        rethrow_exception(task.error);
+    }
+}
+
+// Runs the program with print output gathered in large buffers and written straight to fd
+void RunMythonProgram(istream& input, int fd, const Options& options) {
+    parse::Lexer lexer(input);
+    auto program = ParseProgram(lexer);
+    OptimizeProgram(*program, options);
+
+    optional<memo::MethodCache> method_cache = MakeMethodCache(*program, options);
+    optional<jit::Compiler> compiler = MakeCompiler(options);
+    runtime::Closure closure;
+    if (options.async_output)
+    {
+        output::AsyncContext context(fd);
+        context.SetRecursionLimit(options.recursion_limit);
+        context.SetMethodCache(method_cache ? &*method_cache : nullptr);
+        context.SetJit(compiler ? &*compiler : nullptr);
+        program->Execute(closure, context);
+        context.Flush();
+    }
+    else
+    {
+        output::BufferedContext context(fd, options.output_buffer);
+        context.SetRecursionLimit(options.recursion_limit);
+        context.SetMethodCache(method_cache ? &*method_cache : nullptr);
+        context.SetJit(compiler ? &*compiler : nullptr);
+        program->Execute(closure, context);
+        context.Flush();
+    }
+    ReportMethodCache(method_cache, options);
+    ReportCompiler(compiler, options);
+}
+
 void TestSimplePrints() {
     istringstream input(R"(
 print 57
@@ -118,6 +767,20 @@ void TestAll() {
     runtime::RunObjectsTests(tr);
     ast::RunUnitTests(tr);
     TestParseProgram(tr);
+    profile::RunProfilerTests(tr);
+    trace::RunTracerTests(tr);
+    sample::RunSamplerTests(tr);
+    census::RunCensusTests(tr);
+    metrics::RunMetricsTests(tr);
+    opcount::RunOpCountTests(tr);
+    perf::RunPerfCountTests(tr);
+    perfmap::RunPerfMapTests(tr);
+    fold::RunFoldTests(tr);
+    output::RunOutputTests(tr);
+    memo::RunMemoTests(tr);
+    bigint::RunBigIntTests(tr);
+    range::RunRangeTests(tr);
+    jit::RunJitTests(tr);
 
     RUN_TEST(tr, TestSimplePrints);
     RUN_TEST(tr, TestAssignments);
@@ -127,11 +790,26 @@ void TestAll() {
 
 }  // namespace
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        const Options options = ParseOptions(argc, argv);
         TestAll();
 
-        RunMythonProgram(cin, cout);
+        const bool instrumented = options.Profiling() || options.Tracing() || options.Sampling()
+                                  || options.heap_census || options.Metrics() || options.op_counts
+                                  || options.perf_counters || options.perf_map;
+        // Hardware counters and the sampler measure the thread that starts them, so the
+        // instrumentation is set up on the interpreter thread as well
+        RunOnInterpreterStack(options.recursion_limit, [&options, instrumented] {
+            if (instrumented)
+            {
+                RunInstrumentedMythonProgram(cin, cout, options);
+            }
+            else
+            {
+                RunMythonProgram(cin, STDOUT_FILENO, options);
+            }
+        });
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
 		return 1;
@@ -0,0 +1,364 @@
+#include "memo.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace memo {
+
+namespace {
+
+const string kStr = "__str__"s;
+const array<string, 6> kComparisons = {
+    "__eq__"s, "__ne__"s, "__lt__"s, "__gt__"s, "__le__"s, "__ge__"s,
+};
+const string kAdd = "__add__"s;
+const string kSub = "__sub__"s;
+const string kMul = "__mul__"s;
+const string kTrueDiv = "__truediv__"s;
+
+bool IsKey(const runtime::ObjectHolder& value) {
+    switch (value.GetKind())
+    {
+    case runtime::ObjectKind::None:
+    case runtime::ObjectKind::Number:
+    case runtime::ObjectKind::String:
+    case runtime::ObjectKind::Bool:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool SameValue(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) {
+    if (lhs.GetKind() != rhs.GetKind())
+    {
+        return false;
+    }
+    switch (lhs.GetKind())
+    {
+    case runtime::ObjectKind::Number:
+        return runtime::ValueOf<bigint::Integer>(lhs) == runtime::ValueOf<bigint::Integer>(rhs);
+    case runtime::ObjectKind::String:
+    {
+        const auto& lhs_str = static_cast<const runtime::String&>(*lhs);  // NOLINT
+        const auto& rhs_str = static_cast<const runtime::String&>(*rhs);  // NOLINT
+        return lhs_str.GetHash() == rhs_str.GetHash() && lhs_str.GetValue() == rhs_str.GetValue();
+    }
+    case runtime::ObjectKind::Bool:
+        return runtime::ValueOf<bool>(lhs) == runtime::ValueOf<bool>(rhs);
+    default:
+        return true;
+    }
+}
+
+}  // namespace
+
+class PurityAnalysis {
+public:
+    explicit PurityAnalysis(const runtime::Executable& program) {
+        Collect(program);
+    }
+
+    unordered_set<const runtime::Method*> FindPureMethods() const;
+
+private:
+    // What a method body does, apart from calls
+    struct Summary {
+        bool has_effects = false;
+        // Names of the methods it may call
+        vector<const string*> calls;
+    };
+
+    // Calls visit for each statement or expression nested directly in node
+    template <typename Visit>
+    static void ForEachChild(const runtime::Executable& node, Visit visit);
+
+    void Collect(const runtime::Executable& node);
+    static void Summarize(const runtime::Executable& node, Summary& summary);
+
+    vector<const runtime::Method*> methods_;
+    unordered_map<string, vector<const runtime::Method*>> methods_by_name_;
+};
+
+template <typename Visit>
+void PurityAnalysis::ForEachChild(const runtime::Executable& node, Visit visit) {
+    const auto visit_optional = [&visit](const unique_ptr<ast::Statement>& child) {
+        if (child)
+        {
+            visit(*child);
+        }
+    };
+    if (const auto* compound = dynamic_cast<const ast::Compound*>(&node))
+    {
+        for (const auto& stmt : compound->GetStatements())
+        {
+            visit(*stmt);
+        }
+    }
+    else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&node))
+    {
+        visit(*if_else->GetCondition());
+        visit_optional(if_else->GetIfBody());
+        visit_optional(if_else->GetElseBody());
+    }
+    else if (const auto* while_loop = dynamic_cast<const ast::While*>(&node))
+    {
+        visit(*while_loop->GetCondition());
+        visit(*while_loop->GetBody());
+    }
+    else if (const auto* for_range = dynamic_cast<const ast::ForRange*>(&node))
+    {
+        visit(*for_range->GetBegin());
+        visit(*for_range->GetEnd());
+        visit(*for_range->GetBody());
+    }
+    else if (const auto* method_body = dynamic_cast<const ast::MethodBody*>(&node))
+    {
+        visit(*method_body->GetBody());
+    }
+    else if (const auto* return_stmt = dynamic_cast<const ast::Return*>(&node))
+    {
+        visit(*return_stmt->GetStatement());
+    }
+    else if (const auto* assignment = dynamic_cast<const ast::Assignment*>(&node))
+    {
+        visit(*assignment->GetRv());
+    }
+    else if (const auto* method_call = dynamic_cast<const ast::MethodCall*>(&node))
+    {
+        visit(*method_call->GetObject());
+        for (const auto& arg : method_call->GetArgs())
+        {
+            visit(*arg);
+        }
+    }
+    else if (const auto* unary = dynamic_cast<const ast::UnaryOperation*>(&node))
+    {
+        visit(*unary->GetArgument());
+    }
+    else if (const auto* binary = dynamic_cast<const ast::BinaryOperation*>(&node))
+    {
+        visit(*binary->GetLhs());
+        visit(*binary->GetRhs());
+    }
+}
+
+void PurityAnalysis::Collect(const runtime::Executable& node) {
+    if (const auto* class_definition = dynamic_cast<const ast::ClassDefinition*>(&node))
+    {
+        const auto& cls = class_definition->GetClass();
+        for (const runtime::Method& method : cls.GetMethods())
+        {
+            methods_.push_back(&method);
+            methods_by_name_[method.name].push_back(&method);
+            Collect(*method.body);
+        }
+        return;
+    }
+    ForEachChild(node, [this](const runtime::Executable& child) {
+        Collect(child);
+    });
+}
+
+void PurityAnalysis::Summarize(const runtime::Executable& node, Summary& summary) {
+    if (dynamic_cast<const ast::FieldAssignment*>(&node) != nullptr
+        || dynamic_cast<const ast::Print*>(&node) != nullptr
+        || dynamic_cast<const ast::NewInstance*>(&node) != nullptr
+        || dynamic_cast<const ast::ClassDefinition*>(&node) != nullptr)
+    {
+        summary.has_effects = true;
+        return;
+    }
+    if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&node))
+    {
+        summary.has_effects = summary.has_effects || variable->IsField();
+    }
+    else if (const auto* method_call = dynamic_cast<const ast::MethodCall*>(&node))
+    {
+        summary.calls.push_back(&method_call->GetMethod());
+    }
+    // Operations on instances call special methods
+    else if (dynamic_cast<const ast::Stringify*>(&node) != nullptr)
+    {
+        summary.calls.push_back(&kStr);
+    }
+    else if (dynamic_cast<const ast::Comparison*>(&node) != nullptr)
+    {
+        for (const string& name : kComparisons)
+        {
+            summary.calls.push_back(&name);
+        }
+    }
+    else if (dynamic_cast<const ast::Add*>(&node) != nullptr)
+    {
+        summary.calls.push_back(&kAdd);
+    }
+    else if (dynamic_cast<const ast::Sub*>(&node) != nullptr)
+    {
+        summary.calls.push_back(&kSub);
+    }
+    else if (dynamic_cast<const ast::Mult*>(&node) != nullptr)
+    {
+        summary.calls.push_back(&kMul);
+    }
+    else if (dynamic_cast<const ast::Div*>(&node) != nullptr)
+    {
+        summary.calls.push_back(&kTrueDiv);
+    }
+    ForEachChild(node, [&summary](const runtime::Executable& child) {
+        Summarize(child, summary);
+    });
+}
+
+unordered_set<const runtime::Method*> PurityAnalysis::FindPureMethods() const {
+    unordered_map<const runtime::Method*, Summary> summaries;
+    unordered_set<const runtime::Method*> pure;
+    for (const runtime::Method* method : methods_)
+    {
+        Summary& summary = summaries[method];
+        Summarize(*method->body, summary);
+        if (!summary.has_effects)
+        {
+            pure.insert(method);
+        }
+    }
+
+    // A method stops being pure when a method it may call does, until nothing changes
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (const runtime::Method* method : methods_)
+        {
+            if (pure.count(method) == 0u)
+            {
+                continue;
+            }
+            const auto calls_impure = [&](const string* name) {
+                const auto it = methods_by_name_.find(*name);
+                return it != methods_by_name_.end()
+                    && any_of(it->second.begin(), it->second.end(), [&](const runtime::Method* callee) {
+                           return pure.count(callee) == 0u;
+                       });
+            };
+            const vector<const string*>& calls = summaries.at(method).calls;
+            if (any_of(calls.begin(), calls.end(), calls_impure))
+            {
+                pure.erase(method);
+                changed = true;
+            }
+        }
+    }
+    return pure;
+}
+
+unordered_set<const runtime::Method*> FindPureMethods(const runtime::Executable& program) {
+    return PurityAnalysis(program).FindPureMethods();
+}
+
+MethodCache::MethodCache(unordered_set<const runtime::Method*> pure_methods, size_t capacity)
+    :pure_methods_(move(pure_methods)), capacity_(capacity) {}
+
+optional<size_t> MethodCache::Hash(const runtime::Class& cls, const runtime::Method& method,
+                                   const vector<runtime::ObjectHolder>& args) {
+    size_t hash = std::hash<const void*>{}(&cls) * 31u + std::hash<const void*>{}(&method);
+    for (const runtime::ObjectHolder& arg : args)
+    {
+        size_t value = 0u;
+        switch (arg.GetKind())
+        {
+        case runtime::ObjectKind::Number:
+            value = runtime::ValueOf<bigint::Integer>(arg).Hash();
+            break;
+        case runtime::ObjectKind::String:
+            // Strings keep their hash, so long strings are hashed once
+            value = static_cast<const runtime::String&>(*arg).GetHash();  // NOLINT
+            break;
+        case runtime::ObjectKind::Bool:
+            value = runtime::ValueOf<bool>(arg) ? 1u : 2u;
+            break;
+        default:
+            return nullopt;
+        }
+        hash = hash * 31u + (value ^ static_cast<size_t>(arg.GetKind()));
+    }
+    return hash;
+}
+
+MethodCache::Entries::iterator MethodCache::Lookup(size_t hash, const runtime::Class& cls,
+                                                   const runtime::Method& method,
+                                                   const vector<runtime::ObjectHolder>& args) {
+    const auto [begin, end] = index_.equal_range(hash);
+    for (auto it = begin; it != end; ++it)
+    {
+        const Entry& entry = *it->second;
+        if (entry.cls == &cls && entry.method == &method
+            && equal(entry.args.begin(), entry.args.end(), args.begin(), args.end(), SameValue))
+        {
+            return it->second;
+        }
+    }
+    return entries_.end();
+}
+
+optional<runtime::ObjectHolder> MethodCache::Find(const runtime::Class& cls,
+                                                  const runtime::Method& method,
+                                                  const vector<runtime::ObjectHolder>& args) {
+    const optional<size_t> hash = Hash(cls, method, args);
+    if (!hash)
+    {
+        return nullopt;
+    }
+    const auto entry = Lookup(*hash, cls, method, args);
+    if (entry == entries_.end())
+    {
+        ++stats_.misses;
+        return nullopt;
+    }
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, entry);
+    return entry->result;
+}
+
+void MethodCache::Store(const runtime::Class& cls, const runtime::Method& method,
+                        const vector<runtime::ObjectHolder>& args,
+                        const runtime::ObjectHolder& result) {
+    const optional<size_t> hash = Hash(cls, method, args);
+    if (capacity_ == 0u || !hash || !IsKey(result))
+    {
+        return;
+    }
+    if (const auto entry = Lookup(*hash, cls, method, args); entry != entries_.end())
+    {
+        entry->result = result;
+        entries_.splice(entries_.begin(), entries_, entry);
+        return;
+    }
+
+    entries_.push_front({&cls, &method, args, result, *hash});
+    index_.emplace(*hash, entries_.begin());
+    if (entries_.size() > capacity_)
+    {
+        const auto oldest = prev(entries_.end());
+        const auto [begin, end] = index_.equal_range(oldest->hash);
+        index_.erase(find_if(begin, end, [oldest](const auto& item) {
+            return item.second == oldest;
+        }));
+        entries_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+void MethodCache::WriteStats(ostream& os) const {
+    os << "Memoization: "sv << pure_methods_.size() << " pure methods, "sv << stats_.hits
+       << " hits, "sv << stats_.misses << " misses, "sv << stats_.evictions << " evictions, "sv
+       << entries_.size() << " results cached\n"sv;
+}
+
+}  // namespace memo
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Memoisation of pure methods. A method that neither reads nor changes fields, prints nothing
+// and creates no objects returns the same value whenever it gets the same arguments, so calls
+// with Number, String and Bool arguments can be answered from a cache
+namespace memo {
+
+// Returns the methods of the classes defined in the program that are pure: their bodies do not
+// assign or read fields, print or create instances, and every method they may call, including
+// __str__, comparison and arithmetic methods used by operations, is pure. Methods are called by
+// name, so a call of m is pure only if all methods named m are
+std::unordered_set<const runtime::Method*> FindPureMethods(const runtime::Executable& program);
+
+struct Stats {
+    uint64_t hits = 0u;
+    uint64_t misses = 0u;
+    // Results dropped to stay within the capacity
+    uint64_t evictions = 0u;
+};
+
+// Results of pure method calls keyed on the class of self, the method and the argument values.
+// A method inherited by a subclass may call methods the subclass overrides, so its results for
+// instances of different classes are kept apart. When the cache is full, the least recently
+// used result is dropped
+class MethodCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096u;
+
+    explicit MethodCache(std::unordered_set<const runtime::Method*> pure_methods,
+                         size_t capacity = DEFAULT_CAPACITY);
+
+    [[nodiscard]] bool IsPure(const runtime::Method& method) const {
+        return pure_methods_.count(&method) != 0u;
+    }
+
+    // Returns the stored result of the call of a pure method, nullopt if there is none.
+    // Calls with arguments other than Number, String and Bool are never stored
+    std::optional<runtime::ObjectHolder> Find(const runtime::Class& cls,
+                                              const runtime::Method& method,
+                                              const std::vector<runtime::ObjectHolder>& args);
+    // Stores the result of the call of a pure method if the arguments and the result are
+    // None, Number, String or Bool
+    void Store(const runtime::Class& cls, const runtime::Method& method,
+               const std::vector<runtime::ObjectHolder>& args,
+               const runtime::ObjectHolder& result);
+
+    [[nodiscard]] const Stats& GetStats() const {
+        return stats_;
+    }
+
+    [[nodiscard]] size_t GetSize() const {
+        return entries_.size();
+    }
+
+    // Writes the number of pure methods, the hits, misses and evictions
+    void WriteStats(std::ostream& os) const;
+
+private:
+    struct Entry {
+        const runtime::Class* cls;
+        const runtime::Method* method;
+        std::vector<runtime::ObjectHolder> args;
+        runtime::ObjectHolder result;
+        size_t hash;
+    };
+    using Entries = std::list<Entry>;
+
+    // Returns nullopt if some argument cannot be a key
+    static std::optional<size_t> Hash(const runtime::Class& cls, const runtime::Method& method,
+                                      const std::vector<runtime::ObjectHolder>& args);
+    Entries::iterator Lookup(size_t hash, const runtime::Class& cls, const runtime::Method& method,
+                             const std::vector<runtime::ObjectHolder>& args);
+
+    std::unordered_set<const runtime::Method*> pure_methods_;
+    size_t capacity_;
+    // The most recently used entry goes first
+    Entries entries_;
+    std::unordered_multimap<size_t, Entries::iterator> index_;
+    Stats stats_;
+};
+
+}  // namespace memo
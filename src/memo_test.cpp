@@ -0,0 +1,187 @@
+#include "lexer.h"
+#include "memo.h"
+#include "parse.h"
+#include "statement.h"
+
+#include "test_runner_p.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace memo {
+
+namespace {
+
+unique_ptr<runtime::Executable> Parse(const string& source) {
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    return ParseProgram(lexer);
+}
+
+// Names of the pure methods, sorted
+vector<string> PureMethodNames(const runtime::Executable& program) {
+    vector<string> names;
+    for (const runtime::Method* method : FindPureMethods(program))
+    {
+        names.push_back(method->name);
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+void TestFindsPureMethods() {
+    const auto program = Parse(R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+  def __str__():
+    return "point"
+
+class Math:
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+  def label(n):
+    for i in range(n):
+      s = str(i)
+    return "#" + s
+
+  def scaled(n):
+    return n * self.factor
+
+  def show(n):
+    print n
+
+  def remember(n):
+    self.last = n
+
+  def make():
+    return Point(1)
+
+  def indirect(n):
+    return self.show(n)
+
+  def deep(n):
+    return self.indirect(n)
+
+class Report:
+  def title(x):
+    return str(x)
+)"s);
+    ASSERT_EQUAL(PureMethodNames(*program), (vector<string>{"__str__"s, "fib"s, "label"s, "title"s}));
+}
+
+void TestImpureSpecialMethodsSpoilOperations() {
+    const auto program = Parse(R"(
+class Noisy:
+  def __eq__(other):
+    print "compared"
+    return True
+
+class Check:
+  def same(a, b):
+    return a == b
+
+  def sum(a, b):
+    return a + b
+)"s);
+    ASSERT_EQUAL(PureMethodNames(*program), (vector<string>{"sum"s}));
+}
+
+void TestCachesResults() {
+    const auto program = Parse(R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+  def greet(name, loud):
+    if loud:
+      return "Hello, " + name + "!"
+    return "Hello, " + name
+
+f = Fib()
+print f.calc(40), f.greet("Ann", True), f.greet("Ann", False), f.greet("Ann", True)
+)"s);
+    MethodCache cache(FindPureMethods(*program), 100u);
+    runtime::DummyContext context;
+    context.SetMethodCache(&cache);
+    runtime::Closure closure;
+    program->Execute(closure, context);
+
+    // Without the cache calc(40) takes hundreds of millions of calls
+    ASSERT_EQUAL(context.output.str(), "102334155 Hello, Ann! Hello, Ann Hello, Ann!\n"s);
+    ASSERT_EQUAL(cache.GetStats().misses, 41u + 2u);
+    ASSERT_EQUAL(cache.GetStats().hits, 38u + 1u);
+    ASSERT_EQUAL(cache.GetSize(), 43u);
+}
+
+void TestDropsLeastRecentlyUsed() {
+    const auto program = Parse(R"(
+class Square:
+  def of(n):
+    return n * n
+
+s = Square()
+x = s.of(1) + s.of(2) + s.of(1) + s.of(3) + s.of(2) + s.of(1)
+print x
+)"s);
+    MethodCache cache(FindPureMethods(*program), 2u);
+    runtime::DummyContext context;
+    context.SetMethodCache(&cache);
+    runtime::Closure closure;
+    program->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "20\n"s);
+    // of(3) drops of(2), which is computed again and drops of(1)
+    ASSERT_EQUAL(cache.GetStats().hits, 1u);
+    ASSERT_EQUAL(cache.GetStats().misses, 5u);
+    ASSERT_EQUAL(cache.GetStats().evictions, 3u);
+    ASSERT_EQUAL(cache.GetSize(), 2u);
+}
+
+void TestKeepsResultsOfSubclassesApart() {
+    const auto program = Parse(R"(
+class Base:
+  def f(x):
+    return self.g(x)
+
+  def g(x):
+    return x + 1
+
+class Derived(Base):
+  def g(x):
+    return x + 100
+
+b = Base()
+d = Derived()
+print b.f(1), d.f(1), b.f(1), d.f(1)
+)"s);
+    MethodCache cache(FindPureMethods(*program), 100u);
+    runtime::DummyContext context;
+    context.SetMethodCache(&cache);
+    runtime::Closure closure;
+    program->Execute(closure, context);
+
+    // Base.f called on a Derived instance calls Derived.g
+    ASSERT_EQUAL(context.output.str(), "2 101 2 101\n"s);
+    ASSERT_EQUAL(cache.GetStats().misses, 4u);
+    ASSERT_EQUAL(cache.GetStats().hits, 2u);
+}
+
+}  // namespace
+
+void RunMemoTests(TestRunner& tr) {
+    RUN_TEST(tr, memo::TestFindsPureMethods);
+    RUN_TEST(tr, memo::TestImpureSpecialMethodsSpoilOperations);
+    RUN_TEST(tr, memo::TestCachesResults);
+    RUN_TEST(tr, memo::TestDropsLeastRecentlyUsed);
+    RUN_TEST(tr, memo::TestKeepsResultsOfSubclassesApart);
+}
+
+}  // namespace memo
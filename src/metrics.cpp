@@ -0,0 +1,202 @@
+#include "metrics.h"
+
+#include <fstream>
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace metrics {
+
+void Metric::WriteHeader(ostream& os, const char* type) const {
+    os << "# HELP " << name_ << ' ' << help_ << '\n';
+    os << "# TYPE " << name_ << ' ' << type << '\n';
+}
+
+void Counter::WritePrometheus(ostream& os) const {
+    WriteHeader(os, "counter");
+    os << GetName() << ' ' << Get() << '\n';
+}
+
+void Counter::WriteJson(ostream& os) const {
+    os << Get();
+}
+
+void Gauge::WritePrometheus(ostream& os) const {
+    WriteHeader(os, "gauge");
+    os << GetName() << ' ' << Get() << '\n';
+}
+
+void Gauge::WriteJson(ostream& os) const {
+    os << Get();
+}
+
+Histogram::Histogram(string name, string help, vector<uint64_t> bounds)
+    :Metric(move(name), move(help)), bounds_(move(bounds)),
+     buckets_(make_unique<atomic<uint64_t>[]>(bounds_.size() + 1u)) {}
+
+void Histogram::Observe(uint64_t value) {
+    size_t bucket = 0u;
+    while (bucket < bounds_.size() && value > bounds_[bucket])
+    {
+        ++bucket;
+    }
+    buckets_[bucket].fetch_add(1u, memory_order_relaxed);
+    sum_.fetch_add(value, memory_order_relaxed);
+    count_.fetch_add(1u, memory_order_relaxed);
+}
+
+void Histogram::WritePrometheus(ostream& os) const {
+    WriteHeader(os, "histogram");
+    uint64_t cumulative = 0u;
+    for (size_t i = 0u; i < bounds_.size(); ++i)
+    {
+        cumulative += buckets_[i].load(memory_order_relaxed);
+        os << GetName() << "_bucket{le=\"" << bounds_[i] << "\"} " << cumulative << '\n';
+    }
+    cumulative += buckets_[bounds_.size()].load(memory_order_relaxed);
+    os << GetName() << "_bucket{le=\"+Inf\"} " << cumulative << '\n';
+    os << GetName() << "_sum " << GetSum() << '\n';
+    os << GetName() << "_count " << GetCount() << '\n';
+}
+
+void Histogram::WriteJson(ostream& os) const {
+    os << "{\"count\":" << GetCount() << ",\"sum\":" << GetSum() << ",\"buckets\":{";
+    uint64_t cumulative = 0u;
+    for (size_t i = 0u; i < bounds_.size(); ++i)
+    {
+        cumulative += buckets_[i].load(memory_order_relaxed);
+        os << '"' << bounds_[i] << "\":" << cumulative << ',';
+    }
+    cumulative += buckets_[bounds_.size()].load(memory_order_relaxed);
+    os << "\"+Inf\":" << cumulative << "}}";
+}
+
+InterpreterMetrics::InterpreterMetrics(Registry& registry)
+    :lex_seconds(registry.AddGauge("mython_lex_seconds"s, "Time spent in the lexer"s)),
+     parse_seconds(registry.AddGauge("mython_parse_seconds"s,
+                                     "Time spent in the parser, excluding the lexer"s)),
+     execute_seconds(registry.AddGauge("mython_execute_seconds"s,
+                                       "Time spent executing the program"s)),
+     method_calls(registry.AddCounter("mython_method_calls_total"s, "Method calls"s)),
+     objects_allocated(registry.AddCounter("mython_objects_allocated_total"s,
+                                           "Objects created by expressions"s)),
+     closure_lookups(registry.AddCounter("mython_closure_lookups_total"s,
+                                         "Names looked up in closures and fields"s)),
+     print_bytes(registry.AddCounter("mython_print_bytes_total"s, "Bytes written by print"s)),
+     string_bytes(registry.AddHistogram("mython_string_bytes"s, "Sizes of created strings"s,
+                                        {16u, 64u, 256u, 1024u, 4096u, 16384u, 65536u})) {}
+
+Registry::Registry()
+    :interpreter_(make_unique<InterpreterMetrics>(*this)) {}
+
+Counter& Registry::AddCounter(string name, string help) {
+    auto& metric = metrics_.emplace_back(make_unique<Counter>(move(name), move(help)));
+    return static_cast<Counter&>(*metric);
+}
+
+Gauge& Registry::AddGauge(string name, string help) {
+    auto& metric = metrics_.emplace_back(make_unique<Gauge>(move(name), move(help)));
+    return static_cast<Gauge&>(*metric);
+}
+
+Histogram& Registry::AddHistogram(string name, string help, vector<uint64_t> bounds) {
+    auto& metric = metrics_.emplace_back(make_unique<Histogram>(move(name), move(help), move(bounds)));
+    return static_cast<Histogram&>(*metric);
+}
+
+void Registry::WritePrometheus(ostream& os) const {
+    for (const auto& metric : metrics_)
+    {
+        metric->WritePrometheus(os);
+    }
+}
+
+void Registry::WriteJson(ostream& os) const {
+    os << '{';
+    bool first = true;
+    for (const auto& metric : metrics_)
+    {
+        if (!first)
+        {
+            os << ',';
+        }
+        first = false;
+        os << '"' << metric->GetName() << "\":";
+        metric->WriteJson(os);
+    }
+    os << "}\n";
+}
+
+void Write(const Registry& registry, Format format, ostream& os) {
+    if (format == Format::Json)
+    {
+        registry.WriteJson(os);
+    }
+    else
+    {
+        registry.WritePrometheus(os);
+    }
+}
+
+CountingOutput::CountingOutput(ostream& output, Counter& bytes)
+    :ostream(nullptr), buffer_(output.rdbuf(), bytes) {
+    rdbuf(&buffer_);
+}
+
+CountingOutput::Buffer::int_type CountingOutput::Buffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        return traits_type::not_eof(ch);
+    }
+    bytes_.Add();
+    return target_->sputc(traits_type::to_char_type(ch));
+}
+
+streamsize CountingOutput::Buffer::xsputn(const char* s, streamsize count) {
+    const streamsize written = target_->sputn(s, count);
+    bytes_.Add(static_cast<uint64_t>(written));
+    return written;
+}
+
+int CountingOutput::Buffer::sync() {
+    return target_->pubsync();
+}
+
+DumpOnSignal::DumpOnSignal(const Registry& registry, Format format, string path, int signal)
+    :registry_(registry), format_(format), path_(move(path)), signal_(signal) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, signal_);
+    pthread_sigmask(SIG_BLOCK, &set, &previous_mask_);
+    thread_ = thread([this] {
+        Run();
+    });
+}
+
+DumpOnSignal::~DumpOnSignal() {
+    stopping_.store(true, memory_order_release);
+    pthread_kill(thread_.native_handle(), signal_);
+    thread_.join();
+    pthread_sigmask(SIG_SETMASK, &previous_mask_, nullptr);
+}
+
+void DumpOnSignal::Run() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, signal_);
+    for (;;)
+    {
+        int received = 0;
+        if (sigwait(&set, &received) != 0 || stopping_.load(memory_order_acquire))
+        {
+            return;
+        }
+        ofstream file(path_);
+        Write(registry_, format_, file);
+        file.close();
+        dumps_.fetch_add(1u, memory_order_release);
+    }
+}
+
+}  // namespace metrics
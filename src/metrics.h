@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metrics {
+
+using Clock = std::chrono::steady_clock;
+
+// A named value exported by the registry
+class Metric {
+public:
+    Metric(std::string name, std::string help)
+        :name_(std::move(name)), help_(std::move(help)) {}
+    virtual ~Metric() = default;
+
+    [[nodiscard]] const std::string& GetName() const {
+        return name_;
+    }
+
+    // Writes "# HELP", "# TYPE" and the samples in the Prometheus text format
+    virtual void WritePrometheus(std::ostream& os) const = 0;
+    // Writes the value as a JSON value
+    virtual void WriteJson(std::ostream& os) const = 0;
+
+protected:
+    void WriteHeader(std::ostream& os, const char* type) const;
+
+private:
+    std::string name_;
+    std::string help_;
+};
+
+// Monotonic counter. Values may be read by a dumping thread while the interpreter updates them
+class Counter : public Metric {
+public:
+    using Metric::Metric;
+
+    void Add(uint64_t value = 1u) {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t Get() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+    void WritePrometheus(std::ostream& os) const override;
+    void WriteJson(std::ostream& os) const override;
+
+private:
+    std::atomic<uint64_t> value_{0u};
+};
+
+// Value that may go up and down, e.g. a duration of a phase in seconds
+class Gauge : public Metric {
+public:
+    using Metric::Metric;
+
+    void Set(double value) {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void Add(double value) {
+        value_.store(Get() + value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] double Get() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+    void WritePrometheus(std::ostream& os) const override;
+    void WriteJson(std::ostream& os) const override;
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+// Distribution of values over buckets with the given upper bounds
+class Histogram : public Metric {
+public:
+    Histogram(std::string name, std::string help, std::vector<uint64_t> bounds);
+
+    void Observe(uint64_t value);
+
+    [[nodiscard]] uint64_t GetCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t GetSum() const {
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+    void WritePrometheus(std::ostream& os) const override;
+    void WriteJson(std::ostream& os) const override;
+
+private:
+    std::vector<uint64_t> bounds_;
+    // One bucket per bound and the last one for larger values. Not cumulative
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0u};
+    std::atomic<uint64_t> sum_{0u};
+};
+
+class Registry;
+
+// Metrics updated by the interpreter itself
+struct InterpreterMetrics {
+    explicit InterpreterMetrics(Registry& registry);
+
+    Gauge& lex_seconds;
+    Gauge& parse_seconds;
+    Gauge& execute_seconds;
+    Counter& method_calls;
+    Counter& objects_allocated;
+    Counter& closure_lookups;
+    Counter& print_bytes;
+    Histogram& string_bytes;
+};
+
+// Set of metrics with stable addresses. Metrics are registered before the program runs,
+// so the registry is not locked when they are updated or written out
+class Registry {
+public:
+    // Registers the interpreter metrics
+    Registry();
+
+    Counter& AddCounter(std::string name, std::string help);
+    Gauge& AddGauge(std::string name, std::string help);
+    Histogram& AddHistogram(std::string name, std::string help, std::vector<uint64_t> bounds);
+
+    [[nodiscard]] InterpreterMetrics& Interpreter() {
+        return *interpreter_;
+    }
+
+    void WritePrometheus(std::ostream& os) const;
+    void WriteJson(std::ostream& os) const;
+
+private:
+    std::vector<std::unique_ptr<Metric>> metrics_;
+    std::unique_ptr<InterpreterMetrics> interpreter_;
+};
+
+// Adds the time spent in the scope to a gauge
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Gauge& gauge)
+        :gauge_(gauge), start_(Clock::now()) {}
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    ~PhaseTimer() {
+        gauge_.Add(std::chrono::duration<double>(Clock::now() - start_).count());
+    }
+
+private:
+    Gauge& gauge_;
+    Clock::time_point start_;
+};
+
+// Output stream forwarding everything to another stream and counting written bytes
+class CountingOutput : public std::ostream {
+public:
+    CountingOutput(std::ostream& output, Counter& bytes);
+
+private:
+    class Buffer : public std::streambuf {
+    public:
+        Buffer(std::streambuf* target, Counter& bytes)
+            :target_(target), bytes_(bytes) {}
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char* s, std::streamsize count) override;
+        int sync() override;
+
+    private:
+        std::streambuf* target_;
+        Counter& bytes_;
+    };
+
+    Buffer buffer_;
+};
+
+enum class Format {
+    Prometheus,
+    Json,
+};
+
+void Write(const Registry& registry, Format format, std::ostream& os);
+
+// Rewrites the file with the current metrics whenever the process receives the signal.
+// The signal is blocked in the calling thread, so it must be created before other threads
+// are started, and it is waited for by a dedicated thread, so dumps are not limited to
+// async-signal-safe code
+class DumpOnSignal {
+public:
+    DumpOnSignal(const Registry& registry, Format format, std::string path, int signal = SIGUSR1);
+    ~DumpOnSignal();
+
+    DumpOnSignal(const DumpOnSignal&) = delete;
+    DumpOnSignal& operator=(const DumpOnSignal&) = delete;
+
+    [[nodiscard]] uint64_t GetDumpCount() const {
+        return dumps_.load(std::memory_order_acquire);
+    }
+
+private:
+    void Run();
+
+    const Registry& registry_;
+    Format format_;
+    std::string path_;
+    int signal_;
+    sigset_t previous_mask_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<uint64_t> dumps_{0u};
+    std::thread thread_;
+};
+
+}  // namespace metrics
@@ -0,0 +1,121 @@
+#include "metrics.h"
+#include "statement.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace metrics {
+
+namespace {
+
+void TestCountsInterpreterEvents() {
+    Registry registry;
+    InterpreterMetrics& interpreter = registry.Interpreter();
+    ostringstream output;
+    {
+        CountingOutput counting_output(output, interpreter.print_bytes);
+        runtime::SimpleContext context(counting_output);
+        context.SetMetrics(&registry);
+        RunOptions options;
+        options.metrics = &registry;
+        ExecuteProgram(R"(
+class Greeter:
+  def greet(name):
+    return 'Hello, ' + name
+
+g = Greeter()
+print g.greet('world'), 2 + 3
+)"s, context, options);
+    }
+
+    ASSERT_EQUAL(output.str(), "Hello, world 5\n"s);
+    ASSERT_EQUAL(interpreter.print_bytes.Get(), output.str().size());
+    ASSERT_EQUAL(interpreter.method_calls.Get(), 1u);
+    // Greeter instance, the concatenation and 2 + 3
+    ASSERT_EQUAL(interpreter.objects_allocated.Get(), 3u);
+    // g and name
+    ASSERT_EQUAL(interpreter.closure_lookups.Get(), 2u);
+    ASSERT_EQUAL(interpreter.string_bytes.GetCount(), 1u);
+    ASSERT_EQUAL(interpreter.string_bytes.GetSum(), 12u);
+    ASSERT(interpreter.lex_seconds.Get() > 0.0);
+}
+
+void TestPrometheusFormat() {
+    Registry registry;
+    Counter& requests = registry.AddCounter("requests_total"s, "Requests served"s);
+    requests.Add(3u);
+    Histogram& sizes = registry.AddHistogram("sizes"s, "Sizes"s, {10u, 100u});
+    sizes.Observe(5u);
+    sizes.Observe(10u);
+    sizes.Observe(50u);
+    sizes.Observe(500u);
+
+    ostringstream os;
+    Write(registry, Format::Prometheus, os);
+    const string text = os.str();
+    ASSERT(text.find("# TYPE mython_method_calls_total counter\nmython_method_calls_total 0\n"s)
+           != string::npos);
+    ASSERT(text.find("# HELP requests_total Requests served\n"
+                     "# TYPE requests_total counter\n"
+                     "requests_total 3\n"s) != string::npos);
+    ASSERT(text.find("sizes_bucket{le=\"10\"} 2\n"
+                     "sizes_bucket{le=\"100\"} 3\n"
+                     "sizes_bucket{le=\"+Inf\"} 4\n"
+                     "sizes_sum 565\n"
+                     "sizes_count 4\n"s) != string::npos);
+}
+
+void TestJsonFormat() {
+    Registry registry;
+    registry.Interpreter().method_calls.Add(7u);
+    registry.Interpreter().string_bytes.Observe(20u);
+
+    ostringstream os;
+    Write(registry, Format::Json, os);
+    const string json = os.str();
+    ASSERT_EQUAL(json.front(), '{');
+    ASSERT(json.find("\"mython_method_calls_total\":7,"s) != string::npos);
+    ASSERT(json.find("\"mython_string_bytes\":{\"count\":1,\"sum\":20,\"buckets\":{\"16\":0,\"64\":1,"s)
+           != string::npos);
+    ASSERT(json.find("\"+Inf\":1}}}\n"s) != string::npos);
+}
+
+void TestDumpOnSignal() {
+    const string path = "mython_metrics_test.prom"s;
+    Registry registry;
+    registry.Interpreter().method_calls.Add(42u);
+    {
+        DumpOnSignal dump(registry, Format::Prometheus, path);
+        // raise() would target this thread, where the signal is blocked
+        kill(getpid(), SIGUSR1);
+        for (int i = 0; i < 1000 && dump.GetDumpCount() == 0u; ++i)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        ASSERT_EQUAL(dump.GetDumpCount(), 1u);
+    }
+
+    ifstream file(path);
+    const string text{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    ASSERT(text.find("mython_method_calls_total 42\n"s) != string::npos);
+    remove(path.c_str());
+}
+
+}  // namespace
+
+void RunMetricsTests(TestRunner& tr) {
+    RUN_TEST(tr, metrics::TestCountsInterpreterEvents);
+    RUN_TEST(tr, metrics::TestPrometheusFormat);
+    RUN_TEST(tr, metrics::TestJsonFormat);
+    RUN_TEST(tr, metrics::TestDumpOnSignal);
+}
+
+}  // namespace metrics
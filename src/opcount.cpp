@@ -0,0 +1,54 @@
+#include "opcount.h"
+
+#include <cxxabi.h>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+namespace opcount {
+
+namespace {
+
+const char* const OP_NAMES[kOpCount] = {
+    "try_as",
+    "closure_lookups",
+    "method_lookups",
+    "method_scan_steps",
+    "allocations",
+    "refcount_increments",
+    "refcount_decrements",
+};
+
+string TypeName(const type_index& type) {
+    int status = 0;
+    unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(type.name(), nullptr, nullptr, &status),
+                                                free);
+    return status == 0 ? string(demangled.get()) : string(type.name());
+}
+
+}  // namespace
+
+void Reset() {
+    counts = Counts{};
+}
+
+void Write(ostream& os) {
+    for (size_t i = 0u; i < kOpCount; ++i)
+    {
+        os << OP_NAMES[i] << ' ' << counts.ops[i] << '\n';
+    }
+    map<string, uint64_t> executions;
+    for (const auto& [type, count] : counts.executions)
+    {
+        executions[TypeName(type)] += count;
+    }
+    for (const auto& [type, count] : executions)
+    {
+        os << "execute " << type << ' ' << count << '\n';
+    }
+}
+
+}  // namespace opcount
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+// Deterministic counts of abstract interpreter operations. Unlike wall time they do not depend
+// on the machine, so performance changes can be checked exactly. Counting is compiled in only
+// with MYTHON_OP_COUNTS defined (cmake -DMYTHON_OP_COUNTS=ON), otherwise it costs nothing
+namespace opcount {
+
+#ifdef MYTHON_OP_COUNTS
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+enum class Op : uint8_t {
+    TryAs,               // ObjectHolder::TryAs casts
+    ClosureLookup,       // hash lookups in closures and fields
+    MethodLookup,        // Class::GetMethod calls, including calls for parent classes
+    MethodScanStep,      // methods compared by Class::GetMethod
+    Allocation,          // control blocks and objects allocated by ObjectHolder::Own and Share
+    RefcountIncrement,   // copies of non-empty ObjectHolders
+    RefcountDecrement,   // releases of non-empty ObjectHolders
+};
+
+inline constexpr size_t kOpCount = static_cast<size_t>(Op::RefcountDecrement) + 1u;
+
+struct Counts {
+    std::array<uint64_t, kOpCount> ops{};
+    // Executable::Execute calls by node type
+    std::unordered_map<std::type_index, uint64_t> executions;
+};
+
+inline thread_local Counts counts;
+
+inline void Count(Op op, uint64_t times = 1u) {
+    if constexpr (kEnabled)
+    {
+        counts.ops[static_cast<size_t>(op)] += times;
+    }
+}
+
+inline void CountExecute([[maybe_unused]] const std::type_info& node_type) {
+    if constexpr (kEnabled)
+    {
+        ++counts.executions[node_type];
+    }
+}
+
+// Zeroes the counts of the current thread
+void Reset();
+
+// Writes "<operation> <count>" lines of the current thread, then "execute <node type> <count>"
+// lines ordered by node type
+void Write(std::ostream& os);
+
+}  // namespace opcount
@@ -0,0 +1,62 @@
+#include "opcount.h"
+#include "statement.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace opcount {
+
+namespace {
+
+void TestCountsOperations() {
+    runtime::DummyContext context;
+    // Literals of the program are allocated before Reset, so the counts are taken while it is alive
+    ostringstream report;
+    Counts taken;
+    RunOptions options;
+    options.before = [](runtime::Executable& /*program*/) {
+        Reset();
+    };
+    options.after = [&report, &taken] {
+        Write(report);
+        taken = counts;
+    };
+    ExecuteProgram(R"(
+class Base:
+  def value():
+    return 1
+
+class Derived(Base):
+  def twice():
+    return self.value() + self.value()
+
+d = Derived()
+print d.twice()
+)"s, context, options);
+    ASSERT_EQUAL(context.output.str(), "2\n"s);
+
+    if constexpr (!kEnabled)
+    {
+        ASSERT(report.str().find("method_lookups 0\n"s) != string::npos);
+        ASSERT(report.str().find("execute"s) == string::npos);
+        return;
+    }
+    // __init__ is looked up in Derived and Base, twice in Derived, value in Derived and Base twice
+    ASSERT(report.str().find("method_lookups 7\n"s) != string::npos);
+    ASSERT(report.str().find("method_scan_steps 7\n"s) != string::npos);
+    ASSERT(report.str().find("execute ast::MethodCall 3\n"s) != string::npos);
+    ASSERT(report.str().find("execute ast::NewInstance 1\n"s) != string::npos);
+    ASSERT_EQUAL(taken.ops[static_cast<size_t>(Op::RefcountIncrement)],
+                 taken.ops[static_cast<size_t>(Op::RefcountDecrement)]
+                 - taken.ops[static_cast<size_t>(Op::Allocation)]);
+}
+
+}  // namespace
+
+void RunOpCountTests(TestRunner& tr) {
+    RUN_TEST(tr, opcount::TestCountsOperations);
+}
+
+}  // namespace opcount
@@ -0,0 +1,267 @@
+#include "output.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <system_error>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace output {
+
+namespace {
+
+// Writes the parts with as few writev calls as possible. The parts are consumed
+void WriteAll(int fd, vector<iovec>& iov) {
+    size_t first = 0u;
+    while (first < iov.size())
+    {
+        const int count = static_cast<int>(min<size_t>(iov.size() - first, IOV_MAX));
+        ssize_t written = writev(fd, &iov[first], count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "writev"s);
+        }
+        // Skips what was written, a short write leaves the rest of a chunk for the next call
+        while (written > 0)
+        {
+            iovec& part = iov[first];
+            const size_t done = min(static_cast<size_t>(written), part.iov_len);
+            part.iov_base = static_cast<char*>(part.iov_base) + done;
+            part.iov_len -= done;
+            written -= static_cast<ssize_t>(done);
+            if (part.iov_len == 0u)
+            {
+                ++first;
+            }
+        }
+    }
+}
+
+}  // namespace
+
+ContextStreamBuffer::int_type ContextStreamBuffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        return traits_type::not_eof(ch);
+    }
+    const char c = traits_type::to_char_type(ch);
+    context_.Write(string_view(&c, 1u));
+    return ch;
+}
+
+streamsize ContextStreamBuffer::xsputn(const char* s, streamsize count) {
+    context_.Write(string_view(s, static_cast<size_t>(count)));
+    return count;
+}
+
+BufferedContext::BufferedContext(int fd, size_t flush_threshold, size_t chunk_size)
+    :fd_(fd), flush_threshold_(flush_threshold), chunk_size_(max<size_t>(chunk_size, 1u)),
+     buffer_(*this), stream_(&buffer_) {}
+
+BufferedContext::~BufferedContext() {
+    try
+    {
+        Flush();
+    }
+    catch (const system_error&)
+    {
+    }
+}
+
+void BufferedContext::Write(string_view text) {
+    while (!text.empty())
+    {
+        if (current_ == chunks_.size())
+        {
+            // Not value-initialized: the chunk is overwritten before it is written out
+            chunks_.push_back({unique_ptr<char[]>(new char[chunk_size_]), 0u});
+        }
+        Chunk& chunk = chunks_[current_];
+        const size_t count = min(text.size(), chunk_size_ - chunk.size);
+        memcpy(chunk.data.get() + chunk.size, text.data(), count);
+        chunk.size += count;
+        buffered_ += count;
+        text.remove_prefix(count);
+        if (chunk.size == chunk_size_)
+        {
+            ++current_;
+        }
+    }
+    if (buffered_ >= flush_threshold_)
+    {
+        Flush();
+    }
+}
+
+void BufferedContext::Flush() {
+    iov_.clear();
+    for (Chunk& chunk : chunks_)
+    {
+        if (chunk.size > 0u)
+        {
+            iov_.push_back({chunk.data.get(), chunk.size});
+        }
+        chunk.size = 0u;
+    }
+    current_ = 0u;
+    buffered_ = 0u;
+
+    WriteAll(fd_, iov_);
+}
+
+AsyncContext::AsyncContext(int fd, size_t chunk_size, size_t chunk_count)
+    :fd_(fd), chunk_size_(max<size_t>(chunk_size, 1u)), filled_(max<size_t>(chunk_count, 1u)),
+     free_(filled_.Capacity()), buffer_(*this), stream_(&buffer_) {
+    chunks_.resize(filled_.Capacity());
+    for (Chunk& chunk : chunks_)
+    {
+        chunk.data.reset(new char[chunk_size_]);
+        free_.TryPush(&chunk);
+    }
+    writer_ = thread([this] {
+        Run();
+    });
+}
+
+AsyncContext::~AsyncContext() {
+    try
+    {
+        Flush();
+    }
+    catch (const system_error&)
+    {
+    }
+    stopping_.store(true);
+    Notify(writer_wakeup_);
+    writer_.join();
+}
+
+void AsyncContext::Write(string_view text) {
+    while (!text.empty())
+    {
+        if (current_ == nullptr)
+        {
+            current_ = AcquireChunk();
+        }
+        const size_t count = min(text.size(), chunk_size_ - current_->size);
+        memcpy(current_->data.get() + current_->size, text.data(), count);
+        current_->size += count;
+        text.remove_prefix(count);
+        if (current_->size == chunk_size_)
+        {
+            Submit();
+        }
+    }
+}
+
+void AsyncContext::Flush() {
+    if (current_ != nullptr && current_->size > 0u)
+    {
+        Submit();
+    }
+    Wait(interpreter_wakeup_, [this] {
+        return written_.load(memory_order_acquire) == submitted_;
+    });
+    if (const int error = error_.exchange(0))
+    {
+        throw system_error(error, generic_category(), "write"s);
+    }
+}
+
+Chunk* AsyncContext::AcquireChunk() {
+    Chunk* chunk = nullptr;
+    if (!free_.TryPop(chunk))
+    {
+        // Every chunk waits for the writer: the interpreter is ahead of the output
+        ++stalls_;
+        Wait(interpreter_wakeup_, [this, &chunk] {
+            return free_.TryPop(chunk);
+        });
+    }
+    return chunk;
+}
+
+void AsyncContext::Submit() {
+    // There are as many slots as chunks, so the ring is never full
+    filled_.TryPush(current_);
+    current_ = nullptr;
+    ++submitted_;
+    Notify(writer_wakeup_);
+}
+
+template <typename Ready>
+void AsyncContext::Wait(condition_variable& wakeup, Ready ready) {
+    if (ready())
+    {
+        return;
+    }
+    unique_lock lock(mutex_);
+    wakeup.wait(lock, ready);
+}
+
+void AsyncContext::Notify(condition_variable& wakeup) {
+    // The ring was updated before the lock is taken, so a waiter either sees the update while
+    // checking ready() under the lock or is already asleep and gets the notification
+    lock_guard lock(mutex_);
+    wakeup.notify_one();
+}
+
+void AsyncContext::Run() {
+    vector<Chunk*> batch;
+    vector<iovec> iov;
+    for (;;)
+    {
+        Chunk* chunk = nullptr;
+        while (batch.size() < static_cast<size_t>(IOV_MAX) && filled_.TryPop(chunk))
+        {
+            batch.push_back(chunk);
+        }
+        if (batch.empty())
+        {
+            if (stopping_.load())
+            {
+                return;
+            }
+            Wait(writer_wakeup_, [this] {
+                return !filled_.Empty() || stopping_.load();
+            });
+            continue;
+        }
+
+        // After a failed write the rest is dropped until Flush reports the error
+        if (error_.load(memory_order_relaxed) == 0)
+        {
+            iov.clear();
+            for (Chunk* filled : batch)
+            {
+                iov.push_back({filled->data.get(), filled->size});
+            }
+            try
+            {
+                WriteAll(fd_, iov);
+            }
+            catch (const system_error& e)
+            {
+                error_.store(e.code().value());
+            }
+        }
+        for (Chunk* written : batch)
+        {
+            written->size = 0u;
+            free_.TryPush(written);
+        }
+        written_.fetch_add(batch.size(), memory_order_release);
+        batch.clear();
+        Notify(interpreter_wakeup_);
+    }
+}
+
+}  // namespace output
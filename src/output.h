@@ -0,0 +1,216 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+
+// Output of print for programs that write a lot: the text is gathered in large chunks and
+// written to a file descriptor with a single writev once enough of it has been buffered,
+// either by the interpreter itself or by a writer thread
+namespace output {
+
+// Stream buffer passing everything written to it to Context::Write
+class ContextStreamBuffer : public std::streambuf {
+public:
+    explicit ContextStreamBuffer(runtime::Context& context)
+        :context_(context) {}
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+private:
+    runtime::Context& context_;
+};
+
+// Buffer of output text
+struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t size = 0u;
+};
+
+// Gathers the text in chunks and writes them from the interpreter thread
+class BufferedContext : public runtime::Context {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64u * 1024u;
+    static constexpr size_t DEFAULT_FLUSH_THRESHOLD = 1024u * 1024u;
+
+    // Writes to fd, which stays open. Buffered text is written once flush_threshold bytes
+    // have been gathered, on Flush and on destruction
+    explicit BufferedContext(int fd, size_t flush_threshold = DEFAULT_FLUSH_THRESHOLD,
+                             size_t chunk_size = DEFAULT_CHUNK_SIZE);
+    // Writes the rest of the text. Errors are ignored here, call Flush to see them
+    ~BufferedContext();
+
+    BufferedContext(const BufferedContext&) = delete;
+    BufferedContext& operator=(const BufferedContext&) = delete;
+
+    // Text written through the stream goes to the same buffer as the text passed to Write
+    std::ostream& GetOutputStream() override {
+        return stream_;
+    }
+
+    void Write(std::string_view text) override;
+
+    // Writes all buffered text to the file descriptor. Throws system_error if it fails
+    void Flush();
+
+    [[nodiscard]] size_t GetBufferedSize() const {
+        return buffered_;
+    }
+
+private:
+    int fd_;
+    size_t flush_threshold_;
+    size_t chunk_size_;
+    // Chunks are kept between flushes. current_ is the one being filled
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0u;
+    size_t buffered_ = 0u;
+    std::vector<iovec> iov_;
+    ContextStreamBuffer buffer_;
+    std::ostream stream_;
+};
+
+// Lock-free queue of a single producer thread and a single consumer thread
+template <typename T>
+class SpscRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+        :slots_(RoundUp(capacity)), mask_(slots_.size() - 1u) {}
+
+    // Called by the producer. Returns false if the ring is full
+    bool TryPush(T value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == slots_.size())
+        {
+            return false;
+        }
+        slots_[head & mask_] = std::move(value);
+        head_.store(head + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // Called by the consumer. Returns false if the ring is empty
+    bool TryPop(T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = std::move(slots_[tail & mask_]);
+        tail_.store(tail + 1u, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool Empty() const {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t Capacity() const {
+        return slots_.size();
+    }
+
+private:
+    static size_t RoundUp(size_t capacity) {
+        size_t result = 1u;
+        while (result < capacity)
+        {
+            result *= 2u;
+        }
+        return result;
+    }
+
+    std::vector<T> slots_;
+    size_t mask_;
+    // The producer and the consumer update their indices without sharing a cache line
+    alignas(64) std::atomic<size_t> head_{0u};
+    alignas(64) std::atomic<size_t> tail_{0u};
+};
+
+// Hands filled chunks to a writer thread, so the interpreter does not wait for write() on slow
+// pipes and disks. The number of chunks is bounded: once all of them are waiting to be written,
+// the interpreter blocks until the writer returns one. Chunks are written in the order they
+// were filled
+class AsyncContext : public runtime::Context {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64u * 1024u;
+    static constexpr size_t DEFAULT_CHUNK_COUNT = 16u;
+
+    // Writes to fd, which stays open
+    explicit AsyncContext(int fd, size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                          size_t chunk_count = DEFAULT_CHUNK_COUNT);
+    // Writes the rest of the text and stops the writer. Errors are ignored here, call Flush
+    // to see them
+    ~AsyncContext();
+
+    AsyncContext(const AsyncContext&) = delete;
+    AsyncContext& operator=(const AsyncContext&) = delete;
+
+    // Text written through the stream goes to the same chunks as the text passed to Write
+    std::ostream& GetOutputStream() override {
+        return stream_;
+    }
+
+    void Write(std::string_view text) override;
+
+    // Hands the partly filled chunk to the writer and waits until everything is written.
+    // Throws system_error if a write has failed since the previous Flush. Text of the chunks
+    // that could not be written is lost
+    void Flush();
+
+    // Returns how many times the interpreter had to wait for a free chunk
+    [[nodiscard]] uint64_t GetStalls() const {
+        return stalls_;
+    }
+
+private:
+    Chunk* AcquireChunk();
+    void Submit();
+    // Sleeps until ready() is true. The other side calls Notify after updating a ring
+    template <typename Ready>
+    void Wait(std::condition_variable& wakeup, Ready ready);
+    void Notify(std::condition_variable& wakeup);
+
+    void Run();
+
+    int fd_;
+    size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    // Filled chunks go to the writer, written ones come back
+    SpscRing<Chunk*> filled_;
+    SpscRing<Chunk*> free_;
+    Chunk* current_ = nullptr;
+    uint64_t submitted_ = 0u;
+    uint64_t stalls_ = 0u;
+
+    std::atomic<uint64_t> written_{0u};
+    // errno of the first failed write
+    std::atomic<int> error_{0};
+    std::atomic<bool> stopping_{false};
+
+    // The rings are lock-free. The mutex only lets the side that has nothing to do sleep and is
+    // taken once per chunk
+    std::mutex mutex_;
+    std::condition_variable writer_wakeup_;
+    std::condition_variable interpreter_wakeup_;
+
+    ContextStreamBuffer buffer_;
+    std::ostream stream_;
+    std::thread writer_;
+};
+
+}  // namespace output
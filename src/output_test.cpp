@@ -0,0 +1,236 @@
+#include "output.h"
+
+#include "test_runner_p.h"
+
+#include <cstdio>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace output {
+
+namespace {
+
+// Pipe whose read end does not block, so a test can see what has been written so far
+class Pipe {
+public:
+    Pipe() {
+        if (pipe(fds_) != 0)
+        {
+            throw runtime_error("pipe() failed"s);
+        }
+        fcntl(fds_[0], F_SETFL, O_NONBLOCK);
+    }
+
+    ~Pipe() {
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    [[nodiscard]] int WriteEnd() const {
+        return fds_[1];
+    }
+
+    string ReadAvailable() const {
+        string result;
+        char buffer[4096];
+        ssize_t count = 0;
+        while ((count = read(fds_[0], buffer, sizeof(buffer))) > 0)
+        {
+            result.append(buffer, static_cast<size_t>(count));
+        }
+        return result;
+    }
+
+private:
+    int fds_[2] = {-1, -1};
+};
+
+void TestWritesOnceThresholdIsReached() {
+    Pipe pipe;
+    BufferedContext context(pipe.WriteEnd(), 16u, 4u);
+    context.Write("hello, "sv);
+    // The stream shares the buffer, so the text keeps its order
+    context.GetOutputStream() << 42 << ' ';
+    ASSERT_EQUAL(pipe.ReadAvailable(), ""s);
+    ASSERT_EQUAL(context.GetBufferedSize(), 10u);
+
+    context.Write("world\n"sv);
+    ASSERT_EQUAL(pipe.ReadAvailable(), "hello, 42 world\n"s);
+    ASSERT_EQUAL(context.GetBufferedSize(), 0u);
+
+    context.Write("rest"sv);
+    context.Flush();
+    ASSERT_EQUAL(pipe.ReadAvailable(), "rest"s);
+}
+
+void TestFlushesOnDestruction() {
+    Pipe pipe;
+    string text;
+    for (int i = 0; i < 1000; ++i)
+    {
+        text += to_string(i) + '\n';
+    }
+    {
+        BufferedContext context(pipe.WriteEnd(), 1u << 20u, 100u);
+        context.Write(text);
+        ASSERT_EQUAL(pipe.ReadAvailable(), ""s);
+    }
+    ASSERT_EQUAL(pipe.ReadAvailable(), text);
+}
+
+// Anonymous temporary file: unlike a pipe it never blocks the writer thread of a test
+class TemporaryFile {
+public:
+    TemporaryFile()
+        :file_(tmpfile()) {
+        if (file_ == nullptr)
+        {
+            throw runtime_error("tmpfile() failed"s);
+        }
+    }
+
+    ~TemporaryFile() {
+        fclose(file_);
+    }
+
+    [[nodiscard]] int Fd() const {
+        return fileno(file_);
+    }
+
+    [[nodiscard]] string Read() const {
+        string result;
+        char buffer[4096];
+        ssize_t count = 0;
+        off_t offset = 0;
+        while ((count = pread(Fd(), buffer, sizeof(buffer), offset)) > 0)
+        {
+            result.append(buffer, static_cast<size_t>(count));
+            offset += count;
+        }
+        return result;
+    }
+
+private:
+    FILE* file_;
+};
+
+void TestRingKeepsOrder() {
+    SpscRing<int> ring(3u);
+    ASSERT_EQUAL(ring.Capacity(), 4u);
+    int value = 0;
+    ASSERT(!ring.TryPop(value));
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT(ring.TryPush(round * 10 + i));
+        }
+        ASSERT(!ring.TryPush(100));
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT(ring.TryPop(value));
+            ASSERT_EQUAL(value, round * 10 + i);
+        }
+        ASSERT(ring.Empty());
+    }
+
+    // Values pass between threads in order
+    SpscRing<int> shared(8u);
+    int sum = 0;
+    bool ordered = true;
+    thread consumer([&] {
+        int expected = 0;
+        while (expected < 10000)
+        {
+            int received = 0;
+            if (shared.TryPop(received))
+            {
+                ordered = ordered && received == expected;
+                sum += received;
+                ++expected;
+            }
+            else
+            {
+                // On a single core the other side only runs once this one gives up its time slice
+                this_thread::yield();
+            }
+        }
+    });
+    for (int i = 0; i < 10000;)
+    {
+        if (shared.TryPush(i))
+        {
+            ++i;
+        }
+        else
+        {
+            this_thread::yield();
+        }
+    }
+    consumer.join();
+    ASSERT(ordered);
+    ASSERT_EQUAL(sum, 10000 * 9999 / 2);
+}
+
+void TestWriterThreadKeepsOrder() {
+    TemporaryFile file;
+    string expected;
+    {
+        // Two tiny chunks make the interpreter wait for the writer all the time
+        AsyncContext context(file.Fd(), 7u, 2u);
+        for (int i = 0; i < 2000; ++i)
+        {
+            const string line = to_string(i) + '\n';
+            if (i % 2 == 0)
+            {
+                context.Write(line);
+            }
+            else
+            {
+                context.GetOutputStream() << i << '\n';
+            }
+            expected += line;
+        }
+        context.Flush();
+        ASSERT_EQUAL(file.Read(), expected);
+        ASSERT(context.GetStalls() > 0u);
+
+        // The destructor writes the rest
+        context.Write("tail"sv);
+        expected += "tail"s;
+    }
+    ASSERT_EQUAL(file.Read(), expected);
+}
+
+void TestWriterThreadReportsErrors() {
+    AsyncContext context(-1, 4u, 2u);
+    context.Write("lost text"sv);
+    ASSERT_THROWS(context.Flush(), system_error);
+    // The error is reported once
+    context.Flush();
+}
+
+void TestReportsWriteErrors() {
+    BufferedContext context(-1, 1024u);
+    context.Write("lost"sv);
+    ASSERT_THROWS(context.Flush(), system_error);
+    ASSERT_EQUAL(context.GetBufferedSize(), 0u);
+}
+
+}  // namespace
+
+void RunOutputTests(TestRunner& tr) {
+    RUN_TEST(tr, output::TestWritesOnceThresholdIsReached);
+    RUN_TEST(tr, output::TestFlushesOnDestruction);
+    RUN_TEST(tr, output::TestReportsWriteErrors);
+    RUN_TEST(tr, output::TestRingKeepsOrder);
+    RUN_TEST(tr, output::TestWriterThreadKeepsOrder);
+    RUN_TEST(tr, output::TestWriterThreadReportsErrors);
+}
+
+}  // namespace output
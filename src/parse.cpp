@@ -1,6 +1,7 @@
 #include "parse.h"
 
 #include "lexer.h"
+#include "profiler.h"
 #include "statement.h"
 
 using namespace std;
@@ -35,6 +36,19 @@ public:
     }
 
 private:
+    runtime::SourcePosition CurrentPosition() const {
+        const parse::Token& token = lexer_.CurrentToken();
+        return {token.line, token.column};
+    }
+
+    // Creates an AST node which starts at position in the source text
+    template <typename Node, typename... Args>
+    unique_ptr<Node> MakeNode(runtime::SourcePosition position, Args&&... args) {
+        auto node = make_unique<Node>(std::forward<Args>(args)...);
+        node->SetPosition(position);
+        return node;
+    }
+
     // Suite -> NEWLINE INDENT (Statement)+ DEDENT
     unique_ptr<ast::Statement> ParseSuite()  // NOLINT
     {
@@ -60,6 +74,7 @@ private:
         vector<runtime::Method> result;
 
         while (lexer_.CurrentToken().Is<TokenType::Def>()) {
+            const auto position = CurrentPosition();
             runtime::Method m;
 
             m.name = lexer_.ExpectNext<TokenType::Id>().value;
@@ -76,7 +91,7 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            m.body = MakeNode<ast::MethodBody>(position, ParseSuite());  // NOLINT
 
             result.push_back(std::move(m));
         }
@@ -138,6 +153,7 @@ private:
     //               | DottedIds '(' ExprList ')'
     unique_ptr<ast::Statement> ParseAssignmentOrCall() {
         lexer_.Expect<TokenType::Id>();
+        const auto position = CurrentPosition();
 
         vector<string> id_list = ParseDottedIds();
         string last_name = id_list.back();
@@ -166,22 +182,23 @@ private:
         lexer_.Expect<TokenType::Char>(')');
         lexer_.NextToken();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
+        return make_unique<ast::MethodCall>(MakeNode<ast::VariableValue>(position, std::move(id_list)),
                                             std::move(last_name), std::move(args));
     }
 
     // Expr -> Adder ['+'/'-' Adder]*
     unique_ptr<ast::Statement> ParseExpression()  // NOLINT
     {
+        const auto position = CurrentPosition();
         unique_ptr<ast::Statement> result = ParseAdder();
         while (lexer_.CurrentToken() == '+' || lexer_.CurrentToken() == '-') {
             char op = lexer_.CurrentToken().As<TokenType::Char>().value;
             lexer_.NextToken();
 
             if (op == '+') {
-                result = make_unique<ast::Add>(std::move(result), ParseAdder());
+                result = MakeNode<ast::Add>(position, std::move(result), ParseAdder());
             } else {
-                result = make_unique<ast::Sub>(std::move(result), ParseAdder());
+                result = MakeNode<ast::Sub>(position, std::move(result), ParseAdder());
             }
         }
         return result;
@@ -190,15 +207,16 @@ private:
     // Adder -> Mult ['*'/'/' Mult]*
     unique_ptr<ast::Statement> ParseAdder()  // NOLINT
     {
+        const auto position = CurrentPosition();
         unique_ptr<ast::Statement> result = ParseMult();
         while (lexer_.CurrentToken() == '*' || lexer_.CurrentToken() == '/') {
             char op = lexer_.CurrentToken().As<TokenType::Char>().value;
             lexer_.NextToken();
 
             if (op == '*') {
-                result = make_unique<ast::Mult>(std::move(result), ParseMult());
+                result = MakeNode<ast::Mult>(position, std::move(result), ParseMult());
             } else {
-                result = make_unique<ast::Div>(std::move(result), ParseMult());
+                result = MakeNode<ast::Div>(position, std::move(result), ParseMult());
             }
         }
         return result;
@@ -215,6 +233,7 @@ private:
     //       | DottedIds
     unique_ptr<ast::Statement> ParseMult()  // NOLINT
     {
+        const auto position = CurrentPosition();
         if (lexer_.CurrentToken() == '(') {
             lexer_.NextToken();
             auto result = ParseTest();
@@ -224,35 +243,36 @@ private:
         }
         if (lexer_.CurrentToken() == '-') {
             lexer_.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
+            return MakeNode<ast::Mult>(position, ParseMult(), MakeNode<ast::NumericConst>(position, -1));
         }
         if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
-            int result = num->value;
+            bigint::Integer result = num->value;
             lexer_.NextToken();
-            return make_unique<ast::NumericConst>(result);
+            return MakeNode<ast::NumericConst>(position, result);
         }
         if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
             string result = str->value;
             lexer_.NextToken();
-            return make_unique<ast::StringConst>(std::move(result));
+            return MakeNode<ast::StringConst>(position, std::move(result));
         }
         if (lexer_.CurrentToken().Is<TokenType::True>()) {
             lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(true));
+            return MakeNode<ast::BoolConst>(position, runtime::Bool(true));
         }
         if (lexer_.CurrentToken().Is<TokenType::False>()) {
             lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(false));
+            return MakeNode<ast::BoolConst>(position, runtime::Bool(false));
         }
         if (lexer_.CurrentToken().Is<TokenType::None>()) {
             lexer_.NextToken();
-            return make_unique<ast::None>();
+            return MakeNode<ast::None>(position);
         }
 
         return ParseDottedIdsInMultExpr();
     }
 
     std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
+        const auto position = CurrentPosition();
         vector<string> names = ParseDottedIds();
 
         if (lexer_.CurrentToken() == '(') {
@@ -268,23 +288,23 @@ private:
             names.pop_back();
 
             if (!names.empty()) {
-                return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
-                    std::move(args));
+                return MakeNode<ast::MethodCall>(
+                    position, MakeNode<ast::VariableValue>(position, std::move(names)),
+                    std::move(method_name), std::move(args));
             }
             if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                return make_unique<ast::NewInstance>(
-                    static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
+                return MakeNode<ast::NewInstance>(
+                    position, static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
             }
             if (method_name == "str"sv) {
                 if (args.size() != 1) {
                     throw ParseError("Function str takes exactly one argument"s);
                 }
-                return make_unique<ast::Stringify>(std::move(args.front()));
+                return MakeNode<ast::Stringify>(position, std::move(args.front()));
             }
             throw ParseError("Unknown call to "s + method_name + "()"s);
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        return MakeNode<ast::VariableValue>(position, std::move(names));
     }
 
     vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
@@ -323,35 +343,85 @@ private:
                                         std::move(else_body));
     }
 
+    // While -> while LogicalExpr: Suite
+    unique_ptr<ast::Statement> ParseWhile()  // NOLINT
+    {
+        lexer_.Expect<TokenType::While>();
+        lexer_.NextToken();
+
+        auto condition = ParseTest();
+
+        lexer_.Expect<TokenType::Char>(':');
+        lexer_.NextToken();
+
+        return make_unique<ast::While>(std::move(condition), ParseSuite());
+    }
+
+    // ForRange -> for Id in range '(' Expr [, Expr] ')': Suite
+    unique_ptr<ast::Statement> ParseForRange()  // NOLINT
+    {
+        lexer_.Expect<TokenType::For>();
+        string var = lexer_.ExpectNext<TokenType::Id>().value;
+        lexer_.ExpectNext<TokenType::In>();
+
+        // range is not a keyword, Mython has no other iterables
+        if (lexer_.NextToken() != TokenType::Id{"range"s}) {
+            throw ParseError("Only range() can be iterated over by for"s);
+        }
+        lexer_.ExpectNext<TokenType::Char>('(');
+        lexer_.NextToken();
+
+        const auto position = CurrentPosition();
+        unique_ptr<ast::Statement> begin = ParseExpression();
+        unique_ptr<ast::Statement> end;
+        if (lexer_.CurrentToken() == ',') {
+            lexer_.NextToken();
+            end = ParseExpression();
+        } else {
+            // range(n) counts from zero
+            end = std::move(begin);
+            begin = MakeNode<ast::NumericConst>(position, 0);
+        }
+
+        lexer_.Expect<TokenType::Char>(')');
+        lexer_.ExpectNext<TokenType::Char>(':');
+        lexer_.NextToken();
+
+        return make_unique<ast::ForRange>(std::move(var), std::move(begin), std::move(end), ParseSuite());
+    }
+
     // LogicalExpr -> AndTest [OR AndTest]
     // AndTest -> NotTest [AND NotTest]
     // NotTest -> [NOT] NotTest
     //          | Comparison
     unique_ptr<ast::Statement> ParseTest()  // NOLINT
     {
+        const auto position = CurrentPosition();
         auto result = ParseAndTest();
         while (lexer_.CurrentToken().Is<TokenType::Or>()) {
             lexer_.NextToken();
-            result = make_unique<ast::Or>(std::move(result), ParseAndTest());
+            result = MakeNode<ast::Or>(position, std::move(result), ParseAndTest());
         }
         return result;
     }
 
     unique_ptr<ast::Statement> ParseAndTest()  // NOLINT
     {
+        const auto position = CurrentPosition();
         auto result = ParseNotTest();
         while (lexer_.CurrentToken().Is<TokenType::And>()) {
             lexer_.NextToken();
-            result = make_unique<ast::And>(std::move(result), ParseNotTest());
+            result = MakeNode<ast::And>(position, std::move(result), ParseNotTest());
         }
         return result;
     }
 
     unique_ptr<ast::Statement> ParseNotTest()  // NOLINT
     {
+        const auto position = CurrentPosition();
         if (lexer_.CurrentToken().Is<TokenType::Not>()) {
             lexer_.NextToken();
-            return make_unique<ast::Not>(ParseNotTest());  // NOLINT
+            return MakeNode<ast::Not>(position, ParseNotTest());  // NOLINT
         }
         return ParseComparison();
     }
@@ -359,38 +429,39 @@ private:
     // Comparison -> Expr [COMP_OP Expr]
     unique_ptr<ast::Statement> ParseComparison()  // NOLINT
     {
+        const auto position = CurrentPosition();
         auto result = ParseExpression();
 
         const auto tok = lexer_.CurrentToken();
 
         if (tok == '<') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
+            return MakeNode<ast::Comparison>(position, runtime::CompareOp::Less, std::move(result),
                                                 ParseExpression());
         }
         if (tok == '>') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
+            return MakeNode<ast::Comparison>(position, runtime::CompareOp::Greater, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::Eq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
+            return MakeNode<ast::Comparison>(position, runtime::CompareOp::Equal, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::NotEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
+            return MakeNode<ast::Comparison>(position, runtime::CompareOp::NotEqual, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::LessOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
+            return MakeNode<ast::Comparison>(position, runtime::CompareOp::LessOrEqual, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::GreaterOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
+            return MakeNode<ast::Comparison>(position, runtime::CompareOp::GreaterOrEqual, std::move(result),
                                                 ParseExpression());
         }
         return result;
@@ -399,7 +470,20 @@ private:
     // Statement -> SimpleStatement Newline
     //           | class ClassDefinition
     //           | if Condition
+    //           | while While
+    //           | for ForRange
     unique_ptr<ast::Statement> ParseStatement()  // NOLINT
+    {
+        const auto position = CurrentPosition();
+        auto result = ParseStatementBody();  // NOLINT
+        result->SetPosition(position);
+        if (profile::NodeProfiler* profiler = profile::NodeProfiler::Active()) {
+            profiler->RegisterStatement(*result);
+        }
+        return result;
+    }
+
+    unique_ptr<ast::Statement> ParseStatementBody()  // NOLINT
     {
         const auto& tok = lexer_.CurrentToken();
 
@@ -410,6 +494,12 @@ private:
         if (tok.Is<TokenType::If>()) {
             return ParseCondition();
         }
+        if (tok.Is<TokenType::While>()) {
+            return ParseWhile();
+        }
+        if (tok.Is<TokenType::For>()) {
+            return ParseForRange();
+        }
         auto result = ParseSimpleStatement();
         lexer_.Expect<TokenType::Newline>();
         lexer_.NextToken();
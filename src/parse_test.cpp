@@ -118,6 +118,53 @@ print x.calc(2)
     ASSERT_EQUAL(context.output.str(), "2\n"s);
 }
 
+void TestLoops() {
+    const string program = R"(
+class Search:
+  def first_square_above(limit):
+    for i in range(limit):
+      if i * i > limit:
+        return i
+    return None
+
+n = 0
+total = 0
+while n < 5:
+  total = total + n
+  n = n + 1
+print n, total
+
+s = ""
+for i in range(2, 2 + 3):
+  s = s + str(i)
+  i = 100
+print s, i
+for j in range(3, 1):
+  print "never"
+search = Search()
+print search.first_square_above(10), search.first_square_above(0)
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "5 10\n234 100\n4 None\n"s);
+    // An empty range does not assign the variable
+    ASSERT(closure.count("j"s) == 0u);
+}
+
+void TestLoopErrors() {
+    ASSERT_THROWS(ParseProgramFromString("for i in items:\n  print i\n"s), ParseError);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString("for i in range(\"a\", 2):\n  print i\n"s);
+    ASSERT_THROWS(tree->Execute(closure, context), runtime_error);
+}
+
 void TestRecursion() {
     const string program = R"(
 class ArithmeticProgression:
@@ -145,6 +192,96 @@ print x.result
     ASSERT_EQUAL(context.output.str(), "55\n"s);
 }
 
+void TestTailCalls() {
+    // Tail calls do not count towards the recursion limit, so without them a thousand nested
+    // calls would exceed it
+    const string program = R"(
+class Counter:
+  def count(n, acc):
+    if n == 0:
+      return acc
+    return self.count(n - 1, acc + 2)
+
+class Parity:
+  def even(other, n):
+    if n == 0:
+      return True
+    return other.odd(self, n - 1)
+
+  def odd(other, n):
+    if n == 0:
+      return False
+    return other.even(self, n - 1)
+
+class Helper:
+  def finish(owner):
+    return owner.name
+
+class Owner:
+  def __init__():
+    self.name = "owner"
+
+  def delegate():
+    helper = Helper()
+    for i in range(3):
+      return helper.finish(self)
+
+c = Counter()
+print c.count(1000, 0)
+p = Parity()
+q = Parity()
+print p.even(q, 1001), p.odd(q, 1001)
+o = Owner()
+print o.delegate()
+)"s;
+
+    runtime::DummyContext context;
+    context.SetRecursionLimit(50u);
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+
+    ASSERT_EQUAL(context.output.str(), "2000\nFalse True\nowner\n"s);
+}
+
+void TestRecursionLimit() {
+    const string program = R"(
+class Depth:
+  def nested(n):
+    if n == 0:
+      return 0
+    return 1 + self.nested(n - 1)
+
+  def tail(n):
+    if n == 0:
+      return 0
+    return self.tail(n - 1)
+
+d = Depth()
+print d.nested(9), d.tail(1000)
+print d.nested(10)
+)"s;
+
+    runtime::DummyContext context;
+    context.SetRecursionLimit(10u);
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    try
+    {
+        tree->Execute(closure, context);
+        ASSERT(false);
+    }
+    catch (const runtime_error& e)
+    {
+        ASSERT_EQUAL(string(e.what()), "Recursion limit exceeded"s);
+    }
+    // Tail calls do not count
+    ASSERT_EQUAL(context.output.str(), "9 0\n"s);
+    ASSERT_EQUAL(context.GetCallDepth(), 0u);
+}
+
 void TestRecursion2() {
     const string program = R"(
 class GCD:
@@ -252,8 +389,12 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestProgramWithClasses);
     RUN_TEST(tr, parse::TestProgramWithIf);
     RUN_TEST(tr, parse::TestReturnFromIf);
+    RUN_TEST(tr, parse::TestLoops);
+    RUN_TEST(tr, parse::TestLoopErrors);
     RUN_TEST(tr, parse::TestRecursion);
     RUN_TEST(tr, parse::TestRecursion2);
+    RUN_TEST(tr, parse::TestTailCalls);
+    RUN_TEST(tr, parse::TestRecursionLimit);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
 }
\ No newline at end of file
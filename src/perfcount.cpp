@@ -0,0 +1,207 @@
+#include "perfcount.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace perf {
+
+namespace {
+
+struct EventConfig {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t CacheReadMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+const EventConfig EVENTS[kEventCount] = {
+    {"task_ms", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"l1d_misses", PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {"llc_misses", PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_LL)},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE, CacheReadMiss(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+int OpenEvent(const EventConfig& event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+// The row is ordered by cycles, or by task clock if cycles are unavailable
+uint64_t SortKey(const Reading& reading) {
+    return reading[Event::Cycles].value_or(reading[Event::TaskClock].value_or(0u));
+}
+
+}  // namespace
+
+const char* EventName(Event event) {
+    return EVENTS[static_cast<size_t>(event)].name;
+}
+
+Reading& Reading::operator+=(const Reading& other) {
+    for (size_t i = 0u; i < kEventCount; ++i)
+    {
+        if (values[i] && other.values[i])
+        {
+            *values[i] += *other.values[i];
+        }
+        else
+        {
+            values[i] = other.values[i];
+        }
+    }
+    return *this;
+}
+
+Reading Reading::operator-(const Reading& other) const {
+    Reading result;
+    for (size_t i = 0u; i < kEventCount; ++i)
+    {
+        if (values[i] && other.values[i])
+        {
+            result.values[i] = *values[i] - min(*values[i], *other.values[i]);
+        }
+    }
+    return result;
+}
+
+CounterSet::CounterSet() {
+    for (size_t i = 0u; i < kEventCount; ++i)
+    {
+        fds_[i] = OpenEvent(EVENTS[i]);
+        if (fds_[i] < 0)
+        {
+            error_ += (error_.empty() ? ""s : ", "s) + EVENTS[i].name + ": "s + strerror(errno);
+        }
+    }
+}
+
+CounterSet::~CounterSet() {
+    for (int fd : fds_)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+Reading CounterSet::Read() const {
+    Reading reading;
+    for (size_t i = 0u; i < kEventCount; ++i)
+    {
+        // value, time enabled, time running
+        uint64_t data[3] = {};
+        if (fds_[i] < 0 || read(fds_[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+        {
+            continue;
+        }
+        if (data[2] == 0u)
+        {
+            reading.values[i] = 0u;
+        }
+        else if (data[2] < data[1])
+        {
+            reading.values[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+        else
+        {
+            reading.values[i] = data[0];
+        }
+    }
+    return reading;
+}
+
+void RegionCounters::Add(const string& name, const Reading& reading) {
+    auto it = find_if(regions_.begin(), regions_.end(), [&name](const auto& region) {
+        return region.first == name;
+    });
+    if (it == regions_.end())
+    {
+        regions_.emplace_back(name, reading);
+    }
+    else
+    {
+        it->second += reading;
+    }
+}
+
+void RegionCounters::Report(ostream& os, size_t top) const {
+    vector<pair<string, Reading>> regions = regions_;
+    if (regions.size() > top)
+    {
+        stable_sort(regions.begin(), regions.end(), [](const auto& lhs, const auto& rhs) {
+            return SortKey(lhs.second) > SortKey(rhs.second);
+        });
+        regions.resize(top);
+    }
+
+    os << left << setw(32) << "region" << right;
+    for (size_t i = 0u; i < kEventCount; ++i)
+    {
+        os << setw(15) << EVENTS[i].name;
+        if (static_cast<Event>(i) == Event::Instructions)
+        {
+            os << setw(7) << "ipc";
+        }
+    }
+    os << '\n';
+
+    for (const auto& [name, reading] : regions)
+    {
+        os << left << setw(32) << name << right;
+        for (size_t i = 0u; i < kEventCount; ++i)
+        {
+            const auto event = static_cast<Event>(i);
+            if (!reading[event])
+            {
+                os << setw(15) << "n/a";
+            }
+            else if (event == Event::TaskClock)
+            {
+                os << setw(15) << fixed << setprecision(3) << *reading[event] / 1e6;
+            }
+            else
+            {
+                os << setw(15) << *reading[event];
+            }
+
+            if (event != Event::Instructions)
+            {
+                continue;
+            }
+            if (reading[Event::Cycles] && reading[Event::Instructions] && *reading[Event::Cycles] > 0u)
+            {
+                os << setw(7) << fixed << setprecision(2)
+                   << static_cast<double>(*reading[Event::Instructions]) / *reading[Event::Cycles];
+            }
+            else
+            {
+                os << setw(7) << "n/a";
+            }
+        }
+        os << '\n';
+    }
+}
+
+}  // namespace perf
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Hardware performance counters of the calling thread read with perf_event_open(2)
+namespace perf {
+
+enum class Event : uint8_t {
+    TaskClock,     // nanoseconds on CPU, a software event available almost everywhere
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1dMisses,     // L1 data cache read misses
+    LlcMisses,     // last level cache read misses
+    DtlbMisses,    // data TLB read misses
+};
+
+inline constexpr size_t kEventCount = static_cast<size_t>(Event::DtlbMisses) + 1u;
+
+const char* EventName(Event event);
+
+// Values of all events. Events that could not be opened have no value
+struct Reading {
+    std::array<std::optional<uint64_t>, kEventCount> values;
+
+    [[nodiscard]] const std::optional<uint64_t>& operator[](Event event) const {
+        return values[static_cast<size_t>(event)];
+    }
+
+    Reading& operator+=(const Reading& other);
+    Reading operator-(const Reading& other) const;
+};
+
+// Counters of user space events of the calling thread. They run from construction to
+// destruction, phases are measured as differences of readings. Events the kernel or the
+// hardware does not provide (e.g. in virtual machines) are skipped
+class CounterSet {
+public:
+    CounterSet();
+    ~CounterSet();
+
+    CounterSet(const CounterSet&) = delete;
+    CounterSet& operator=(const CounterSet&) = delete;
+
+    [[nodiscard]] bool IsAvailable(Event event) const {
+        return fds_[static_cast<size_t>(event)] >= 0;
+    }
+
+    // Explains why some events are unavailable, empty if all of them were opened
+    [[nodiscard]] const std::string& GetError() const {
+        return error_;
+    }
+
+    // Current values, scaled up if the kernel multiplexed the counters
+    [[nodiscard]] Reading Read() const;
+
+private:
+    std::array<int, kEventCount> fds_;
+    std::string error_;
+};
+
+// Events accumulated per named region, e.g. per interpreter phase or per statement
+class RegionCounters {
+public:
+    explicit RegionCounters(const CounterSet& counters)
+        :counters_(counters) {}
+
+    // Adds the events of its lifetime to the region
+    class Scope {
+    public:
+        Scope(RegionCounters& regions, std::string name)
+            :regions_(regions), name_(std::move(name)), start_(regions.counters_.Read()) {}
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            regions_.Add(name_, regions_.counters_.Read() - start_);
+        }
+
+    private:
+        RegionCounters& regions_;
+        std::string name_;
+        Reading start_;
+    };
+
+    [[nodiscard]] Scope Measure(std::string name) {
+        return Scope(*this, std::move(name));
+    }
+
+    void Add(const std::string& name, const Reading& reading);
+
+    [[nodiscard]] const std::vector<std::pair<std::string, Reading>>& GetRegions() const {
+        return regions_;
+    }
+
+    // Prints a table of regions in the order they were first measured, with instructions per
+    // cycle. "n/a" marks unavailable events. If there are more than top regions, only the top
+    // ones by cycles, or by task clock without cycles, are printed
+    void Report(std::ostream& os, size_t top = SIZE_MAX) const;
+
+private:
+    const CounterSet& counters_;
+    std::vector<std::pair<std::string, Reading>> regions_;
+};
+
+}  // namespace perf
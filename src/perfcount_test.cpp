@@ -0,0 +1,94 @@
+#include "perfcount.h"
+
+#include "test_runner_p.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace perf {
+
+namespace {
+
+// Keeps the CPU busy in user space, so that the task clock advances
+uint64_t BusyWork() {
+    volatile uint64_t sum = 0u;
+    for (uint64_t i = 0u; i < 2'000'000u; ++i)
+    {
+        sum = sum + i * i;
+    }
+    return sum;
+}
+
+void TestReadingArithmetic() {
+    Reading lhs;
+    lhs.values[static_cast<size_t>(Event::Cycles)] = 100u;
+    lhs.values[static_cast<size_t>(Event::Instructions)] = 50u;
+    Reading rhs;
+    rhs.values[static_cast<size_t>(Event::Cycles)] = 30u;
+
+    Reading difference = lhs - rhs;
+    ASSERT_EQUAL(*difference[Event::Cycles], 70u);
+    // An event unavailable in one of the readings has no difference
+    ASSERT(!difference[Event::Instructions]);
+
+    difference += lhs;
+    ASSERT_EQUAL(*difference[Event::Cycles], 170u);
+    ASSERT_EQUAL(*difference[Event::Instructions], 50u);
+    ASSERT(!difference[Event::DtlbMisses]);
+}
+
+void TestUnavailableEventsAreSkipped() {
+    CounterSet counters;
+    Reading before = counters.Read();
+    BusyWork();
+    Reading after = counters.Read();
+
+    bool all_available = true;
+    for (size_t i = 0u; i < kEventCount; ++i)
+    {
+        const auto event = static_cast<Event>(i);
+        ASSERT_EQUAL(static_cast<bool>(after[event]), counters.IsAvailable(event));
+        all_available = all_available && counters.IsAvailable(event);
+    }
+    ASSERT_EQUAL(counters.GetError().empty(), all_available);
+    if (counters.IsAvailable(Event::TaskClock))
+    {
+        ASSERT(*after[Event::TaskClock] > *before[Event::TaskClock]);
+    }
+}
+
+void TestRegionsReport() {
+    CounterSet counters;
+    RegionCounters regions(counters);
+    for (int i = 0; i < 2; ++i)
+    {
+        auto scope = regions.Measure("loop"s);
+        BusyWork();
+    }
+    {
+        auto scope = regions.Measure("empty"s);
+    }
+    ASSERT_EQUAL(regions.GetRegions().size(), 2u);
+    ASSERT_EQUAL(regions.GetRegions().front().first, "loop"s);
+
+    ostringstream report;
+    regions.Report(report, 1u);
+    ASSERT(report.str().find("cycles"s) != string::npos);
+    ASSERT(report.str().find("loop"s) != string::npos);
+    ASSERT(report.str().find("empty"s) == string::npos);
+    if (!counters.IsAvailable(Event::Cycles))
+    {
+        ASSERT(report.str().find("n/a"s) != string::npos);
+    }
+}
+
+}  // namespace
+
+void RunPerfCountTests(TestRunner& tr) {
+    RUN_TEST(tr, perf::TestReadingArithmetic);
+    RUN_TEST(tr, perf::TestUnavailableEventsAreSkipped);
+    RUN_TEST(tr, perf::TestRegionsReport);
+}
+
+}  // namespace perf
@@ -0,0 +1,119 @@
+#include "perfmap.h"
+
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace perfmap {
+
+namespace {
+
+#if defined(__x86_64__)
+// push %rbp; mov %rsp,%rbp; call *%rsi; pop %rbp; ret
+// The state stays in %rdi for the body. The frame keeps %rbp chains intact for perf unwinding
+constexpr unsigned char TRAMPOLINE_CODE[] = {0x55, 0x48, 0x89, 0xe5, 0xff, 0xd6, 0x5d, 0xc3};
+constexpr bool SUPPORTED = true;
+#else
+constexpr unsigned char TRAMPOLINE_CODE[] = {0x00};
+constexpr bool SUPPORTED = false;
+#endif
+
+// Trampolines are aligned like functions
+constexpr size_t TRAMPOLINE_SIZE = 16u;
+
+size_t PageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+}  // namespace
+
+bool PerfMap::IsSupported() {
+    return SUPPORTED;
+}
+
+string PerfMap::DefaultPath() {
+    return "/tmp/perf-"s + to_string(getpid()) + ".map"s;
+}
+
+PerfMap::~PerfMap() {
+    Stop();
+    for (void* page : pages_)
+    {
+        munmap(page, PageSize());
+    }
+}
+
+void PerfMap::Start(const string& path) {
+    if (!IsSupported())
+    {
+        throw runtime_error("Perf map trampolines are not supported on this platform"s);
+    }
+    map_file_.open(path, ios::app);
+    if (!map_file_)
+    {
+        throw runtime_error("Cannot open "s + path);
+    }
+    active_ = this;
+}
+
+void PerfMap::Stop() {
+    if (active_ == this)
+    {
+        active_ = nullptr;
+        map_file_.close();
+    }
+}
+
+PerfMap::Trampoline PerfMap::GetTrampoline(const void* key, const string& class_name,
+                                           const string& method_name, size_t line) {
+    auto it = trampolines_.find(key);
+    if (it != trampolines_.end())
+    {
+        return it->second;
+    }
+
+    Trampoline trampoline = AllocateTrampoline();
+    trampolines_.emplace(key, trampoline);
+    map_file_ << hex << reinterpret_cast<uintptr_t>(trampoline) << ' ' << sizeof(TRAMPOLINE_CODE)
+              << dec << " mython::" << class_name << '.' << method_name << ':' << line << '\n';
+    // perf may read the map while the process is still running
+    map_file_.flush();
+    return trampoline;
+}
+
+// A new page is filled with copies of the trampoline and made executable at once,
+// so that no page is ever writable and executable
+PerfMap::Trampoline PerfMap::AllocateTrampoline() {
+    const size_t per_page = PageSize() / TRAMPOLINE_SIZE;
+    if (pages_.empty() || used_in_last_page_ == per_page)
+    {
+        void* page = mmap(nullptr, PageSize(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1, 0);
+        if (page == MAP_FAILED)
+        {
+            throw runtime_error("Cannot map a page for trampolines"s);
+        }
+        for (size_t i = 0u; i < per_page; ++i)
+        {
+            memcpy(static_cast<char*>(page) + i * TRAMPOLINE_SIZE, TRAMPOLINE_CODE,
+                   sizeof(TRAMPOLINE_CODE));
+        }
+        if (mprotect(page, PageSize(), PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(page, PageSize());
+            throw runtime_error("Cannot make trampolines executable"s);
+        }
+        pages_.push_back(page);
+        used_in_last_page_ = 0u;
+    }
+    char* code = static_cast<char*>(pages_.back()) + used_in_last_page_++ * TRAMPOLINE_SIZE;
+    return reinterpret_cast<Trampoline>(code);
+}
+
+}  // namespace perfmap
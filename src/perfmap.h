@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Makes Mython methods visible to native profilers such as `perf record`. Every method is
+// called through its own copy of a tiny machine code trampoline, and the address of each copy
+// is written to /tmp/perf-<pid>.map with the name of the method. Samples taken while the
+// method runs then have a "mython::Class.method:line" frame in their native call stack
+namespace perfmap {
+
+class PerfMap {
+public:
+    using Body = void (*)(void* state);
+    using Trampoline = void (*)(void* state, Body body);
+
+    // Returns true if trampolines can be generated for this platform (x86-64 only)
+    static bool IsSupported();
+
+    // Returns the active perf map or nullptr if it is off
+    static PerfMap* Active() {
+        return active_;
+    }
+
+    // Path perf looks the symbols of this process up in
+    static std::string DefaultPath();
+
+    PerfMap() = default;
+    ~PerfMap();
+
+    PerfMap(const PerfMap&) = delete;
+    PerfMap& operator=(const PerfMap&) = delete;
+
+    // Opens the map file and makes this perf map the active one
+    void Start(const std::string& path = DefaultPath());
+    // Closes the map file. Trampolines stay mapped until the perf map is destroyed
+    void Stop();
+
+    // Calls f through the trampoline of the method identified by key and returns its result.
+    // Exceptions cannot unwind through the generated code, so they are passed around it
+    template <typename F>
+    auto Call(const void* key, const std::string& class_name, const std::string& method_name,
+              size_t line, F&& f) -> decltype(f()) {
+        using Result = decltype(f());
+        struct State {
+            F* f;
+            std::optional<Result> result;
+            std::exception_ptr error;
+        };
+
+        State state{&f, std::nullopt, nullptr};
+        Trampoline trampoline = GetTrampoline(key, class_name, method_name, line);
+        trampoline(&state, [](void* p) {
+            auto* s = static_cast<State*>(p);
+            try
+            {
+                s->result.emplace((*s->f)());
+            }
+            catch (...)
+            {
+                s->error = std::current_exception();
+            }
+        });
+        if (state.error)
+        {
+            std::rethrow_exception(state.error);
+        }
+        return std::move(*state.result);
+    }
+
+    [[nodiscard]] size_t GetTrampolineCount() const {
+        return trampolines_.size();
+    }
+
+private:
+    Trampoline GetTrampoline(const void* key, const std::string& class_name,
+                             const std::string& method_name, size_t line);
+    Trampoline AllocateTrampoline();
+
+    static inline PerfMap* active_ = nullptr;
+
+    std::ofstream map_file_;
+    std::unordered_map<const void*, Trampoline> trampolines_;
+    // Executable pages and the number of trampolines handed out from the last one
+    std::vector<void*> pages_;
+    size_t used_in_last_page_ = 0u;
+};
+
+}  // namespace perfmap
@@ -0,0 +1,101 @@
+#include "perfmap.h"
+#include "statement.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+#include <cstdio>
+
+using namespace std;
+
+namespace perfmap {
+
+namespace {
+
+const string MAP_PATH = "mython_perfmap_test.map"s;
+
+string ReadMap() {
+    ifstream file(MAP_PATH);
+    return {istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+}
+
+void TestMethodsGetMapEntries() {
+    if (!PerfMap::IsSupported())
+    {
+        return;
+    }
+    runtime::DummyContext context;
+    PerfMap perf_map;
+    RunOptions options;
+    options.before = [&perf_map](runtime::Executable& /*program*/) {
+        perf_map.Start(MAP_PATH);
+    };
+    options.executed = [&perf_map](runtime::Closure& /*globals*/) {
+        perf_map.Stop();
+    };
+    ExecuteProgram(R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+class Runner:
+  def run(fib):
+    return fib.calc(10)
+
+runner = Runner()
+print runner.run(Fib())
+)"s, context, options);
+    ASSERT_EQUAL(perf_map.GetTrampolineCount(), 2u);
+    ASSERT_EQUAL(context.output.str(), "55\n"s);
+
+    istringstream map(ReadMap());
+    vector<string> names;
+    for (string address, size, name; map >> address >> size >> name;)
+    {
+        ASSERT_EQUAL(size, "8"s);
+        ASSERT(stoull(address, nullptr, 16) != 0u);
+        names.push_back(name);
+    }
+    ASSERT_EQUAL(names, (vector<string>{"mython::Runner.run:9"s, "mython::Fib.calc:3"s}));
+    remove(MAP_PATH.c_str());
+}
+
+void TestExceptionsPassTrampolines() {
+    if (!PerfMap::IsSupported())
+    {
+        return;
+    }
+    PerfMap perf_map;
+    perf_map.Start(MAP_PATH);
+    const int key = 0;
+    ASSERT_EQUAL(perf_map.Call(&key, "A"s, "f"s, 1u, [] {
+        return 42;
+    }), 42);
+
+    bool caught = false;
+    try
+    {
+        perf_map.Call(&key, "A"s, "f"s, 1u, []() -> int {
+            throw runtime_error("failed"s);
+        });
+    }
+    catch (const runtime_error& e)
+    {
+        caught = e.what() == "failed"s;
+    }
+    ASSERT(caught);
+    ASSERT_EQUAL(perf_map.GetTrampolineCount(), 1u);
+    perf_map.Stop();
+    remove(MAP_PATH.c_str());
+}
+
+}  // namespace
+
+void RunPerfMapTests(TestRunner& tr) {
+    RUN_TEST(tr, perfmap::TestMethodsGetMapEntries);
+    RUN_TEST(tr, perfmap::TestExceptionsPassTrampolines);
+}
+
+}  // namespace perfmap
@@ -0,0 +1,161 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cxxabi.h>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <typeinfo>
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+double ToMilliseconds(Clock::duration duration) {
+    return chrono::duration<double, milli>(duration).count();
+}
+
+string_view SourceLine(const vector<string>& source_lines, size_t line) {
+    if (line == 0u || line > source_lines.size())
+    {
+        return {};
+    }
+    string_view text = source_lines.at(line - 1u);
+    text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
+    return text;
+}
+
+}  // namespace
+
+void NodeProfiler::Start() {
+    active_ = this;
+}
+
+void NodeProfiler::Stop() {
+    if (active_ == this)
+    {
+        active_ = nullptr;
+    }
+}
+
+void NodeProfiler::RegisterStatement(const runtime::Executable& stmt) {
+    statements_.push_back(&stmt);
+}
+
+void NodeProfiler::RetainStatements(const unordered_set<const runtime::Executable*>& statements) {
+    statements_.erase(remove_if(statements_.begin(), statements_.end(), [&](const auto* stmt) {
+        return statements.count(stmt) == 0u;
+    }), statements_.end());
+}
+
+NodeStats& NodeProfiler::Enter(const runtime::Executable& node) {
+    NodeStats& stats = stats_[&node];
+    ++stats.executions;
+    ++stats.active;
+    return stats;
+}
+
+void NodeProfiler::Leave(NodeStats& stats, Clock::time_point start) {
+    if (--stats.active == 0u)
+    {
+        stats.inclusive_time += Clock::now() - start;
+    }
+}
+
+const NodeStats* NodeProfiler::GetStats(const runtime::Executable& node) const {
+    auto it = stats_.find(&node);
+    return it == stats_.end() ? nullptr : &it->second;
+}
+
+vector<pair<size_t, NodeProfiler::LineStats>> NodeProfiler::CollectLines() const {
+    map<size_t, LineStats> lines;
+    for (const runtime::Executable* stmt : statements_)
+    {
+        size_t line = stmt->GetPosition().line;
+        if (line == 0u)
+        {
+            continue;
+        }
+        LineStats& line_stats = lines[line];
+        if (line_stats.statement == nullptr)
+        {
+            line_stats.statement = stmt;
+        }
+        if (const NodeStats* stats = GetStats(*stmt))
+        {
+            line_stats.executions += stats->executions;
+            line_stats.inclusive_time += stats->inclusive_time;
+        }
+    }
+    return {lines.begin(), lines.end()};
+}
+
+void NodeProfiler::ReportHotLines(ostream& os, const vector<string>& source_lines, size_t top) const {
+    auto lines = CollectLines();
+    lines.erase(remove_if(lines.begin(), lines.end(), [](const auto& line) {
+        return line.second.executions == 0u;
+    }), lines.end());
+    sort(lines.begin(), lines.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.inclusive_time > rhs.second.inclusive_time;
+    });
+    if (lines.size() > top)
+    {
+        lines.resize(top);
+    }
+
+    os << "Hot lines (inclusive time):\n";
+    os << setw(8) << "line" << setw(12) << "hits" << setw(14) << "total_ms" << setw(14)
+       << "per_hit_us" << "  " << left << setw(22) << "statement" << right << "source\n";
+    for (const auto& [line, stats] : lines)
+    {
+        double total_ms = ToMilliseconds(stats.inclusive_time);
+        os << setw(8) << line << setw(12) << stats.executions << fixed << setprecision(3)
+           << setw(14) << total_ms << setw(14) << total_ms * 1000.0 / stats.executions << "  "
+           << left << setw(22) << NodeTypeName(*stats.statement) << right
+           << SourceLine(source_lines, line) << '\n';
+    }
+}
+
+void NodeProfiler::ReportCoverage(ostream& os, const vector<string>& source_lines) const {
+    auto lines = CollectLines();
+    size_t executed = count_if(lines.begin(), lines.end(), [](const auto& line) {
+        return line.second.executions > 0u;
+    });
+
+    os << "Line coverage: " << executed << " of " << lines.size() << " lines executed\n";
+    auto it = lines.begin();
+    for (size_t line = 1u; line <= source_lines.size(); ++line)
+    {
+        while (it != lines.end() && it->first < line)
+        {
+            ++it;
+        }
+        os << setw(10);
+        if (it == lines.end() || it->first != line)
+        {
+            os << "-";
+        }
+        else if (it->second.executions == 0u)
+        {
+            os << "#####";
+        }
+        else
+        {
+            os << it->second.executions;
+        }
+        os << ':' << setw(6) << line << ": " << source_lines.at(line - 1u) << '\n';
+    }
+}
+
+string NodeTypeName(const runtime::Executable& node) {
+    const char* mangled = typeid(node).name();
+    int status = 0;
+    unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(mangled, nullptr, nullptr, &status),
+                                                free);
+    return status == 0 ? string(demangled.get()) : string(mangled);
+}
+
+}  // namespace profile
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "runtime.h"
+#include "sampler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace profile {
+
+using Clock = std::chrono::steady_clock;
+
+// Execution statistics of a single AST node
+struct NodeStats {
+    uint64_t executions = 0u;
+    // Time spent inside the node including its children. Recursive activations of the node
+    // are not added twice: only the outermost one is timed
+    Clock::duration inclusive_time{};
+    uint32_t active = 0u;
+};
+
+// Counts executions and inclusive time of every AST node while it is active
+class NodeProfiler {
+public:
+    // Returns the active profiler or nullptr if profiling is off
+    static NodeProfiler* Active() {
+        return active_;
+    }
+
+    // Makes this profiler the active one. Only one profiler may be active at a time
+    void Start();
+    void Stop();
+
+    // Remembers stmt as a statement of the program. Statements are reported per source line,
+    // the rest of the nodes only contribute to their statement's time
+    void RegisterStatement(const runtime::Executable& stmt);
+    // Forgets registered statements missing from statements, e.g. removed by constant folding
+    void RetainStatements(const std::unordered_set<const runtime::Executable*>& statements);
+
+    NodeStats& Enter(const runtime::Executable& node);
+    void Leave(NodeStats& stats, Clock::time_point start);
+
+    [[nodiscard]] const NodeStats* GetStats(const runtime::Executable& node) const;
+
+    // Prints top statements ordered by inclusive time together with their source lines
+    void ReportHotLines(std::ostream& os, const std::vector<std::string>& source_lines,
+                        size_t top) const;
+    // Prints the source annotated with execution counts of its statements, gcov style:
+    // "-" marks lines without statements, "#####" marks statements that never ran
+    void ReportCoverage(std::ostream& os, const std::vector<std::string>& source_lines) const;
+
+private:
+    struct LineStats {
+        uint64_t executions = 0u;
+        Clock::duration inclusive_time{};
+        const runtime::Executable* statement = nullptr;
+    };
+
+    [[nodiscard]] std::vector<std::pair<size_t, LineStats>> CollectLines() const;
+
+    static inline NodeProfiler* active_ = nullptr;
+
+    std::unordered_map<const runtime::Executable*, NodeStats> stats_;
+    std::vector<const runtime::Executable*> statements_;
+};
+
+// Guard placed at the beginning of every Execute. Does nothing unless profiling, sampling,
+// the heap census or operation counting is on
+class NodeScope {
+public:
+    explicit NodeScope(const runtime::Executable& node) {
+        opcount::CountExecute(typeid(node));
+        if (NodeProfiler* profiler = NodeProfiler::Active())
+        {
+            profiler_ = profiler;
+            stats_ = &profiler->Enter(node);
+            start_ = Clock::now();
+        }
+        if (sample::Sampler::Active() != nullptr)
+        {
+            // The sampler attributes samples to the innermost node of every frame
+            if ((frame_ = sample::CurrentFrame()))
+            {
+                previous_node_ = frame_->node;
+                frame_->node = &node;
+            }
+        }
+        if (census::HeapCensus* census = census::HeapCensus::Active())
+        {
+            // Objects created by the node are attributed to it
+            census_ = census;
+            previous_site_ = census->SetCurrentNode(&node);
+        }
+    }
+
+    NodeScope(const NodeScope&) = delete;
+    NodeScope& operator=(const NodeScope&) = delete;
+
+    ~NodeScope() {
+        if (stats_ != nullptr)
+        {
+            profiler_->Leave(*stats_, start_);
+        }
+        if (frame_ != nullptr)
+        {
+            frame_->node = previous_node_;
+        }
+        if (census_ != nullptr)
+        {
+            census_->SetCurrentNode(previous_site_);
+        }
+    }
+
+private:
+    NodeProfiler* profiler_ = nullptr;
+    NodeStats* stats_ = nullptr;
+    Clock::time_point start_;
+    sample::ShadowFrame* frame_ = nullptr;
+    const runtime::Executable* previous_node_ = nullptr;
+    census::HeapCensus* census_ = nullptr;
+    const runtime::Executable* previous_site_ = nullptr;
+};
+
+// Returns readable name of the node type, e.g. "ast::Assignment"
+std::string NodeTypeName(const runtime::Executable& node);
+
+}  // namespace profile
@@ -0,0 +1,101 @@
+#include "lexer.h"
+#include "parse.h"
+#include "profiler.h"
+#include "statement.h"
+
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace profile {
+
+namespace {
+
+void TestStatementPositions() {
+    istringstream input(R"(
+class Counter:
+  def add(x):
+    return x + 1
+
+c = Counter()
+print c.add(2)
+)"s);
+    parse::Lexer lexer(input);
+
+    NodeProfiler profiler;
+    profiler.Start();
+    auto program = ParseProgram(lexer);
+    profiler.Stop();
+
+    ostringstream report;
+    profiler.ReportCoverage(report, {"", "class Counter:", "  def add(x):", "    return x + 1", "",
+                                     "c = Counter()", "print c.add(2)"});
+    ASSERT(report.str().find("Line coverage: 0 of 4 lines executed"s) != string::npos);
+    ASSERT(report.str().find("#####:     4:     return x + 1"s) != string::npos);
+}
+
+void TestCountsExecutions() {
+    const string source = R"(class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+x = Fib()
+print x.calc(5)
+)"s;
+    istringstream input(source);
+    parse::Lexer lexer(input);
+    runtime::DummyContext context;
+
+    NodeProfiler profiler;
+    profiler.Start();
+    auto program = ParseProgram(lexer);
+    runtime::Closure closure;
+    program->Execute(closure, context);
+    profiler.Stop();
+
+    ASSERT_EQUAL(context.output.str(), "5\n"s);
+
+    const NodeStats* stats = profiler.GetStats(*program);
+    ASSERT(stats != nullptr);
+    ASSERT_EQUAL(stats->executions, 1u);
+    ASSERT_EQUAL(stats->active, 0u);
+
+    ostringstream coverage;
+    profiler.ReportCoverage(coverage, {"class Fib:", "  def calc(n):", "    if n < 2:",
+                                       "      return n",
+                                       "    return self.calc(n - 1) + self.calc(n - 2)", "",
+                                       "x = Fib()", "print x.calc(5)"});
+    ASSERT(coverage.str().find("Line coverage: 6 of 6 lines executed"s) != string::npos);
+    ASSERT(coverage.str().find("15:     3:     if n < 2:"s) != string::npos);
+    ASSERT(coverage.str().find("8:     4:       return n"s) != string::npos);
+    ASSERT(coverage.str().find("7:     5:     return self.calc"s) != string::npos);
+
+    ostringstream hot_lines;
+    profiler.ReportHotLines(hot_lines, {}, 1u);
+    ASSERT(hot_lines.str().find("ast::Print"s) != string::npos);
+    ASSERT(hot_lines.str().find("ast::Return"s) == string::npos);
+}
+
+void TestInactiveProfilerCountsNothing() {
+    NodeProfiler profiler;
+    ASSERT(NodeProfiler::Active() == nullptr);
+
+    ast::Print print(vector<unique_ptr<ast::Statement>>{});
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    print.Execute(closure, context);
+
+    ASSERT(profiler.GetStats(print) == nullptr);
+}
+
+}  // namespace
+
+void RunProfilerTests(TestRunner& tr) {
+    RUN_TEST(tr, profile::TestStatementPositions);
+    RUN_TEST(tr, profile::TestCountsExecutions);
+    RUN_TEST(tr, profile::TestInactiveProfilerCountsNothing);
+}
+
+}  // namespace profile
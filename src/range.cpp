@@ -0,0 +1,640 @@
+#include "range.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace range {
+
+namespace {
+
+// Bounds are computed wider than 64 bits, so that sums and products of 64-bit bounds are exact.
+// Anything beyond the 64-bit range is clamped to INF, which stands for no bound at all
+using Bound = __int128;
+constexpr Bound INF = Bound{1} << 64u;
+
+Bound Clamp(Bound value) {
+    if (value > INT64_MAX)
+    {
+        return INF;
+    }
+    if (value < INT64_MIN)
+    {
+        return -INF;
+    }
+    return value;
+}
+
+// Product of two clamped bounds. Finite ones are at most 2^63 in magnitude
+Bound Multiply(Bound lhs, Bound rhs) {
+    if (lhs == 0 || rhs == 0)
+    {
+        return 0;
+    }
+    if (lhs == INF || lhs == -INF || rhs == INF || rhs == -INF)
+    {
+        return (lhs < 0) == (rhs < 0) ? INF : -INF;
+    }
+    return Clamp(lhs * rhs);
+}
+
+// Bounds of a number. Environments keep one for every variable, so they are stored in 64 bits
+// and the extreme 64-bit values stand for no bound
+class Interval {
+public:
+    Interval() = default;
+    Interval(Bound lo, Bound hi)
+        :lo_(Store(lo)), hi_(Store(hi)) {}
+
+    [[nodiscard]] Bound Lo() const {
+        return lo_ == INT64_MIN ? -INF : lo_;
+    }
+
+    [[nodiscard]] Bound Hi() const {
+        return hi_ == INT64_MAX ? INF : hi_;
+    }
+
+    [[nodiscard]] bool Fits() const {
+        return lo_ != INT64_MIN && hi_ != INT64_MAX;
+    }
+
+    [[nodiscard]] bool Contains(Bound value) const {
+        return Lo() <= value && value <= Hi();
+    }
+
+    bool operator==(const Interval& other) const {
+        return lo_ == other.lo_ && hi_ == other.hi_;
+    }
+
+private:
+    static int64_t Store(Bound value) {
+        return static_cast<int64_t>(clamp(value, Bound{INT64_MIN}, Bound{INT64_MAX}));
+    }
+
+    int64_t lo_ = INT64_MIN;
+    int64_t hi_ = INT64_MAX;
+};
+
+Interval Hull(const Interval& lhs, const Interval& rhs) {
+    return {min(lhs.Lo(), rhs.Lo()), max(lhs.Hi(), rhs.Hi())};
+}
+
+// What is known about the value of an expression. The interval bounds the value only if it is
+// a number: comparing an instance with a number calls its methods and bounds nothing
+struct Value {
+    // The value is always a Number
+    bool number = false;
+    Interval range;
+
+    bool operator==(const Value& other) const {
+        return number == other.number && range == other.range;
+    }
+};
+
+Value Join(const Value& lhs, const Value& rhs) {
+    return {lhs.number && rhs.number, Hull(lhs.range, rhs.range)};
+}
+
+// Variables of the program or of a method, numbered in the order they are met so that
+// environments keep their values by index. Programs may have a great many globals, so an
+// environment is one vector rather than a node per variable, and copying it for a branch allocates
+// once. The numbers are found in an open-addressing table of pointers to the names in the program
+class Scope {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    // Returns the number of the variable, which is new if the name is
+    uint32_t Add(const string& name) {
+        if ((size_ + 1u) * 2u > slots_.size())
+        {
+            Grow();
+        }
+        Slot& slot = slots_[Probe(name)];
+        if (slot.name == nullptr)
+        {
+            slot = {&name, size_++};
+        }
+        return slot.index;
+    }
+
+    // Returns the number of the variable or NONE
+    [[nodiscard]] uint32_t Find(const string& name) const {
+        return slots_.empty() ? NONE : slots_[Probe(name)].index;
+    }
+
+private:
+    struct Slot {
+        // Null in a free slot
+        const string* name = nullptr;
+        uint32_t index = NONE;
+    };
+
+    static constexpr size_t MIN_SLOTS = 16u;
+
+    // Returns the slot of name or the free slot where it goes. The number of slots is a power of two
+    [[nodiscard]] size_t Probe(const string& name) const {
+        const size_t mask = slots_.size() - 1u;
+        size_t i = hash<string>{}(name) & mask;
+        while (slots_[i].name != nullptr && *slots_[i].name != name)
+        {
+            i = (i + 1u) & mask;
+        }
+        return i;
+    }
+
+    void Grow() {
+        vector<Slot> slots = exchange(slots_, vector<Slot>(max(slots_.size() * 2u, MIN_SLOTS)));
+        for (const Slot& slot : slots)
+        {
+            if (slot.name != nullptr)
+            {
+                slots_[Probe(*slot.name)] = slot;
+            }
+        }
+    }
+
+    vector<Slot> slots_;
+    uint32_t size_ = 0u;
+};
+
+// Values of the variables of a scope. All of them start unknown
+class Env {
+public:
+    explicit Env(Scope& scope)
+        :scope_(&scope) {}
+
+    [[nodiscard]] const Value& operator[](const string& name) const {
+        return Get(scope_->Find(name));
+    }
+
+    Value& operator[](const string& name) {
+        const uint32_t index = scope_->Add(name);
+        if (index >= values_.size())
+        {
+            values_.resize(index + 1u);
+        }
+        return values_[index];
+    }
+
+    // Variables met after the shorter environment was made are unknown in it, so they are
+    // unknown in the result as well
+    template <typename Fn>
+    friend Env Combine(const Env& lhs, const Env& rhs, Fn fn) {
+        Env result(*lhs.scope_);
+        result.values_.resize(min(lhs.values_.size(), rhs.values_.size()));
+        for (size_t i = 0u; i < result.values_.size(); ++i)
+        {
+            result.values_[i] = fn(lhs.values_[i], rhs.values_[i]);
+        }
+        return result;
+    }
+
+    bool operator==(const Env& other) const {
+        for (size_t i = 0u; i < max(values_.size(), other.values_.size()); ++i)
+        {
+            if (!(Get(i) == other.Get(i)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    [[nodiscard]] const Value& Get(size_t index) const {
+        static const Value unknown;
+        return index < values_.size() ? values_[index] : unknown;
+    }
+
+    Scope* scope_;
+    vector<Value> values_;
+};
+
+Env Join(const Env& lhs, const Env& rhs) {
+    return Combine(lhs, rhs, [](const Value& lhs, const Value& rhs) {
+        return Join(lhs, rhs);
+    });
+}
+
+// Joins old and current, but bounds that keep growing go to infinity at once, so that loops
+// are analysed in a few rounds
+Env Widen(const Env& old, const Env& current) {
+    return Combine(old, current, [](const Value& old, const Value& current) {
+        return Value{old.number && current.number,
+                     {current.range.Lo() < old.range.Lo() ? -INF : old.range.Lo(),
+                      current.range.Hi() > old.range.Hi() ? INF : old.range.Hi()}};
+    });
+}
+
+Interval Apply(const ast::Statement& operation, const Interval& lhs, const Interval& rhs) {
+    if (dynamic_cast<const ast::Add*>(&operation) != nullptr)
+    {
+        return {lhs.Lo() + rhs.Lo(), lhs.Hi() + rhs.Hi()};
+    }
+    if (dynamic_cast<const ast::Sub*>(&operation) != nullptr)
+    {
+        return {lhs.Lo() - rhs.Hi(), lhs.Hi() - rhs.Lo()};
+    }
+    if (dynamic_cast<const ast::Mult*>(&operation) != nullptr)
+    {
+        const Bound corners[] = {Multiply(lhs.Lo(), rhs.Lo()), Multiply(lhs.Lo(), rhs.Hi()),
+                                 Multiply(lhs.Hi(), rhs.Lo()), Multiply(lhs.Hi(), rhs.Hi())};
+        return {*min_element(begin(corners), end(corners)), *max_element(begin(corners), end(corners))};
+    }
+    // Division rounds toward zero: the quotient is never larger in magnitude than the dividend,
+    // and with finite bounds and a divisor of one sign it is found at the corners
+    if (lhs.Fits() && rhs.Fits() && !rhs.Contains(0))
+    {
+        const Bound corners[] = {lhs.Lo() / rhs.Lo(), lhs.Lo() / rhs.Hi(), lhs.Hi() / rhs.Lo(), lhs.Hi() / rhs.Hi()};
+        return {*min_element(begin(corners), end(corners)), *max_element(begin(corners), end(corners))};
+    }
+    const Bound magnitude = max(lhs.Hi(), -lhs.Lo());
+    return {-magnitude, magnitude};
+}
+
+runtime::CompareOp Negate(runtime::CompareOp op) {
+    switch (op)
+    {
+    case runtime::CompareOp::Equal:
+        return runtime::CompareOp::NotEqual;
+    case runtime::CompareOp::NotEqual:
+        return runtime::CompareOp::Equal;
+    case runtime::CompareOp::Less:
+        return runtime::CompareOp::GreaterOrEqual;
+    case runtime::CompareOp::Greater:
+        return runtime::CompareOp::LessOrEqual;
+    case runtime::CompareOp::LessOrEqual:
+        return runtime::CompareOp::Greater;
+    case runtime::CompareOp::GreaterOrEqual:
+        return runtime::CompareOp::Less;
+    }
+    return op;
+}
+
+// The operation with its operands swapped: a < b is b > a
+runtime::CompareOp Mirror(runtime::CompareOp op) {
+    switch (op)
+    {
+    case runtime::CompareOp::Less:
+        return runtime::CompareOp::Greater;
+    case runtime::CompareOp::Greater:
+        return runtime::CompareOp::Less;
+    case runtime::CompareOp::LessOrEqual:
+        return runtime::CompareOp::GreaterOrEqual;
+    case runtime::CompareOp::GreaterOrEqual:
+        return runtime::CompareOp::LessOrEqual;
+    default:
+        return op;
+    }
+}
+
+// Narrows value, known to satisfy value op other for a number other
+void Constrain(Interval& value, runtime::CompareOp op, const Interval& other) {
+    Bound lo = value.Lo();
+    Bound hi = value.Hi();
+    switch (op)
+    {
+    case runtime::CompareOp::Equal:
+        lo = max(lo, other.Lo());
+        hi = min(hi, other.Hi());
+        break;
+    case runtime::CompareOp::NotEqual:
+        break;
+    case runtime::CompareOp::Less:
+        hi = min(hi, Clamp(other.Hi() - 1));
+        break;
+    case runtime::CompareOp::Greater:
+        lo = max(lo, Clamp(other.Lo() + 1));
+        break;
+    case runtime::CompareOp::LessOrEqual:
+        hi = min(hi, other.Hi());
+        break;
+    case runtime::CompareOp::GreaterOrEqual:
+        lo = max(lo, other.Lo());
+        break;
+    }
+    // An empty range means that the branch is never taken, the bounds it had will do
+    if (lo <= hi)
+    {
+        value = {lo, hi};
+    }
+}
+
+}  // namespace
+
+class RangeAnalysis {
+public:
+    void AnalyzeProgram(runtime::Executable& program) {
+        Scope scope;
+        Env globals(scope);
+        Run(program, globals);
+    }
+
+    // Marks the operations that never overflow
+    Stats Finish();
+
+private:
+    // Loops are analysed again until the bounds stop changing. Bounds still growing after
+    // this many rounds are widened to infinity
+    static constexpr size_t WIDENING_ROUND = 3u;
+
+    // Analyses a statement and returns false if it always ends with return
+    bool Run(runtime::Executable& node, Env& env);
+    Value Eval(runtime::Executable& node, const Env& env);
+    // Narrows env to the values for which condition has the truth value truth
+    void Refine(const runtime::Executable& condition, bool truth, Env& env);
+
+    // Returns the environment at the loop head. enter prepares it for an iteration
+    template <typename Enter>
+    Env AnalyzeLoop(const Env& entry, runtime::Executable& body, Enter enter);
+
+    void Record(ast::BinaryOperation& operation, bool overflow_free);
+
+    // Operations are recorded only in the last pass over a loop, when the bounds are final
+    bool recording_ = true;
+    // Each visit of an operation with whether its result fits
+    vector<pair<ast::BinaryOperation*, bool>> operations_;
+};
+
+void RangeAnalysis::Record(ast::BinaryOperation& operation, bool overflow_free) {
+    if (recording_)
+    {
+        operations_.emplace_back(&operation, overflow_free);
+    }
+}
+
+Stats RangeAnalysis::Finish() {
+    // An operation visited more than once is overflow free only if it is each time, so false
+    // sorts first
+    sort(operations_.begin(), operations_.end());
+    Stats stats;
+    for (auto it = operations_.begin(); it != operations_.end();)
+    {
+        ++stats.operations;
+        if (it->second)
+        {
+            it->first->SetOverflowFree();
+            ++stats.overflow_free;
+        }
+        it = partition_point(it, operations_.end(), [operation = it->first](const auto& visit) {
+            return visit.first == operation;
+        });
+    }
+    return stats;
+}
+
+Value RangeAnalysis::Eval(runtime::Executable& node, const Env& env) {
+    if (const auto* number = dynamic_cast<const ast::NumericConst*>(&node))
+    {
+        const bigint::Integer& value = number->GetValue().GetValue();
+        if (!value.IsSmall())
+        {
+            return {true, {}};
+        }
+        return {true, {value.GetSmall(), value.GetSmall()}};
+    }
+    if (const auto* variable = dynamic_cast<const ast::VariableValue*>(&node))
+    {
+        if (const string* name = variable->GetVariableName())
+        {
+            return env[*name];
+        }
+        return {};
+    }
+    if (auto* logical = dynamic_cast<ast::BinaryOperation*>(&node);
+        logical != nullptr && (dynamic_cast<ast::And*>(&node) != nullptr || dynamic_cast<ast::Or*>(&node) != nullptr))
+    {
+        // The right operand is evaluated only when the left one is true for and, false for or
+        Eval(*logical->GetLhs(), env);
+        Env rhs_env = env;
+        Refine(*logical->GetLhs(), dynamic_cast<ast::And*>(&node) != nullptr, rhs_env);
+        Eval(*logical->GetRhs(), rhs_env);
+        return {};
+    }
+    if (auto* binary = dynamic_cast<ast::BinaryOperation*>(&node))
+    {
+        const Value lhs = Eval(*binary->GetLhs(), env);
+        const Value rhs = Eval(*binary->GetRhs(), env);
+        if (dynamic_cast<ast::Comparison*>(&node) != nullptr)
+        {
+            return {};
+        }
+        // Operations on two numbers give a number within these bounds. If the left operand is
+        // a number, the right one must be a number as well, or the operation fails
+        const Interval range = Apply(node, lhs.range, rhs.range);
+        if (dynamic_cast<ast::Div*>(&node) == nullptr)
+        {
+            // The operands are computed in 64 bits too. x * 0 fits whatever x is, but x may not
+            Record(*binary, range.Fits() && lhs.range.Fits() && rhs.range.Fits());
+        }
+        return lhs.number ? Value{true, range} : Value{};
+    }
+    if (auto* unary = dynamic_cast<ast::UnaryOperation*>(&node))
+    {
+        Eval(*unary->GetArgument(), env);
+        return {};
+    }
+    if (auto* method_call = dynamic_cast<ast::MethodCall*>(&node))
+    {
+        Eval(*method_call->GetObject(), env);
+        for (const auto& arg : method_call->GetArgs())
+        {
+            Eval(*arg, env);
+        }
+        return {};
+    }
+    if (auto* new_instance = dynamic_cast<ast::NewInstance*>(&node))
+    {
+        for (const auto& arg : new_instance->GetArgs())
+        {
+            Eval(*arg, env);
+        }
+        return {};
+    }
+    return {};
+}
+
+void RangeAnalysis::Refine(const runtime::Executable& condition, bool truth, Env& env) {
+    if (const auto* negation = dynamic_cast<const ast::Not*>(&condition))
+    {
+        Refine(*negation->GetArgument(), !truth, env);
+        return;
+    }
+    // Both parts of a true and and of a false or hold
+    const auto* logical = dynamic_cast<const ast::BinaryOperation*>(&condition);
+    if ((truth && dynamic_cast<const ast::And*>(&condition) != nullptr)
+        || (!truth && dynamic_cast<const ast::Or*>(&condition) != nullptr))
+    {
+        Refine(*logical->GetLhs(), truth, env);
+        Refine(*logical->GetRhs(), truth, env);
+        return;
+    }
+    const auto* comparison = dynamic_cast<const ast::Comparison*>(&condition);
+    if (comparison == nullptr)
+    {
+        return;
+    }
+
+    // Operands are evaluated again only to learn their bounds
+    const bool recording = exchange(recording_, false);
+    const Value lhs = Eval(*comparison->GetLhs(), env);
+    const Value rhs = Eval(*comparison->GetRhs(), env);
+    recording_ = recording;
+
+    const runtime::CompareOp op = truth ? comparison->GetOp() : Negate(comparison->GetOp());
+    // A variable compared with a number is bounded by it if it is a number too
+    const auto constrain = [&env](const runtime::Executable& operand, runtime::CompareOp op, const Value& other) {
+        const auto* variable = dynamic_cast<const ast::VariableValue*>(&operand);
+        const string* name = variable != nullptr ? variable->GetVariableName() : nullptr;
+        if (name != nullptr && other.number)
+        {
+            Constrain(env[*name].range, op, other.range);
+        }
+    };
+    constrain(*comparison->GetLhs(), op, rhs);
+    constrain(*comparison->GetRhs(), Mirror(op), lhs);
+}
+
+template <typename Enter>
+Env RangeAnalysis::AnalyzeLoop(const Env& entry, runtime::Executable& body, Enter enter) {
+    Env head = entry;
+    const bool recording = exchange(recording_, false);
+    for (size_t round = 0u;; ++round)
+    {
+        Env iteration = head;
+        enter(iteration);
+        // The head is reached from the entry and from the end of an iteration
+        const Env next = Run(body, iteration) ? Join(entry, iteration) : entry;
+        Env widened = round < WIDENING_ROUND ? Join(head, next) : Widen(head, next);
+        if (widened == head)
+        {
+            break;
+        }
+        head = move(widened);
+    }
+    recording_ = recording;
+
+    Env iteration = head;
+    enter(iteration);
+    Run(body, iteration);
+    return head;
+}
+
+bool RangeAnalysis::Run(runtime::Executable& node, Env& env) {
+    if (auto* compound = dynamic_cast<ast::Compound*>(&node))
+    {
+        for (const auto& stmt : compound->GetStatements())
+        {
+            if (!Run(*stmt, env))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (auto* assignment = dynamic_cast<ast::Assignment*>(&node))
+    {
+        env[assignment->GetVar()] = Eval(*assignment->GetRv(), env);
+        return true;
+    }
+    if (auto* field_assignment = dynamic_cast<ast::FieldAssignment*>(&node))
+    {
+        Eval(*field_assignment->GetRv(), env);
+        return true;
+    }
+    if (auto* print = dynamic_cast<ast::Print*>(&node))
+    {
+        if (print->GetArgument())
+        {
+            Eval(*print->GetArgument(), env);
+        }
+        for (const auto& arg : print->GetArgs())
+        {
+            Eval(*arg, env);
+        }
+        return true;
+    }
+    if (auto* return_stmt = dynamic_cast<ast::Return*>(&node))
+    {
+        Eval(*return_stmt->GetStatement(), env);
+        return false;
+    }
+    if (auto* if_else = dynamic_cast<ast::IfElse*>(&node))
+    {
+        Eval(*if_else->GetCondition(), env);
+        Env if_env = env;
+        Refine(*if_else->GetCondition(), true, if_env);
+        const bool if_continues = !if_else->GetIfBody() || Run(*if_else->GetIfBody(), if_env);
+        Env else_env = env;
+        Refine(*if_else->GetCondition(), false, else_env);
+        const bool else_continues = !if_else->GetElseBody() || Run(*if_else->GetElseBody(), else_env);
+        if (if_continues && else_continues)
+        {
+            env = Join(if_env, else_env);
+        }
+        else if (if_continues || else_continues)
+        {
+            env = move(if_continues ? if_env : else_env);
+        }
+        return if_continues || else_continues;
+    }
+    if (auto* while_loop = dynamic_cast<ast::While*>(&node))
+    {
+        Env head = AnalyzeLoop(env, *while_loop->GetBody(), [&](Env& iteration) {
+            Eval(*while_loop->GetCondition(), iteration);
+            Refine(*while_loop->GetCondition(), true, iteration);
+        });
+        Refine(*while_loop->GetCondition(), false, head);
+        env = move(head);
+        return true;
+    }
+    if (auto* for_range = dynamic_cast<ast::ForRange*>(&node))
+    {
+        // The loop runs only if both bounds are numbers
+        const Interval begin = Eval(*for_range->GetBegin(), env).range;
+        const Interval end = Eval(*for_range->GetEnd(), env).range;
+        const Value counter{true, {begin.Lo(), end.Hi() - 1}};
+        env = AnalyzeLoop(env, *for_range->GetBody(), [&](Env& iteration) {
+            iteration[for_range->GetVar()] = counter;
+        });
+        return true;
+    }
+    if (auto* method_body = dynamic_cast<ast::MethodBody*>(&node))
+    {
+        Run(*method_body->GetBody(), env);
+        return true;
+    }
+    if (auto* class_definition = dynamic_cast<ast::ClassDefinition*>(&node))
+    {
+        // Methods see only their parameters and self
+        const auto& cls = class_definition->GetClass();
+        for (const runtime::Method& method : cls.GetMethods())
+        {
+            Scope scope;
+            Env locals(scope);
+            Run(*method.body, locals);
+        }
+        return true;
+    }
+    Eval(node, env);
+    return true;
+}
+
+Stats ElideOverflowChecks(runtime::Executable& program) {
+    RangeAnalysis analysis;
+    analysis.AnalyzeProgram(program);
+    return analysis.Finish();
+}
+
+void WriteStats(const Stats& stats, ostream& os) {
+    os << "Range analysis: "sv << stats.overflow_free << " of "sv << stats.operations
+       << " Add, Sub and Mult operations cannot overflow\n"sv;
+}
+
+}  // namespace range
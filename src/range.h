@@ -0,0 +1,31 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstddef>
+#include <ostream>
+
+// Value-range analysis. Add, Sub and Mult of numbers check every result for an overflow of the
+// 64-bit inline representation. Where the bounds of the operands are known from constants, loop
+// counters and the comparisons guarding a branch, the result provably fits and the check is
+// skipped
+namespace range {
+
+struct Stats {
+    // Add, Sub and Mult operations in the program
+    size_t operations = 0u;
+    // Operations whose result provably fits in 64 bits when both operands are numbers
+    size_t overflow_free = 0u;
+};
+
+// Marks the Add, Sub and Mult operations of the program returned by ParseProgram whose operands
+// and result fit in 64 bits whenever both operands are numbers, so they are computed without the
+// overflow check. Bounds of local variables are tracked through assignments, for-range loops and the
+// conditions of if and while statements; fields and method parameters are unbounded. Run it
+// after FoldConstants, which may replace the nodes
+Stats ElideOverflowChecks(runtime::Executable& program);
+
+// Writes how many operations were proven not to overflow
+void WriteStats(const Stats& stats, std::ostream& os);
+
+}  // namespace range
@@ -0,0 +1,127 @@
+#include "range.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+using namespace std;
+
+namespace range {
+
+namespace {
+
+// Analyzes the program passed to RunProgram and stores the counts of operations in stats
+auto Analyze(Stats& stats) {
+    return [&stats](runtime::Executable& program) {
+        stats = ElideOverflowChecks(program);
+    };
+}
+
+void TestLoopCountersAreBounded() {
+    const string source = R"(
+total = 0
+for i in range(1000):
+  total = total + i * i - 1
+print total
+)"s;
+    Stats stats;
+    const string analyzed = RunProgram(source, Analyze(stats));
+    ASSERT_EQUAL(analyzed, "332832500\n"s);
+    ASSERT_EQUAL(analyzed, RunProgram(source));
+    // i * i, but not the sum that keeps growing with the iterations
+    ASSERT_EQUAL(stats.operations, 3u);
+    ASSERT_EQUAL(stats.overflow_free, 1u);
+}
+
+void TestConditionsBoundBranches() {
+    const string source = R"(
+class Square:
+  def of(n):
+    if n > -1000000 and n < 1000000:
+      return n * n
+    if not n >= 3000000000:
+      if n >= 0:
+        return n * n + 1
+    return n * n
+
+s = Square()
+print s.of(-5), s.of(2000000), s.of(4000000000)
+)"s;
+    Stats stats;
+    const string analyzed = RunProgram(source, Analyze(stats));
+    ASSERT_EQUAL(analyzed, "25 4000000000001 16000000000000000000\n"s);
+    ASSERT_EQUAL(analyzed, RunProgram(source));
+    // The parameter is bounded only in the guarded branches. It may be an instance with __mul__,
+    // so the product of it is not bounded. Negative constants are products with -1 until they
+    // are folded
+    ASSERT_EQUAL(stats.operations, 6u);
+    ASSERT_EQUAL(stats.overflow_free, 4u);
+}
+
+void TestWhileLoopsAreWidened() {
+    const string source = R"(
+i = 0
+x = 1
+while i < 100:
+  i = i + 1
+  x = x * 2
+print i, x
+)"s;
+    Stats stats;
+    const string analyzed = RunProgram(source, Analyze(stats));
+    ASSERT_EQUAL(analyzed, "100 1267650600228229401496703205376\n"s);
+    ASSERT_EQUAL(analyzed, RunProgram(source));
+    // The condition bounds the counter, nothing bounds the doubled value
+    ASSERT_EQUAL(stats.operations, 2u);
+    ASSERT_EQUAL(stats.overflow_free, 1u);
+}
+
+void TestValuesOfUnknownTypeAreNotBounded() {
+    const string source = R"(
+class Counter:
+  def __init__():
+    self.value = 9223372036854775807
+
+c = Counter()
+s = "a"
+if s < "b":
+  s = s + "b"
+print c.value + 1, s + "c"
+)"s;
+    Stats stats;
+    const string analyzed = RunProgram(source, Analyze(stats));
+    ASSERT_EQUAL(analyzed, "9223372036854775808 abc\n"s);
+    ASSERT_EQUAL(analyzed, RunProgram(source));
+    ASSERT_EQUAL(stats.operations, 3u);
+    ASSERT_EQUAL(stats.overflow_free, 0u);
+}
+
+void TestProductsOfUnboundedValuesAreChecked() {
+    const string source = R"(
+class Zero:
+  def times(n):
+    return n * 0
+
+z = Zero()
+x = 9223372036854775807 * 4
+print z.times(100000000000000000000), z.times(3), 0 * x
+)"s;
+    Stats stats;
+    const string analyzed = RunProgram(source, Analyze(stats));
+    ASSERT_EQUAL(analyzed, "0 0 0\n"s);
+    ASSERT_EQUAL(analyzed, RunProgram(source));
+    // The products are 0, but the unbounded operands may not fit in 64 bits
+    ASSERT_EQUAL(stats.operations, 3u);
+    ASSERT_EQUAL(stats.overflow_free, 0u);
+}
+
+}  // namespace
+
+void RunRangeTests(TestRunner& tr) {
+    RUN_TEST(tr, range::TestLoopCountersAreBounded);
+    RUN_TEST(tr, range::TestConditionsBoundBranches);
+    RUN_TEST(tr, range::TestWhileLoopsAreWidened);
+    RUN_TEST(tr, range::TestValuesOfUnknownTypeAreNotBounded);
+    RUN_TEST(tr, range::TestProductsOfUnboundedValuesAreChecked);
+}
+
+}  // namespace range
@@ -1,7 +1,18 @@
 #include "runtime.h"
 
+#include "jit.h"
+#include "memo.h"
+#include "metrics.h"
+#include "perfmap.h"
+#include "sampler.h"
+#include "tracer.h"
+
 #include <cassert>
+#include <charconv>
 #include <sstream>
+#include <utility>
+
+#include <pthread.h>
 
 using namespace std;
 
@@ -15,9 +26,37 @@ void ObjectHolder::AssertIsValid() const {
     assert(data_ != nullptr);
 }
 
+namespace {
+
+// Deleter невладеющего shared_ptr, созданного ObjectHolder::Share
+struct NonOwningDeleter {
+    void operator()(Object* /*p*/) const {
+        /* do nothing */
+    }
+};
+
+}  // namespace
+
 ObjectHolder ObjectHolder::Share(Object& object) {
+    opcount::Count(opcount::Op::Allocation);
     // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
+    return ObjectHolder(std::shared_ptr<Object>(&object, NonOwningDeleter{}));
+}
+
+bool ObjectHolder::IsExclusive(long other_references) const {
+    return data_ && data_.use_count() == other_references + 1
+           && std::get_deleter<NonOwningDeleter>(data_) == nullptr;
+}
+
+ObjectHolder ObjectHolder::OwnCounted(std::unique_ptr<Object> object, size_t object_size) {
+    census::HeapCensus::Active()->Allocate(*object, object_size);
+    return ObjectHolder(std::shared_ptr<Object>(object.release(), [](Object* p) {
+        if (census::HeapCensus* census = census::HeapCensus::Active())
+        {
+            census->Free(*p);
+        }
+        delete p;
+    }));
 }
 
 ObjectHolder ObjectHolder::None() {
@@ -47,9 +86,9 @@ bool IsTrue(const ObjectHolder& object) {
     {
         return object.TryAs<ValueObject<bool>>()->GetValue();
     }
-    if (object.TryAs<ValueObject<int>>())
+    if (object.TryAs<Number>())
     {
-        return object.TryAs<ValueObject<int>>()->GetValue() != 0;
+        return !object.TryAs<Number>()->GetValue().IsZero();
     }
     if (object.TryAs<ValueObject<string>>())
     {
@@ -58,13 +97,43 @@ bool IsTrue(const ObjectHolder& object) {
     return false;
 }
 
+std::optional<std::string_view> FormatScalar(const ObjectHolder& object, FormatBuffer& buffer) {
+    switch (object.GetKind())
+    {
+    case ObjectKind::None:
+        return "None"sv;
+    case ObjectKind::Number:
+    {
+        const bigint::Integer& value = ValueOf<bigint::Integer>(object);
+        if (!value.IsSmall())
+        {
+            return nullopt;
+        }
+        const auto result = to_chars(buffer.data(), buffer.data() + buffer.size(), value.GetSmall());
+        return string_view(buffer.data(), static_cast<size_t>(result.ptr - buffer.data()));
+    }
+    case ObjectKind::String:
+        return string_view(ValueOf<string>(object));
+    case ObjectKind::Bool:
+        return ValueOf<bool>(object) ? "True"sv : "False"sv;
+    default:
+        return nullopt;
+    }
+}
+
 
 
 namespace special_methods
 {
     const string kStr = "__str__"s;
-    const string kEqual = "__eq__"s;
-    const string kLess = "__lt__"s; 
+    // Методы сравнения в порядке CompareOp
+    const array<string, COMPARE_OP_COUNT> kComparisons = {
+        "__eq__"s, "__ne__"s, "__lt__"s, "__gt__"s, "__le__"s, "__ge__"s,
+    };
+    // Арифметические методы в порядке ArithmeticOp
+    const array<string, ARITHMETIC_OP_COUNT> kArithmetics = {
+        "__add__"s, "__sub__"s, "__mul__"s, "__truediv__"s,
+    };
 }
 
 void ClassInstance::Print(std::ostream& os, Context& context) {
@@ -98,7 +167,7 @@ const Closure& ClassInstance::Fields() const {
 }
 
 ClassInstance::ClassInstance(const Class& cls) 
-    :linked_class_(cls) {}
+    :Object(ObjectKind::ClassInstance), linked_class_(cls) {}
 
 ObjectHolder ClassInstance::Call(const std::string& method,
                                  const std::vector<ObjectHolder>& actual_args,
@@ -109,27 +178,212 @@ ObjectHolder ClassInstance::Call(const std::string& method,
     {
         throw std::runtime_error("Not implemented"s);
     }
-    else if (class_method->formal_params.size() != actual_args.size())
+    return Call(*class_method, actual_args, context);
+}
+
+namespace {
+
+// Даёт return выполняемого метода место для хвостового вызова и восстанавливает место
+// вызывающего метода при выходе, в том числе по исключению
+class TailCallScope {
+public:
+    TailCallScope(Context& context, TailCall& tail_call)
+        :context_(context), outer_(context.GetTailCall()) {
+        context_.SetTailCall(&tail_call);
+    }
+
+    ~TailCallScope() {
+        context_.SetTailCall(outer_);
+    }
+
+    TailCallScope(const TailCallScope&) = delete;
+    TailCallScope& operator=(const TailCallScope&) = delete;
+
+private:
+    Context& context_;
+    TailCall* outer_;
+};
+
+// Место на стеке потока, которое остаётся для вызовов Mython
+class NativeStack {
+public:
+    // Вызов метода не начинается, если на стеке осталось меньше RESERVE байт: этого хватает,
+    // чтобы выполнить тело метода до следующего вызова и выбросить исключение
+    static constexpr size_t RESERVE = 256u * 1024u;
+
+    NativeStack() {
+        pthread_attr_t attributes;
+        if (pthread_getattr_np(pthread_self(), &attributes) != 0)
+        {
+            return;
+        }
+        void* address = nullptr;
+        size_t size = 0u;
+        if (pthread_attr_getstack(&attributes, &address, &size) == 0)
+        {
+            limit_ = static_cast<const char*>(address) + min(size, RESERVE);
+        }
+        pthread_attr_destroy(&attributes);
+    }
+
+    // Стек растёт вниз, к адресу, возвращённому pthread_attr_getstack
+    [[nodiscard]] bool Exhausted() const {
+        return static_cast<const char*>(__builtin_frame_address(0)) < limit_;
+    }
+
+private:
+    const char* limit_ = nullptr;
+};
+
+// Учитывает вложенный вызов метода в глубине вызовов контекста
+class CallDepthScope {
+public:
+    explicit CallDepthScope(Context& context)
+        :context_(context) {
+        static thread_local const NativeStack stack;
+        if (context_.GetCallDepth() >= context_.GetRecursionLimit() || stack.Exhausted())
+        {
+            throw std::runtime_error("Recursion limit exceeded"s);
+        }
+        context_.SetCallDepth(context_.GetCallDepth() + 1u);
+    }
+
+    ~CallDepthScope() {
+        context_.SetCallDepth(context_.GetCallDepth() - 1u);
+    }
+
+    CallDepthScope(const CallDepthScope&) = delete;
+    CallDepthScope& operator=(const CallDepthScope&) = delete;
+
+private:
+    Context& context_;
+};
+
+}  // namespace
+
+ObjectHolder ClassInstance::Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
+                                 Context& context)
+{
+    memo::MethodCache* cache = context.GetMethodCache();
+    const bool memoized = cache != nullptr && cache->IsPure(method);
+    if (memoized)
+    {
+        if (optional<ObjectHolder> cached = cache->Find(linked_class_, method, actual_args))
+        {
+            return *move(cached);
+        }
+    }
+
+    TailCall tail_call;
+    TailCallScope scope(context, tail_call);
+    ObjectHolder result = Invoke(method, actual_args, context);
+
+    // Объекты, методы которых вызывались, живут до конца цепочки: self и аргументы могут
+    // ссылаться на них через невладеющие ObjectHolder. Этот объект жив и так
+    vector<ObjectHolder> instances;
+    while (context.GetCompletion() == Completion::TailCall)
+    {
+        context.SetCompletion(Completion::Normal);
+        TailCall call = exchange(tail_call, {});
+        auto* instance = call.instance.TryAs<ClassInstance>();
+        if (instance == nullptr)
+        {
+            throw std::runtime_error("Not implemented"s);
+        }
+        if (instance != this && (instances.empty() || instances.back().Get() != instance))
+        {
+            instances.push_back(move(call.instance));
+        }
+        const Method* class_method = instance->linked_class_.GetMethod(*call.method);
+        if (class_method == nullptr)
+        {
+            throw std::runtime_error("Not implemented"s);
+        }
+        // Результат хвостового вызова - результат всей цепочки
+        if (cache != nullptr && cache->IsPure(*class_method))
+        {
+            if (optional<ObjectHolder> cached = cache->Find(instance->linked_class_, *class_method,
+                                                            call.args))
+            {
+                result = *move(cached);
+                break;
+            }
+        }
+        result = instance->Invoke(*class_method, call.args, context);
+    }
+    if (memoized)
+    {
+        cache->Store(linked_class_, method, actual_args, result);
+    }
+    return result;
+}
+
+ObjectHolder ClassInstance::Invoke(const Method& method, const std::vector<ObjectHolder>& actual_args,
+                                   Context& context)
+{
+    const Method* class_method = &method;
+    if (class_method->formal_params.size() != actual_args.size())
     {
         throw std::runtime_error("Not implemented"s);
     }
+    CallDepthScope depth(context);
+    trace::CallScope trace_scope(linked_class_.GetName(), class_method->name, actual_args.size(),
+                                 trace::CallKind::Method);
+    sample::FrameScope sample_frame(linked_class_.GetName(), class_method->name);
+    if (metrics::Registry* metrics = context.GetMetrics())
+    {
+        metrics->Interpreter().method_calls.Add();
+    }
+    // Скомпилированный метод обходится без Closure: переменные лежат в ячейках его кадра
+    if (jit::Compiler* compiler = context.GetJit())
+    {
+        if (optional<ObjectHolder> result = compiler->Call(*class_method, *this, actual_args, context))
+        {
+            return *move(result);
+        }
+    }
 
     Closure closure;
     closure["self"] = ObjectHolder::Share(*this);
+    opcount::Count(opcount::Op::ClosureLookup, 1u + class_method->formal_params.size());
 
     for (size_t i = 0u; i < class_method->formal_params.size(); ++i)
     {
         closure[class_method->formal_params.at(i)] = actual_args.at(i);
     }
+    if (perfmap::PerfMap* perf_map = perfmap::PerfMap::Active())
+    {
+        return perf_map->Call(class_method, linked_class_.GetName(), class_method->name,
+                              class_method->body->GetPosition().line, [&] {
+            return class_method->body->Execute(closure, context);
+        });
+    }
     return class_method->body->Execute(closure, context);
 }
 
 Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
-    :name_(move(name)), methods_(move(methods)), parent_(parent) {}
+    :Object(ObjectKind::Class), name_(move(name)), methods_(move(methods)), parent_(parent)
+{
+    // Указатели на элементы methods_ остаются верными при перемещении класса
+    const auto find_binary = [this](const string& name) -> const Method* {
+        const Method* method = GetMethod(name);
+        return method != nullptr && method->formal_params.size() == 1u ? method : nullptr;
+    };
+    for (size_t op = 0u; op < COMPARE_OP_COUNT; ++op)
+    {
+        comparison_methods_[op] = find_binary(special_methods::kComparisons[op]);
+    }
+    for (size_t op = 0u; op < ARITHMETIC_OP_COUNT; ++op)
+    {
+        arithmetic_methods_[op] = find_binary(special_methods::kArithmetics[op]);
+    }
+}
 
 const Method* Class::GetMethod(const std::string& name) const {
+    opcount::Count(opcount::Op::MethodLookup);
     for (const auto& method: methods_)
     {
+        opcount::Count(opcount::Op::MethodScanStep);
         if (method.name == name)
         {
             return &method;
@@ -150,59 +404,129 @@ void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
     os << (GetValue() ? "True"sv : "False"sv);
 }
 
-bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-   
-    if (optional<bool> res = Comparer(lhs, rhs, equal_to<>{}); res.has_value())
+size_t String::GetHash() const {
+    if (!has_hash_)
     {
-        return res.value();
+        hash_ = std::hash<std::string>{}(GetValue());
+        has_hash_ = true;
     }
+    return hash_;
+}
 
+namespace {
 
-    if (!lhs && !rhs)
+template <typename T>
+bool Apply(CompareOp op, const T& lhs, const T& rhs) {
+    switch (op)
+    {
+    case CompareOp::Equal:
+        return lhs == rhs;
+    case CompareOp::NotEqual:
+        return lhs != rhs;
+    case CompareOp::Less:
+        return lhs < rhs;
+    case CompareOp::Greater:
+        return lhs > rhs;
+    case CompareOp::LessOrEqual:
+        return lhs <= rhs;
+    case CompareOp::GreaterOrEqual:
+        return lhs >= rhs;
+    }
+    return false;
+}
+
+// Объект равен самому себе, строки с разными хешами различаются без сравнения
+// их символов
+bool EqualStrings(const String& lhs, const String& rhs) {
+    if (&lhs == &rhs)
     {
         return true;
     }
-    if (lhs.TryAs<ClassInstance>())
+    if (lhs.HasHash() && rhs.HasHash() && lhs.GetHash() != rhs.GetHash())
     {
-        if (lhs.TryAs<ClassInstance>()->HasMethod(special_methods::kEqual, 1u))
-        {
-            return IsTrue(lhs.TryAs<ClassInstance>()->Call(special_methods::kEqual, { rhs }, context));
-        }
+        return false;
     }
-    throw std::runtime_error("Cannot compare objects for equality"s);
+    return lhs.GetValue() == rhs.GetValue();
 }
 
-bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+}  // namespace
 
-    if (optional<bool> res = Comparer(lhs, rhs, less<>{}))
+bool Compare(CompareOp op, const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    const ObjectKind kind = lhs.GetKind();
+    if (kind == rhs.GetKind())
     {
-        return res.value();
+        switch (kind)
+        {
+        case ObjectKind::Number:
+            return Apply(op, ValueOf<bigint::Integer>(lhs), ValueOf<bigint::Integer>(rhs));
+        case ObjectKind::String:
+            if (op == CompareOp::Equal || op == CompareOp::NotEqual)
+            {
+                const bool equal = EqualStrings(static_cast<const String&>(*lhs), static_cast<const String&>(*rhs));
+                return equal == (op == CompareOp::Equal);
+            }
+            return Apply(op, ValueOf<string>(lhs), ValueOf<string>(rhs));
+        case ObjectKind::Bool:
+            return Apply(op, ValueOf<bool>(lhs), ValueOf<bool>(rhs));
+        case ObjectKind::None:
+            if (op == CompareOp::Equal || op == CompareOp::NotEqual)
+            {
+                return op == CompareOp::Equal;
+            }
+            break;
+        default:
+            break;
+        }
     }
-
-    if (lhs.TryAs<ClassInstance>()) 
+    if (kind == ObjectKind::ClassInstance)
     {
-        if (lhs.TryAs<ClassInstance>()->HasMethod(special_methods::kLess, 1U)) 
+        auto& instance = static_cast<ClassInstance&>(*lhs);
+        if (const Method* method = instance.GetClass().GetComparisonMethod(op))
         {
-            return IsTrue(lhs.TryAs<ClassInstance>()->Call(special_methods::kLess, { rhs }, context));
+            return IsTrue(instance.Call(*method, { rhs }, context));
         }
     }
-    throw std::runtime_error("diffrent tipes"s);
+
+    switch (op)
+    {
+    case CompareOp::Equal:
+        throw std::runtime_error("Cannot compare objects for equality"s);
+    case CompareOp::Less:
+        throw std::runtime_error("Cannot compare objects for less"s);
+    case CompareOp::NotEqual:
+        return !Compare(CompareOp::Equal, lhs, rhs, context);
+    case CompareOp::Greater:
+        return !Compare(CompareOp::Less, lhs, rhs, context) && Compare(CompareOp::NotEqual, lhs, rhs, context);
+    case CompareOp::LessOrEqual:
+        return Compare(CompareOp::Less, lhs, rhs, context) || Compare(CompareOp::Equal, lhs, rhs, context);
+    case CompareOp::GreaterOrEqual:
+        return !Compare(CompareOp::Less, lhs, rhs, context);
+    }
+    return false;
+}
+
+bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    return Compare(CompareOp::Equal, lhs, rhs, context);
+}
+
+bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    return Compare(CompareOp::Less, lhs, rhs, context);
 }
 
 bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return !Equal(lhs, rhs, context);
+    return Compare(CompareOp::NotEqual, lhs, rhs, context);
 }
 
 bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return !Less(lhs, rhs, context) && NotEqual(lhs, rhs, context);
+    return Compare(CompareOp::Greater, lhs, rhs, context);
 }
 
 bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return (Less(lhs, rhs, context) || Equal(lhs, rhs, context));
+    return Compare(CompareOp::LessOrEqual, lhs, rhs, context);
 }
 
 bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
-    return (!Less(lhs, rhs, context));
+    return Compare(CompareOp::GreaterOrEqual, lhs, rhs, context);
 }
 
 }  // namespace runtime
\ No newline at end of file
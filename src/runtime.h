@@ -1,30 +1,171 @@
 #pragma once
 
+#include "bigint.h"
+#include "census.h"
+#include "opcount.h"
+
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 #include <optional>
 
+namespace metrics {
+class Registry;
+}  // namespace metrics
+
+namespace memo {
+class MethodCache;
+}  // namespace memo
+
+namespace jit {
+class Compiler;
+}  // namespace jit
+
 namespace runtime {
 
+struct TailCall;
+
+// Способ, которым завершилось выполнение инструкции
+enum class Completion {
+    // Выполнение продолжается со следующей инструкции
+    Normal,
+    // Выполнена инструкция return: оставшиеся инструкции метода не выполняются
+    Return,
+    // Выполнена инструкция return, возвращающая результат вызова метода. Вызов записан
+    // в Context::GetTailCall() и выполняется в ClassInstance::Call текущего метода
+    TailCall,
+};
+
 // Контекст исполнения инструкций Mython
 class Context {
 public:
     // Возвращает поток вывода для команд print
     virtual std::ostream& GetOutputStream() = 0;
 
+    // Выводит text в поток вывода. Команда print выводит числа, строки и разделители через
+    // Write, поэтому контекст может переопределить его, чтобы обойтись без потоков iostream
+    virtual void Write(std::string_view text) {
+        GetOutputStream().write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    // Возвращает реестр метрик, которые обновляет интерпретатор, или nullptr, если метрики не собираются
+    [[nodiscard]] metrics::Registry* GetMetrics() const {
+        return metrics_;
+    }
+
+    void SetMetrics(metrics::Registry* metrics) {
+        metrics_ = metrics;
+    }
+
+    // Возвращает способ завершения последней выполненной инструкции. Return выставляется
+    // инструкцией return и сбрасывается телом метода, когда метод возвращает значение
+    [[nodiscard]] Completion GetCompletion() const {
+        return completion_;
+    }
+
+    void SetCompletion(Completion completion) {
+        completion_ = completion;
+    }
+
+    // Возвращает кэш результатов чистых методов или nullptr, если результаты не запоминаются
+    [[nodiscard]] memo::MethodCache* GetMethodCache() const {
+        return method_cache_;
+    }
+
+    void SetMethodCache(memo::MethodCache* method_cache) {
+        method_cache_ = method_cache;
+    }
+
+    // Возвращает компилятор горячих методов в машинный код или nullptr, если все методы
+    // выполняет интерпретатор. Компилятор можно заменить или убрать в любой момент
+    [[nodiscard]] jit::Compiler* GetJit() const {
+        return jit_;
+    }
+
+    void SetJit(jit::Compiler* jit) {
+        jit_ = jit;
+    }
+
+    // Наибольшая глубина вложенных вызовов методов. Хвостовые вызовы глубину не увеличивают
+    static constexpr size_t DEFAULT_RECURSION_LIMIT = 10'000u;
+
+    [[nodiscard]] size_t GetRecursionLimit() const {
+        return recursion_limit_;
+    }
+
+    void SetRecursionLimit(size_t limit) {
+        recursion_limit_ = limit;
+    }
+
+    // Возвращает число выполняемых сейчас вложенных вызовов методов
+    [[nodiscard]] size_t GetCallDepth() const {
+        return call_depth_;
+    }
+
+    void SetCallDepth(size_t depth) {
+        call_depth_ = depth;
+    }
+
+    // Возвращает место для хвостового вызова выполняемого метода или nullptr вне методов
+    [[nodiscard]] TailCall* GetTailCall() const {
+        return tail_call_;
+    }
+
+    void SetTailCall(TailCall* tail_call) {
+        tail_call_ = tail_call;
+    }
+
 protected:
     ~Context() = default;
+
+private:
+    metrics::Registry* metrics_ = nullptr;
+    memo::MethodCache* method_cache_ = nullptr;
+    jit::Compiler* jit_ = nullptr;
+    Completion completion_ = Completion::Normal;
+    TailCall* tail_call_ = nullptr;
+    size_t recursion_limit_ = DEFAULT_RECURSION_LIMIT;
+    size_t call_depth_ = 0u;
+};
+
+// Вид объекта. Позволяет выбрать реализацию операции одной проверкой вместо dynamic_cast
+enum class ObjectKind : uint8_t {
+    // Пустой ObjectHolder
+    None,
+    Number,
+    String,
+    Bool,
+    Class,
+    ClassInstance,
+    // Объекты других классов
+    Other,
 };
 
 // Базовый класс для всех объектов языка Mython
 class Object {
 public:
+    Object() = default;
     virtual ~Object() = default;
     // выводит в os своё представление в виде строки
     virtual void Print(std::ostream& os, Context& context) = 0;
+
+    [[nodiscard]] ObjectKind GetKind() const {
+        return kind_;
+    }
+
+protected:
+    explicit Object(ObjectKind kind)
+        : kind_(kind) {
+    }
+
+private:
+    ObjectKind kind_ = ObjectKind::Other;
 };
 
 // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
@@ -33,11 +174,56 @@ public:
     // Создаёт пустое значение
     ObjectHolder() = default;
 
+    // Копирование и освобождение учитываются в opcount как операции со счётчиком ссылок
+    ObjectHolder(const ObjectHolder& other)
+        : data_(other.data_) {
+        if (data_)
+        {
+            opcount::Count(opcount::Op::RefcountIncrement);
+        }
+    }
+
+    ObjectHolder(ObjectHolder&& other) noexcept = default;
+
+    ObjectHolder& operator=(const ObjectHolder& other) {
+        if (other.data_)
+        {
+            opcount::Count(opcount::Op::RefcountIncrement);
+        }
+        if (data_)
+        {
+            opcount::Count(opcount::Op::RefcountDecrement);
+        }
+        data_ = other.data_;
+        return *this;
+    }
+
+    ObjectHolder& operator=(ObjectHolder&& other) noexcept {
+        if (data_)
+        {
+            opcount::Count(opcount::Op::RefcountDecrement);
+        }
+        data_ = std::move(other.data_);
+        return *this;
+    }
+
+    ~ObjectHolder() {
+        if (data_)
+        {
+            opcount::Count(opcount::Op::RefcountDecrement);
+        }
+    }
+
     // Возвращает ObjectHolder, владеющий объектом типа T
     // Тип T - конкретный класс-наследник Object.
     // object копируется или перемещается в кучу
     template <typename T>
     [[nodiscard]] static ObjectHolder Own(T&& object) {
+        opcount::Count(opcount::Op::Allocation);
+        if (census::HeapCensus::Active() != nullptr)
+        {
+            return OwnCounted(std::make_unique<T>(std::forward<T>(object)), sizeof(T));
+        }
         return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
     }
 
@@ -58,14 +244,26 @@ public:
     // объект данного типа
     template <typename T>
     [[nodiscard]] T* TryAs() const {
+        opcount::Count(opcount::Op::TryAs);
         return dynamic_cast<T*>(this->Get());
     }
 
     // Возвращает true, если ObjectHolder не пуст
     explicit operator bool() const;
 
+    // Возвращает вид хранимого объекта, ObjectKind::None для пустого ObjectHolder
+    [[nodiscard]] ObjectKind GetKind() const {
+        return data_ ? data_->GetKind() : ObjectKind::None;
+    }
+
+    // Возвращает true, если ObjectHolder владеет объектом и, кроме него, на объект ссылаются
+    // не более other_references других ObjectHolder
+    [[nodiscard]] bool IsExclusive(long other_references = 0) const;
+
 private:
     explicit ObjectHolder(std::shared_ptr<Object> data);
+    // Владеющий ObjectHolder, объект которого учитывается активной census::HeapCensus
+    static ObjectHolder OwnCounted(std::unique_ptr<Object> object, size_t object_size);
     void AssertIsValid() const;
 
     std::shared_ptr<Object> data_;
@@ -76,7 +274,7 @@ template <typename T>
 class ValueObject : public Object {
 public:
     ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-        : value_(v) {
+        : Object(KindOf()), value_(std::move(v)) {
     }
 
     void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
@@ -87,10 +285,40 @@ public:
         return value_;
     }
 
+protected:
+    T& MutableValue() {
+        return value_;
+    }
+
 private:
+    static constexpr ObjectKind KindOf() {
+        if constexpr (std::is_same_v<T, bigint::Integer>)
+        {
+            return ObjectKind::Number;
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            return ObjectKind::String;
+        }
+        else if constexpr (std::is_same_v<T, bool>)
+        {
+            return ObjectKind::Bool;
+        }
+        else
+        {
+            return ObjectKind::Other;
+        }
+    }
+
     T value_;
 };
 
+// Возвращает значение объекта ValueObject<T>, вид которого уже проверен через GetKind()
+template <typename T>
+[[nodiscard]] const T& ValueOf(const ObjectHolder& object) {
+    return static_cast<const ValueObject<T>&>(*object).GetValue();
+}
+
 // Таблица символов, связывающая имя объекта с его значением
 using Closure = std::unordered_map<std::string, ObjectHolder>;
 
@@ -98,6 +326,21 @@ using Closure = std::unordered_map<std::string, ObjectHolder>;
 // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
 bool IsTrue(const ObjectHolder& object);
 
+// Буфер для FormatScalar, вмещающий запись любого 64-битного числа
+using FormatBuffer = std::array<char, 24>;
+
+// Возвращает текст, которым print и str() выводят число, строку, логическое значение или None,
+// без потоков вывода и выделения памяти. Запись числа размещается в buffer.
+// Для остальных объектов и чисел, не умещающихся в 64 бита, возвращает nullopt,
+// их выводит Object::Print
+std::optional<std::string_view> FormatScalar(const ObjectHolder& object, FormatBuffer& buffer);
+
+// Позиция инструкции в исходном тексте программы. Нулевая строка означает, что позиция неизвестна
+struct SourcePosition {
+    size_t line = 0u;
+    size_t column = 0u;
+};
+
 // Интерфейс для выполнения действий над объектами Mython
 class Executable {
 public:
@@ -105,12 +348,46 @@ public:
     // Выполняет действие над объектами внутри closure, используя context
     // Возвращает результирующее значение либо None
     virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
+
+    // Позиция, с которой инструкция начинается в исходном тексте
+    [[nodiscard]] const SourcePosition& GetPosition() const {
+        return position_;
+    }
+
+    void SetPosition(SourcePosition position) {
+        position_ = position;
+    }
+
+private:
+    SourcePosition position_;
 };
 
-// Строковое значение
-using String = ValueObject<std::string>;
-// Числовое значение
-using Number = ValueObject<int>;
+// Строковое значение. Строки разделяются между переменными через ObjectHolder без копирования,
+// хеш строки вычисляется при первом обращении и запоминается
+class String : public ValueObject<std::string> {
+public:
+    using ValueObject<std::string>::ValueObject;
+
+    [[nodiscard]] size_t GetHash() const;
+
+    // Возвращает true, если хеш уже вычислен
+    [[nodiscard]] bool HasHash() const {
+        return has_hash_;
+    }
+
+    // Дописывает tail в конец строки. Вызывается только для строки, на которую кроме
+    // вызывающего никто не ссылается (см. ObjectHolder::IsExclusive), иначе изменение заметят
+    void Append(std::string_view tail) {
+        MutableValue().append(tail);
+        has_hash_ = false;
+    }
+
+private:
+    mutable size_t hash_ = 0u;
+    mutable bool has_hash_ = false;
+};
+// Целое число любой величины
+using Number = ValueObject<bigint::Integer>;
 
 // Логическое значение
 class Bool : public ValueObject<bool> {
@@ -120,6 +397,28 @@ public:
     void Print(std::ostream& os, Context& context) override;
 };
 
+// Операция сравнения
+enum class CompareOp {
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    LessOrEqual,
+    GreaterOrEqual,
+};
+
+inline constexpr size_t COMPARE_OP_COUNT = 6u;
+
+// Арифметическая операция, которую пользовательский класс может определить методом
+enum class ArithmeticOp {
+    Add,
+    Sub,
+    Mult,
+    Div,
+};
+
+inline constexpr size_t ARITHMETIC_OP_COUNT = 4u;
+
 // Метод класса
 struct Method {
     // Имя метода
@@ -130,6 +429,15 @@ struct Method {
     std::unique_ptr<Executable> body;
 };
 
+// Вызов метода, которым завершается метод. Вызывающий метод завершается до вызова, поэтому
+// цепочка хвостовых вызовов не увеличивает глубину стека
+struct TailCall {
+    ObjectHolder instance;
+    // Имя метода принадлежит узлу AST, выполнившему return
+    const std::string* method = nullptr;
+    std::vector<ObjectHolder> args;
+};
+
 // Класс
 class Class : public Object {
 public:
@@ -146,6 +454,24 @@ public:
         return name_;
     }
 
+    // Возвращает собственные методы класса, без методов родителя
+    [[nodiscard]] const std::vector<Method>& GetMethods() const {
+        return methods_;
+    }
+
+    // Возвращает метод сравнения (__eq__, __ne__, __lt__, __gt__, __le__ или __ge__) с одним
+    // параметром, найденный в классе или его родителях, либо nullptr.
+    // Методы сравнения ищутся один раз, при создании класса
+    [[nodiscard]] const Method* GetComparisonMethod(CompareOp op) const {
+        return comparison_methods_[static_cast<size_t>(op)];
+    }
+
+    // Возвращает метод __add__, __sub__, __mul__ или __truediv__ с одним параметром, найденный
+    // в классе или его родителях, либо nullptr. Как и методы сравнения, ищется при создании класса
+    [[nodiscard]] const Method* GetArithmeticMethod(ArithmeticOp op) const {
+        return arithmetic_methods_[static_cast<size_t>(op)];
+    }
+
     // Выводит в os строку "Class <имя класса>", например "Class cat"
     void Print(std::ostream& os, Context& context) override;
 
@@ -153,6 +479,8 @@ private:
     std::string name_;
     std::vector<Method> methods_;
     const Class* parent_;
+    std::array<const Method*, COMPARE_OP_COUNT> comparison_methods_{};
+    std::array<const Method*, ARITHMETIC_OP_COUNT> arithmetic_methods_{};
 };
 
 // Экземпляр класса
@@ -174,6 +502,17 @@ public:
      */
     ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
                       Context& context);
+    // Вызывает у объекта метод method его класса, найденный заранее
+    // Хвостовые вызовы, которыми завершается метод, выполняются здесь же друг за другом.
+    // Если вызов превышает context.GetRecursionLimit() или на стеке потока не осталось места
+    // для него, выбрасывает исключение runtime_error
+    ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
+                      Context& context);
+
+    // Возвращает класс объекта
+    [[nodiscard]] const Class& GetClass() const {
+        return linked_class_;
+    }
 
     // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
     [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
@@ -184,30 +523,14 @@ public:
     [[nodiscard]] const Closure& Fields() const;
 
 private:
+    // Выполняет тело метода. Хвостовой вызов, которым завершился метод, остаётся в контексте
+    ObjectHolder Invoke(const Method& method, const std::vector<ObjectHolder>& actual_args,
+                        Context& context);
+
     const Class& linked_class_;
     Closure closure_;
 };
 
-template <typename Type>
-ObjectHolder EqualObjectHolders(const ObjectHolder& lhs, const ObjectHolder& rhs) 
-{
-    if (lhs.TryAs<ValueObject<Type>>() && rhs.TryAs<ValueObject<Type>>()) 
-    {
-        return ObjectHolder::Own(runtime::Bool{ lhs.TryAs<ValueObject<Type>>()->GetValue() == rhs.TryAs<ValueObject<Type>>()->GetValue() });
-    }
-    return {};
-}
-
-template <typename Type>
-ObjectHolder LessObjectHolders(const ObjectHolder& lhs, const ObjectHolder& rhs) 
-{
-    if (lhs.TryAs<ValueObject<Type>>() && rhs.TryAs<ValueObject<Type>>()) 
-    {
-        return ObjectHolder::Own(runtime::Bool{ lhs.TryAs<ValueObject<Type>>()->GetValue() < rhs.TryAs<ValueObject<Type>>()->GetValue() });
-    }
-    return {};
-}
-
 /*
  * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
  * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
@@ -227,42 +550,21 @@ bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
  * Параметр context задаёт контекст для выполнения метода __lt__
  */
 bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение, противоположное Equal(lhs, rhs, context)
+// Возвращает значение, противоположное Equal(lhs, rhs, context), либо lhs.__ne__(rhs)
 bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение lhs>rhs, используя функции Equal и Less
+// Возвращает значение lhs>rhs, используя lhs.__gt__(rhs) либо функции Equal и Less
 bool Greater(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение lhs<=rhs, используя функции Equal и Less
+// Возвращает значение lhs<=rhs, используя lhs.__le__(rhs) либо функции Equal и Less
 bool LessOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
-// Возвращает значение, противоположное Less(lhs, rhs, context)
+// Возвращает значение, противоположное Less(lhs, rhs, context), либо lhs.__ge__(rhs)
 bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 
-// Compares String, Number, Bool types
-template <typename Predicate>
-std::optional<bool> Comparer(const ObjectHolder& lhs, const ObjectHolder& rhs, Predicate pred)
-{ 
-    if (auto lhs_ptr = lhs.TryAs<String>())
-    {
-        if (auto rhs_ptr = rhs.TryAs<String>())
-        {
-            return pred(lhs_ptr->GetValue(), rhs_ptr->GetValue());
-        }
-    }
-    if (auto lhs_ptr = lhs.TryAs<Number>())
-    {
-        if (auto rhs_ptr = rhs.TryAs<Number>())
-        {
-            return pred(lhs_ptr->GetValue(), rhs_ptr->GetValue());
-        }
-    }
-    if (auto lhs_ptr = lhs.TryAs<Bool>())
-    {
-        if (auto rhs_ptr = rhs.TryAs<Bool>())
-        {
-            return pred(lhs_ptr->GetValue(), rhs_ptr->GetValue());
-        }
-    }
-    return std::nullopt;
-}
+/*
+ * Сравнивает lhs и rhs операцией op. Числа, строки и значения Bool одного типа сравниваются
+ * напрямую. Если у lhs есть метод сравнения для op, вызывается только он. Иначе результат
+ * выражается через Equal и Less, как описано выше, а при их отсутствии выбрасывается runtime_error
+ */
+bool Compare(CompareOp op, const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 
 // Контекст-заглушка, применяется в тестах.
 // В этом контексте весь вывод перенаправляется в строковый поток вывода output
@@ -71,6 +71,28 @@ void TestString() {
     ASSERT_EQUAL(word.GetValue(), "hello!"s);
 }
 
+void TestStringHash() {
+    String word("hello"s);
+    ASSERT(!word.HasHash());
+    ASSERT_EQUAL(word.GetHash(), hash<string>{}("hello"s));
+    ASSERT(word.HasHash());
+
+    // Appending forgets the cached hash
+    word.Append(" world"sv);
+    ASSERT(!word.HasHash());
+    ASSERT_EQUAL(word.GetHash(), hash<string>{}("hello world"s));
+
+    DummyContext context;
+    ObjectHolder lhs = ObjectHolder::Own(String{"hello world"s});
+    ObjectHolder rhs = ObjectHolder::Share(word);
+    ASSERT(Equal(lhs, lhs, context));
+    ASSERT(Equal(lhs, rhs, context));
+    lhs = ObjectHolder::Own(String{"hello there"s});
+    ASSERT(lhs.TryAs<String>()->GetHash() != word.GetHash());
+    ASSERT(NotEqual(lhs, rhs, context));
+    ASSERT(Less(rhs, lhs, context) == ("hello world"s < "hello there"s));
+}
+
 void TestBool() {
     Bool t(true);
     ASSERT_EQUAL(t.GetValue(), true);
@@ -474,6 +496,39 @@ void TestComparison() {
     }
 }
 
+void TestRichComparisons() {
+    DummyContext context;
+    vector<string> calls;
+    vector<Method> methods;
+    for (const string& name : {"__ne__"s, "__gt__"s, "__le__"s, "__ge__"s})
+    {
+        methods.push_back({name, {"rhs"s}, make_unique<TestMethodBody>([&calls, name](Closure&, Context&) {
+            calls.push_back(name);
+            return ObjectHolder::Own(Bool{true});
+        })});
+    }
+    Class base{"Base"s, std::move(methods), nullptr};
+    Class cls{"Derived"s, {}, &base};
+    ASSERT(cls.GetComparisonMethod(CompareOp::Greater) == base.GetMethod("__gt__"s));
+    ASSERT(cls.GetComparisonMethod(CompareOp::Less) == nullptr);
+
+    ClassInstance lhs{cls};
+    ClassInstance rhs{cls};
+    // Every operation calls its own method once instead of combining __lt__ and __eq__
+    ASSERT(NotEqual(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), context));
+    ASSERT(Greater(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), context));
+    ASSERT(LessOrEqual(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), context));
+    ASSERT(GreaterOrEqual(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), context));
+    ASSERT_EQUAL(calls, (vector<string>{"__ne__"s, "__gt__"s, "__le__"s, "__ge__"s}));
+
+    ASSERT_THROWS(Less(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), context), runtime_error);
+    ASSERT_THROWS(Equal(ObjectHolder::Share(lhs), ObjectHolder::Share(rhs), context), runtime_error);
+
+    ASSERT(Compare(CompareOp::LessOrEqual, ObjectHolder::Own(String{"a"s}), ObjectHolder::Own(String{"a"s}),
+                   context));
+    ASSERT(!Compare(CompareOp::NotEqual, ObjectHolder::None(), ObjectHolder::None(), context));
+}
+
 void TestClass() {
     vector<Method> methods;
     Closure* passed_closure = nullptr;
@@ -534,10 +589,12 @@ void TestClassInstance() {
 void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestNumber);
     RUN_TEST(tr, runtime::TestString);
+    RUN_TEST(tr, runtime::TestStringHash);
     RUN_TEST(tr, runtime::TestBool);
     RUN_TEST(tr, runtime::TestMethodInvocation);
     RUN_TEST(tr, runtime::TestIsTrue);
     RUN_TEST(tr, runtime::TestComparison);
+    RUN_TEST(tr, runtime::TestRichComparisons);
     RUN_TEST(tr, runtime::TestClass);
     RUN_TEST(tr, runtime::TestClassInstance);
 }
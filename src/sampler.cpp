@@ -0,0 +1,162 @@
+#include "sampler.h"
+
+#include <cerrno>
+#include <csignal>
+#include <ostream>
+#include <stdexcept>
+
+#include <sys/time.h>
+
+using namespace std;
+
+namespace sample {
+
+namespace {
+
+const string MODULE_FRAME = "<module>"s;
+
+struct sigaction previous_action;
+
+}  // namespace
+
+// A snapshot of the shadow stack. Only pointers are copied in the signal handler,
+// names and lines are resolved in Drain
+struct Sampler::Sample {
+    static constexpr size_t kMaxFrames = 64u;
+
+    ShadowFrame frames[kMaxFrames];
+    size_t frame_count = 0u;
+    bool truncated = false;
+};
+
+Sampler::Sampler(SamplerOptions options)
+    :options_(options), samples_(make_unique<Sample[]>(options.buffer_capacity)) {}
+
+Sampler::~Sampler() {
+    Stop();
+}
+
+void Sampler::Start() {
+    if (active_ != nullptr)
+    {
+        throw runtime_error("Another sampler is already active"s);
+    }
+
+    // The program level code runs in the bottom frame
+    ShadowFrame& root = shadow_stack.frames[0];
+    root.class_name = nullptr;
+    root.method_name = &MODULE_FRAME;
+    root.node = nullptr;
+    shadow_stack.depth = 1u;
+    active_ = this;
+
+    struct sigaction action{};
+    action.sa_handler = &Sampler::HandleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previous_action);
+
+    const long interval_us = 1'000'000L / max(1, options_.frequency);
+    itimerval timer{};
+    timer.it_interval.tv_sec = interval_us / 1'000'000L;
+    timer.it_interval.tv_usec = interval_us % 1'000'000L;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void Sampler::Stop() {
+    if (active_ != this)
+    {
+        return;
+    }
+    itimerval timer{};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &previous_action, nullptr);
+
+    active_ = nullptr;
+    shadow_stack.depth = 0u;
+    Drain();
+}
+
+void Sampler::HandleSignal(int /*signal*/) {
+    const int saved_errno = errno;
+    if (Sampler* sampler = active_)
+    {
+        sampler->Record(shadow_stack);
+    }
+    errno = saved_errno;
+}
+
+void Sampler::Record(const ShadowStack& stack) {
+    const size_t head = head_.load(memory_order_relaxed);
+    if (head - tail_.load(memory_order_acquire) >= options_.buffer_capacity)
+    {
+        dropped_.fetch_add(1u, memory_order_relaxed);
+        return;
+    }
+
+    atomic_signal_fence(memory_order_acquire);
+    const size_t depth = stack.depth;
+    const size_t stored = min(depth, ShadowStack::kMaxDepth);
+    const size_t first = stored > Sample::kMaxFrames ? stored - Sample::kMaxFrames : 0u;
+
+    Sample& sample = samples_[head % options_.buffer_capacity];
+    sample.frame_count = stored - first;
+    sample.truncated = first > 0u || depth > stored;
+    for (size_t i = first; i < stored; ++i)
+    {
+        const ShadowFrame& frame = stack.frames[i];
+        ShadowFrame& copy = sample.frames[i - first];
+        copy.class_name = frame.class_name;
+        copy.method_name = frame.method_name;
+        copy.node = frame.node;
+    }
+    head_.store(head + 1u, memory_order_release);
+}
+
+void Sampler::Drain() {
+    size_t tail = tail_.load(memory_order_relaxed);
+    const size_t head = head_.load(memory_order_acquire);
+
+    string path;
+    for (; tail != head; ++tail)
+    {
+        const Sample& sample = samples_[tail % options_.buffer_capacity];
+        path.clear();
+        if (sample.truncated)
+        {
+            path += "<truncated>";
+        }
+        for (size_t i = 0u; i < sample.frame_count; ++i)
+        {
+            const ShadowFrame& frame = sample.frames[i];
+            if (!path.empty())
+            {
+                path += ';';
+            }
+            if (frame.class_name != nullptr)
+            {
+                path += *frame.class_name;
+                path += '.';
+            }
+            path += *frame.method_name;
+            if (frame.node != nullptr && frame.node->GetPosition().line != 0u)
+            {
+                path += ':';
+                path += to_string(frame.node->GetPosition().line);
+            }
+        }
+        ++folded_[path];
+        ++sample_count_;
+    }
+    tail_.store(tail, memory_order_release);
+}
+
+void Sampler::WriteFoldedStacks(ostream& os) const {
+    for (const auto& [stack, count] : folded_)
+    {
+        os << stack << ' ' << count << '\n';
+    }
+}
+
+}  // namespace sample
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace sample {
+
+// A Mython call frame as seen from the SIGPROF handler: the method and the AST node
+// it is executing now. The program level frame has no class name
+struct ShadowFrame {
+    const std::string* class_name = nullptr;
+    const std::string* method_name = nullptr;
+    const runtime::Executable* volatile node = nullptr;
+};
+
+// Stack of active ClassInstance::Call frames. It is written by the interpreter thread and read
+// by the signal handler interrupting that thread, so it needs no locks, only compiler fences
+struct ShadowStack {
+    static constexpr size_t kMaxDepth = 1024u;
+
+    ShadowFrame frames[kMaxDepth];
+    // May exceed kMaxDepth, deeper frames are not stored
+    volatile size_t depth = 0u;
+};
+
+inline thread_local ShadowStack shadow_stack;
+
+struct SamplerOptions {
+    // Samples per second of CPU time consumed by the process
+    int frequency = 99;
+    // Capacity of the buffer between the signal handler and the aggregation
+    size_t buffer_capacity = 512u;
+};
+
+// Statistical profiler: a SIGPROF timer takes snapshots of the shadow stack, and the
+// snapshots are aggregated into folded stacks "<module>:9;Fib.calc:6;Fib.calc:4 <samples>"
+class Sampler {
+public:
+    explicit Sampler(SamplerOptions options);
+    ~Sampler();
+
+    // Returns the active sampler or nullptr if sampling is off
+    static Sampler* Active() {
+        return active_;
+    }
+
+    // Installs the SIGPROF handler and starts the timer. Only one sampler may be active
+    void Start();
+    void Stop();
+
+    // Aggregates the samples taken so far. Called by the interpreter at call boundaries
+    // when the buffer fills up, so the handler never allocates
+    void Drain();
+
+    [[nodiscard]] bool NeedsDrain() const {
+        return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed)
+               >= options_.buffer_capacity / 2u;
+    }
+
+    [[nodiscard]] uint64_t GetSampleCount() const {
+        return sample_count_;
+    }
+
+    // Samples lost because the buffer was full
+    [[nodiscard]] uint64_t GetDroppedCount() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    // Writes "<stack> <samples>" lines, the format of flamegraph.pl and speedscope
+    void WriteFoldedStacks(std::ostream& os) const;
+
+private:
+    struct Sample;
+
+    static void HandleSignal(int signal);
+    void Record(const ShadowStack& stack);
+
+    static inline Sampler* active_ = nullptr;
+
+    SamplerOptions options_;
+    std::unique_ptr<Sample[]> samples_;
+    std::atomic<size_t> head_{0u};
+    std::atomic<size_t> tail_{0u};
+    std::atomic<uint64_t> dropped_{0u};
+    uint64_t sample_count_ = 0u;
+    std::map<std::string, uint64_t> folded_;
+};
+
+// Pushes a Mython call onto the shadow stack of the current thread while sampling is on
+class FrameScope {
+public:
+    FrameScope(const std::string& class_name, const std::string& method_name) {
+        if (Sampler* sampler = Sampler::Active())
+        {
+            ShadowStack& stack = shadow_stack;
+            if (stack.depth < ShadowStack::kMaxDepth)
+            {
+                ShadowFrame& frame = stack.frames[stack.depth];
+                frame.class_name = &class_name;
+                frame.method_name = &method_name;
+                frame.node = nullptr;
+            }
+            std::atomic_signal_fence(std::memory_order_release);
+            stack.depth = stack.depth + 1u;
+            pushed_ = true;
+
+            if (sampler->NeedsDrain())
+            {
+                sampler->Drain();
+            }
+        }
+    }
+
+    FrameScope(const FrameScope&) = delete;
+    FrameScope& operator=(const FrameScope&) = delete;
+
+    ~FrameScope() {
+        if (pushed_)
+        {
+            shadow_stack.depth = shadow_stack.depth - 1u;
+        }
+    }
+
+private:
+    bool pushed_ = false;
+};
+
+// Returns the innermost stored frame or nullptr
+inline ShadowFrame* CurrentFrame() {
+    const size_t depth = shadow_stack.depth;
+    if (depth == 0u || depth > ShadowStack::kMaxDepth)
+    {
+        return nullptr;
+    }
+    return &shadow_stack.frames[depth - 1u];
+}
+
+}  // namespace sample
@@ -0,0 +1,81 @@
+#include "sampler.h"
+#include "statement.h"
+
+#include "test_runner_p.h"
+
+#include <csignal>
+
+using namespace std;
+
+namespace sample {
+
+namespace {
+
+void TestShadowStack() {
+    const string outer_class = "Outer"s;
+    const string outer_method = "run"s;
+    const string inner_class = "Inner"s;
+    const string inner_method = "step"s;
+
+    {
+        FrameScope inactive(outer_class, outer_method);
+        ASSERT_EQUAL(shadow_stack.depth, 0u);
+    }
+
+    // Samples are resolved in Stop, so the node must outlive the sampler
+    ast::None node;
+    node.SetPosition({7u, 3u});
+
+    SamplerOptions options;
+    options.frequency = 1;
+    Sampler sampler(options);
+    sampler.Start();
+    ASSERT_EQUAL(shadow_stack.depth, 1u);
+    {
+        FrameScope outer(outer_class, outer_method);
+        {
+            profile::NodeScope node_scope(node);
+            FrameScope inner(inner_class, inner_method);
+            ASSERT_EQUAL(shadow_stack.depth, 3u);
+            ASSERT(CurrentFrame()->class_name == &inner_class);
+            // Take a sample right here instead of waiting for the timer
+            raise(SIGPROF);
+        }
+        ASSERT(CurrentFrame()->node == nullptr);
+        raise(SIGPROF);
+    }
+    ASSERT_EQUAL(shadow_stack.depth, 1u);
+    sampler.Stop();
+    ASSERT_EQUAL(shadow_stack.depth, 0u);
+
+    ASSERT(sampler.GetSampleCount() >= 2u);
+    ostringstream folded;
+    sampler.WriteFoldedStacks(folded);
+    ASSERT(folded.str().find("<module>;Outer.run:7;Inner.step 1\n"s) != string::npos);
+    ASSERT(folded.str().find("<module>;Outer.run 1\n"s) != string::npos);
+}
+
+void TestFullBufferDropsSamples() {
+    SamplerOptions options;
+    options.frequency = 1;
+    options.buffer_capacity = 2u;
+    Sampler sampler(options);
+    sampler.Start();
+    for (int i = 0; i < 5; ++i)
+    {
+        raise(SIGPROF);
+    }
+    sampler.Stop();
+
+    ASSERT_EQUAL(sampler.GetSampleCount(), 2u);
+    ASSERT_EQUAL(sampler.GetDroppedCount(), 3u);
+}
+
+}  // namespace
+
+void RunSamplerTests(TestRunner& tr) {
+    RUN_TEST(tr, sample::TestShadowStack);
+    RUN_TEST(tr, sample::TestFullBufferDropsSamples);
+}
+
+}  // namespace sample
@@ -1,5 +1,10 @@
 #include "statement.h"
 
+#include "metrics.h"
+#include "profiler.h"
+#include "tracer.h"
+
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -10,18 +15,163 @@ namespace ast {
 using runtime::Closure;
 using runtime::Context;
 using runtime::ObjectHolder;
+using runtime::ValueOf;
 
 namespace {
-const string ADD_METHOD = "__add__"s;
 const string INIT_METHOD = "__init__"s;
+// Имя вызовов NewInstance в трассах
+const string NEW_INSTANCE = "<new>"s;
+
+// Учитывает объект, созданный выражением, в метриках контекста
+ObjectHolder Counted(ObjectHolder object, Context& context) {
+    if (metrics::Registry* metrics = context.GetMetrics())
+    {
+        metrics->Interpreter().objects_allocated.Add();
+        if (const auto* str = object.TryAs<runtime::String>())
+        {
+            metrics->Interpreter().string_bytes.Observe(str->GetValue().size());
+        }
+    }
+    return object;
+}
+
+void CountLookups(Context& context, size_t names) {
+    if (metrics::Registry* metrics = context.GetMetrics())
+    {
+        metrics->Interpreter().closure_lookups.Add(names);
+    }
+}
+
+// Типы обоих операндов в одном значении, чтобы операция выбиралась одним switch
+constexpr unsigned KindPair(runtime::ObjectKind lhs, runtime::ObjectKind rhs) {
+    return static_cast<unsigned>(lhs) << 8u | static_cast<unsigned>(rhs);
+}
+
+constexpr unsigned NUMBERS = KindPair(runtime::ObjectKind::Number, runtime::ObjectKind::Number);
+constexpr unsigned STRINGS = KindPair(runtime::ObjectKind::String, runtime::ObjectKind::String);
+
+// Вызывает lhs.__add__(rhs) и подобные методы у экземпляров пользовательских классов
+ObjectHolder CallArithmeticMethod(runtime::ArithmeticOp op, const ObjectHolder& lhs,
+                                  const ObjectHolder& rhs, Context& context) {
+    if (lhs.GetKind() == runtime::ObjectKind::ClassInstance)
+    {
+        auto& instance = static_cast<runtime::ClassInstance&>(*lhs);
+        if (const runtime::Method* method = instance.GetClass().GetArithmeticMethod(op))
+        {
+            return instance.Call(*method, { rhs }, context);
+        }
+    }
+    throw std::runtime_error("Unsupported operand types"s);
+}
+
+// Возвращает строку lhs + tail. Строка, на которую больше никто не ссылается, дополняется на месте
+ObjectHolder Concatenate(ObjectHolder lhs, const string& tail, Context& context) {
+    if (lhs.IsExclusive())
+    {
+        static_cast<runtime::String&>(*lhs).Append(tail);
+        return lhs;
+    }
+    return Counted(ObjectHolder::Own(runtime::String(ValueOf<string>(lhs) + tail)), context);
+}
+
+// Значение числового операнда операции без проверки переполнения. range::ElideOverflowChecks
+// отмечает операцию, только если и результат, и оба операнда умещаются в 64 бита
+int64_t SmallValue(const ObjectHolder& object) {
+    return ValueOf<bigint::Integer>(object).GetSmall();
+}
+
+ObjectHolder Sum(ObjectHolder lhs, const ObjectHolder& rhs, bool overflow_free, Context& context) {
+    switch (KindPair(lhs.GetKind(), rhs.GetKind()))
+    {
+    case NUMBERS:
+        if (overflow_free)
+        {
+            return Counted(ObjectHolder::Own(runtime::Number(SmallValue(lhs) + SmallValue(rhs))), context);
+        }
+        return Counted(ObjectHolder::Own(runtime::Number(ValueOf<bigint::Integer>(lhs) + ValueOf<bigint::Integer>(rhs))), context);
+    case STRINGS:
+        return Concatenate(move(lhs), ValueOf<string>(rhs), context);
+    default:
+        return CallArithmeticMethod(runtime::ArithmeticOp::Add, lhs, rhs, context);
+    }
+}
+
+ObjectHolder Difference(const ObjectHolder& lhs, const ObjectHolder& rhs, bool overflow_free,
+                        Context& context) {
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) == NUMBERS)
+    {
+        if (overflow_free)
+        {
+            return Counted(ObjectHolder::Own(runtime::Number(SmallValue(lhs) - SmallValue(rhs))), context);
+        }
+        return Counted(ObjectHolder::Own(runtime::Number(ValueOf<bigint::Integer>(lhs) - ValueOf<bigint::Integer>(rhs))), context);
+    }
+    return CallArithmeticMethod(runtime::ArithmeticOp::Sub, lhs, rhs, context);
+}
+
+ObjectHolder Product(const ObjectHolder& lhs, const ObjectHolder& rhs, bool overflow_free,
+                     Context& context) {
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) == NUMBERS)
+    {
+        if (overflow_free)
+        {
+            return Counted(ObjectHolder::Own(runtime::Number(SmallValue(lhs) * SmallValue(rhs))), context);
+        }
+        return Counted(ObjectHolder::Own(runtime::Number(ValueOf<bigint::Integer>(lhs) * ValueOf<bigint::Integer>(rhs))), context);
+    }
+    return CallArithmeticMethod(runtime::ArithmeticOp::Mult, lhs, rhs, context);
+}
+
+ObjectHolder Quotient(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) == NUMBERS)
+    {
+        if (ValueOf<bigint::Integer>(rhs).IsZero())
+        {
+            throw std::runtime_error("Division by zero"s);
+        }
+        return Counted(ObjectHolder::Own(runtime::Number(ValueOf<bigint::Integer>(lhs) / ValueOf<bigint::Integer>(rhs))), context);
+    }
+    return CallArithmeticMethod(runtime::ArithmeticOp::Div, lhs, rhs, context);
+}
+
+// Сохраняет в slot значение value + tail, вычисленное Add::ExecuteDeferred. Если slot хранит
+// единственную другую ссылку на строку, старое значение больше не видно и дополняется на месте
+ObjectHolder StoreConcatenation(ObjectHolder& slot, ObjectHolder value, const string& tail,
+                                Context& context) {
+    if (!tail.empty())
+    {
+        if (value.IsExclusive(1) && slot.Get() == value.Get())
+        {
+            static_cast<runtime::String&>(*value).Append(tail);
+        }
+        else
+        {
+            value = Concatenate(move(value), tail, context);
+        }
+    }
+    return slot = move(value);
+}
 }  // namespace
 
 ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
+    opcount::Count(opcount::Op::ClosureLookup);
+    if (concatenation_ != nullptr)
+    {
+        string tail;
+        ObjectHolder value = concatenation_->ExecuteDeferred(closure, context, tail);
+        return StoreConcatenation(closure[var_], move(value), tail, context);
+    }
     return closure[var_] = rv_->Execute(closure, context);
 }
 
 Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
-    :var_(var), rv_(move(rv)) {}
+    :var_(var), rv_(move(rv)) {
+    if (auto* add = dynamic_cast<Add*>(rv_.get()); add != nullptr && add->StartsWith(nullptr, var_))
+    {
+        concatenation_ = add;
+    }
+}
 
 VariableValue::VariableValue(const std::string& var_name) 
     :value_(var_name) {}
@@ -30,11 +180,15 @@ VariableValue::VariableValue(std::vector<std::string> dotted_ids)
     :value_(move(dotted_ids)) {}
 
 ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     if (holds_alternative<const string>(value_))
     {
+        CountLookups(context, 1u);
         const string value = std::get<const string>(value_);
+        opcount::Count(opcount::Op::ClosureLookup);
         if (closure.find(value) != closure.end())
         {
+            opcount::Count(opcount::Op::ClosureLookup);
             return closure.at(value);
         }
     }
@@ -45,15 +199,19 @@ ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
         {
             return VariableValue{ *values.begin() }.Execute(closure, context);
         }
+        CountLookups(context, values.size());
 
         ObjectHolder obj_holder;
         for (size_t i = 0u; i + 1u < values.size(); ++i)
         {
+            opcount::Count(opcount::Op::ClosureLookup);
             if (closure.find(values.at(i)) != closure.end())
             {
                 const auto& fields = closure.at(values.at(i)).TryAs<runtime::ClassInstance>()->Fields();
+                opcount::Count(opcount::Op::ClosureLookup, 2u);
                 if (fields.find(values.at(i + 1u)) != fields.end())
                 {
+                    opcount::Count(opcount::Op::ClosureLookup);
                     obj_holder = fields.at(values.at(i + 1u));
                 }
                 else
@@ -71,6 +229,39 @@ ObjectHolder VariableValue::Execute(Closure& closure, Context& context) {
     throw std::runtime_error("Not implemented"s);
 }
 
+pair<const string*, const string*> VariableValue::GetIds() const {
+    if (const auto* name = get_if<const string>(&value_))
+    {
+        return { name, name + 1 };
+    }
+    const auto& dotted_ids = get<vector<string>>(value_);
+    return { dotted_ids.data(), dotted_ids.data() + dotted_ids.size() };
+}
+
+bool VariableValue::Names(const VariableValue* object, const string& name) const {
+    const auto [begin, end] = GetIds();
+    if (begin == end || *(end - 1) != name)
+    {
+        return false;
+    }
+    if (object == nullptr)
+    {
+        return end - begin == 1;
+    }
+    const auto [object_begin, object_end] = object->GetIds();
+    return equal(object_begin, object_end, begin, end - 1);
+}
+
+bool VariableValue::IsField() const {
+    const auto [begin, end] = GetIds();
+    return end - begin > 1;
+}
+
+const string* VariableValue::GetVariableName() const {
+    const auto [begin, end] = GetIds();
+    return end - begin == 1 ? begin : nullptr;
+}
+
 unique_ptr<Print> Print::Variable(const std::string& name) {
     return make_unique<Print>(Print{ make_unique<StringConst>(name) });
 }
@@ -82,11 +273,13 @@ Print::Print(vector<unique_ptr<Statement>> args)
     :args_(move(args)) {}
 
 ObjectHolder Print::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     ostream& os = context.GetOutputStream();
     if (argument_)
     {
         if (argument_->Execute(closure, context).TryAs<runtime::String>())
         {
+            opcount::Count(opcount::Op::ClosureLookup);
             closure.at(argument_->Execute(closure, context).TryAs<runtime::String>()->GetValue())->Print(os, context);
         }
     }
@@ -95,19 +288,20 @@ ObjectHolder Print::Execute(Closure& closure, Context& context) {
         bool space_flag = false;
         for (const unique_ptr<Statement>& arg : args_) 
         {
-            if (space_flag) { os << ' '; }
+            if (space_flag) { context.Write(" "sv); }
             space_flag = true;
 
             ObjectHolder obj_holder = arg->Execute(closure, context);
-            if (!obj_holder) 
+            runtime::FormatBuffer buffer;
+            if (const optional<string_view> text = runtime::FormatScalar(obj_holder, buffer))
             {
-                os << "None";
+                context.Write(*text);
                 continue;
             }
             obj_holder->Print(os, context);
         }
     }
-    os << '\n';
+    context.Write("\n"sv);
     return {};
 }
 
@@ -117,6 +311,7 @@ MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
 
 ObjectHolder MethodCall::Execute(Closure& closure, Context& context) 
 {
+    profile::NodeScope scope(*this);
     vector<runtime::ObjectHolder> args;
     for (const auto& arg: args_)
     {
@@ -125,122 +320,170 @@ ObjectHolder MethodCall::Execute(Closure& closure, Context& context)
     return object_->Execute(closure, context).TryAs<runtime::ClassInstance>()->Call(method_, args, context);
 }
 
+void MethodCall::PrepareTailCall(Closure& closure, Context& context, runtime::TailCall& call) {
+    profile::NodeScope scope(*this);
+    call.args.clear();
+    for (const auto& arg: args_)
+    {
+        call.args.push_back(arg->Execute(closure, context));
+    }
+    call.instance = object_->Execute(closure, context);
+    call.method = &method_;
+}
+
 ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     ObjectHolder obj_holder = argument_->Execute(closure, context);
-    if (!obj_holder) 
+    if (obj_holder.GetKind() == runtime::ObjectKind::String)
     {
-        return ObjectHolder::Own(runtime::String("None"s));
+        return obj_holder;
+    }
+    runtime::FormatBuffer buffer;
+    if (const optional<string_view> text = runtime::FormatScalar(obj_holder, buffer))
+    {
+        return Counted(ObjectHolder::Own(runtime::String(string(*text))), context);
     }
     ostringstream oss;
     obj_holder->Print(oss, context);
-    return ObjectHolder::Own(runtime::String(oss.str()));
+    return Counted(ObjectHolder::Own(runtime::String(oss.str())), context);
 }
 
 ObjectHolder Add::Execute(Closure& closure, Context& context) {
-    ObjectHolder lhs_obj_holder = lhs_->Execute(closure, context);
-    ObjectHolder rhs_obj_holder = rhs_->Execute(closure, context);
-    ObjectHolder obj_holder;
-    if (obj_holder = AddStatements<int,runtime::Number>(lhs_obj_holder, rhs_obj_holder)) 
+    profile::NodeScope scope(*this);
+    ObjectHolder lhs = lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    return Sum(move(lhs), rhs, overflow_free_, context);
+}
+
+bool Add::StartsWith(const VariableValue* object, const string& name) const {
+    const Statement* operand = lhs_.get();
+    while (const auto* chain = dynamic_cast<const Add*>(operand))
     {
-        return obj_holder;
+        operand = chain->lhs_.get();
     }
-    else if (obj_holder = AddStatements<string, runtime::String>(lhs_obj_holder, rhs_obj_holder)) 
+    const auto* variable = dynamic_cast<const VariableValue*>(operand);
+    return variable != nullptr && variable->Names(object, name);
+}
+
+ObjectHolder Add::ExecuteDeferred(Closure& closure, Context& context, string& tail) {
+    profile::NodeScope scope(*this);
+    auto* chain = dynamic_cast<Add*>(lhs_.get());
+    ObjectHolder lhs = chain != nullptr ? chain->ExecuteDeferred(closure, context, tail)
+                                        : lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    if (KindPair(lhs.GetKind(), rhs.GetKind()) == STRINGS)
     {
-        return obj_holder;
+        tail += ValueOf<string>(rhs);
+        return lhs;
     }
-    else if (lhs_obj_holder.TryAs<runtime::ClassInstance>()) 
+    // Операнды, которые не являются строками, видят значение вместе с отложенным хвостом
+    if (!tail.empty())
     {
-        if (lhs_obj_holder.TryAs<runtime::ClassInstance>()->HasMethod(ADD_METHOD, 1U)) 
-        {
-            return lhs_obj_holder.TryAs<runtime::ClassInstance>()->Call(ADD_METHOD, { rhs_obj_holder }, context);
-        }
+        lhs = Concatenate(move(lhs), tail, context);
+        tail.clear();
     }
-    throw std::runtime_error("Not implemented"s);
+    return Sum(move(lhs), rhs, overflow_free_, context);
 }
 
 ObjectHolder Sub::Execute(Closure& closure, Context& context) {
-    ObjectHolder lhs_obj_holder = lhs_->Execute(closure, context);
-    ObjectHolder rhs_obj_holder = rhs_->Execute(closure, context);
-    
-    ObjectHolder obj_holder;
-    if (lhs_obj_holder.TryAs<runtime::ValueObject<int>>() &&  rhs_obj_holder.TryAs<runtime::ValueObject<int>>()) 
-    {
-        int lhs = lhs_obj_holder.TryAs<runtime::ValueObject<int>>()->GetValue();
-        int rhs = rhs_obj_holder.TryAs<runtime::ValueObject<int>>()->GetValue();
-        return runtime::ObjectHolder::Own(runtime::Number(lhs - rhs));
-    }
-    throw std::runtime_error("Not implemented"s);
+    profile::NodeScope scope(*this);
+    ObjectHolder lhs = lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    return Difference(lhs, rhs, overflow_free_, context);
 }
 
 ObjectHolder Mult::Execute(Closure& closure, Context& context) {
-    ObjectHolder lhs_obj_holder = lhs_->Execute(closure, context);
-    ObjectHolder rhs_obj_holder = rhs_->Execute(closure, context);
-    
-    ObjectHolder obj_holder;
-    if (lhs_obj_holder.TryAs<runtime::ValueObject<int>>() &&  rhs_obj_holder.TryAs<runtime::ValueObject<int>>()) 
-    {
-        int lhs = lhs_obj_holder.TryAs<runtime::ValueObject<int>>()->GetValue();
-        int rhs = rhs_obj_holder.TryAs<runtime::ValueObject<int>>()->GetValue();
-        return runtime::ObjectHolder::Own(runtime::Number(lhs * rhs));
-    }
-    throw std::runtime_error("Not implemented"s);
+    profile::NodeScope scope(*this);
+    ObjectHolder lhs = lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    return Product(lhs, rhs, overflow_free_, context);
 }
 
 ObjectHolder Div::Execute(Closure& closure, Context& context) {
-    ObjectHolder lhs_obj_holder = lhs_->Execute(closure, context);
-    ObjectHolder rhs_obj_holder = rhs_->Execute(closure, context);
-    
-    ObjectHolder obj_holder;
-    if (lhs_obj_holder.TryAs<runtime::ValueObject<int>>() &&  rhs_obj_holder.TryAs<runtime::ValueObject<int>>()) 
-    {
-        int lhs = lhs_obj_holder.TryAs<runtime::ValueObject<int>>()->GetValue();
-        int rhs = rhs_obj_holder.TryAs<runtime::ValueObject<int>>()->GetValue();
+    profile::NodeScope scope(*this);
+    ObjectHolder lhs = lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    return Quotient(lhs, rhs, context);
+}
 
-        if (rhs == 0) { throw std::runtime_error("Not implemented"s); }
-        return runtime::ObjectHolder::Own(runtime::Number(lhs / rhs));
+ObjectHolder Calculate(runtime::ArithmeticOp op, ObjectHolder lhs, const ObjectHolder& rhs,
+                       Context& context) {
+    switch (op)
+    {
+    case runtime::ArithmeticOp::Add:
+        return Sum(move(lhs), rhs, false, context);
+    case runtime::ArithmeticOp::Sub:
+        return Difference(lhs, rhs, false, context);
+    case runtime::ArithmeticOp::Mult:
+        return Product(lhs, rhs, false, context);
+    case runtime::ArithmeticOp::Div:
+        break;
     }
-    throw std::runtime_error("Not implemented"s);
+    return Quotient(lhs, rhs, context);
 }
 
 ObjectHolder Compound::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     for (auto& stmt: stmts_)
     {
-        if (Return* return_ptr = dynamic_cast<Return*>(stmt.get()))
-        {
-            return return_ptr->Execute(closure, context);
-        }
-        if (IfElse* if_else_ptr = dynamic_cast<IfElse*>(stmt.get()))
-        {
-            if (ObjectHolder obj_holder = if_else_ptr->Execute(closure, context))
-            {
-                return obj_holder;
-            }
-        }
-        else
+        ObjectHolder result = stmt->Execute(closure, context);
+        if (context.GetCompletion() != runtime::Completion::Normal)
         {
-            stmt->Execute(closure, context);
+            return result;
         }
     }
     return {};
 }
 
+Return::Return(std::unique_ptr<Statement> statement)
+    :statement_(move(statement)), tail_call_(dynamic_cast<MethodCall*>(statement_.get())) {}
+
 ObjectHolder Return::Execute(Closure& closure, Context& context) {
-    return statement_->Execute(closure, context);
+    profile::NodeScope scope(*this);
+    if (runtime::TailCall* call = context.GetTailCall(); call != nullptr && tail_call_ != nullptr)
+    {
+        tail_call_->PrepareTailCall(closure, context, *call);
+        context.SetCompletion(runtime::Completion::TailCall);
+        return {};
+    }
+    ObjectHolder result = statement_->Execute(closure, context);
+    context.SetCompletion(runtime::Completion::Return);
+    return result;
 }
 
 ClassDefinition::ClassDefinition(ObjectHolder cls) 
     :cls_(cls) {}
 
 ObjectHolder ClassDefinition::Execute(Closure& closure, [[maybe_unused]] Context& context) {
+    profile::NodeScope scope(*this);
+    opcount::Count(opcount::Op::ClosureLookup);
     closure[cls_.TryAs<runtime::Class>()->GetName()] = cls_;
     return cls_;
 }
 
+const runtime::Class& ClassDefinition::GetClass() const {
+    return static_cast<const runtime::Class&>(*cls_);  // NOLINT
+}
+
 FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
                                  std::unique_ptr<Statement> rv) 
-    :object_(object), field_name_(field_name), rv_(move(rv)) {}
+    :object_(object), field_name_(field_name), rv_(move(rv)) {
+    if (auto* add = dynamic_cast<Add*>(rv_.get()); add != nullptr && add->StartsWith(&object_, field_name_))
+    {
+        concatenation_ = add;
+    }
+}
 
 ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
+    opcount::Count(opcount::Op::ClosureLookup);
+    if (concatenation_ != nullptr)
+    {
+        string tail;
+        ObjectHolder value = concatenation_->ExecuteDeferred(closure, context, tail);
+        return StoreConcatenation(object_.Execute(closure, context).TryAs<runtime::ClassInstance>()->Fields()[field_name_],
+                                  move(value), tail, context);
+    }
     return object_.Execute(closure, context).TryAs<runtime::ClassInstance>()->Fields()[field_name_] = rv_->Execute(closure, context);
 }
 
@@ -249,6 +492,7 @@ IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement>
     :condition_(move(condition)), if_body_(move(if_body)), else_body_(move(else_body)) {}
 
 ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     if (runtime::IsTrue(condition_->Execute(closure, context))) 
     {
         return if_body_->Execute(closure, context); 
@@ -260,35 +504,94 @@ ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
     return {};
 }
 
+While::While(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> body)
+    :condition_(move(condition)), body_(move(body)) {}
+
+ObjectHolder While::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
+    while (runtime::IsTrue(condition_->Execute(closure, context)))
+    {
+        ObjectHolder result = body_->Execute(closure, context);
+        if (context.GetCompletion() != runtime::Completion::Normal)
+        {
+            return result;
+        }
+    }
+    return {};
+}
+
+ForRange::ForRange(std::string var, std::unique_ptr<Statement> begin, std::unique_ptr<Statement> end,
+                   std::unique_ptr<Statement> body)
+    :var_(move(var)), begin_(move(begin)), end_(move(end)), body_(move(body)) {}
+
+ObjectHolder ForRange::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
+    const ObjectHolder begin = begin_->Execute(closure, context);
+    const ObjectHolder end = end_->Execute(closure, context);
+    const auto* first = begin.TryAs<runtime::Number>();
+    const auto* last = end.TryAs<runtime::Number>();
+    if (first == nullptr || last == nullptr)
+    {
+        throw std::runtime_error("range() arguments must be numbers"s);
+    }
+
+    const bigint::Integer& stop = last->GetValue();
+    if (first->GetValue() >= stop)
+    {
+        return {};
+    }
+
+    // Элементы unordered_map не перемещаются при добавлении новых, поэтому переменная
+    // ищется один раз, даже если тело цикла создаёт другие переменные
+    opcount::Count(opcount::Op::ClosureLookup);
+    ObjectHolder& variable = closure[var_];
+    for (bigint::Integer i = first->GetValue(); i < stop; i = i + 1)
+    {
+        variable = Counted(ObjectHolder::Own(runtime::Number(i)), context);
+        ObjectHolder result = body_->Execute(closure, context);
+        if (context.GetCompletion() != runtime::Completion::Normal)
+        {
+            return result;
+        }
+    }
+    return {};
+}
+
 ObjectHolder Or::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     if (runtime::IsTrue(lhs_->Execute(closure, context))) 
     {
-        return ObjectHolder::Own(runtime::Bool{ true });
+        return Counted(ObjectHolder::Own(runtime::Bool{ true }), context);
     }
     else if (runtime::IsTrue(rhs_->Execute(closure, context))) 
     {
-        return ObjectHolder::Own(runtime::Bool{ true });
+        return Counted(ObjectHolder::Own(runtime::Bool{ true }), context);
     }
-    return ObjectHolder::Own(runtime::Bool{ false });
+    return Counted(ObjectHolder::Own(runtime::Bool{ false }), context);
 }
 
 ObjectHolder And::Execute(Closure& closure, Context& context) {
+    profile::NodeScope scope(*this);
     if (runtime::IsTrue(lhs_->Execute(closure, context)) && runtime::IsTrue(rhs_->Execute(closure, context))) 
     {
-        return ObjectHolder::Own(runtime::Bool{ true });
+        return Counted(ObjectHolder::Own(runtime::Bool{ true }), context);
     }
-    return ObjectHolder::Own(runtime::Bool{ false });
+    return Counted(ObjectHolder::Own(runtime::Bool{ false }), context);
 }
 
 ObjectHolder Not::Execute(Closure& closure, Context& context) {
-    return ObjectHolder::Own(runtime::Bool{ !runtime::IsTrue(argument_->Execute(closure, context)) });
+    profile::NodeScope scope(*this);
+    return Counted(ObjectHolder::Own(runtime::Bool{ !runtime::IsTrue(argument_->Execute(closure, context)) }), context);
 }
 
-Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
-    : BinaryOperation(std::move(lhs), std::move(rhs)), cmp_(cmp) {}
+Comparison::Comparison(runtime::CompareOp op, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
+    : BinaryOperation(std::move(lhs), std::move(rhs)), op_(op) {}
 
 ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
-    return ObjectHolder::Own(runtime::Bool{ cmp_(lhs_->Execute(closure, context), rhs_->Execute(closure, context), context) });
+    profile::NodeScope scope(*this);
+    ObjectHolder lhs = lhs_->Execute(closure, context);
+    ObjectHolder rhs = rhs_->Execute(closure, context);
+    return Counted(ObjectHolder::Own(runtime::Bool{ runtime::Compare(op_, lhs, rhs, context) }), context);
 }
 
 NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args)
@@ -298,14 +601,23 @@ NewInstance::NewInstance(const runtime::Class& cls)
     :cls_(cls) {}
 
 ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-    ObjectHolder obj_holder = ObjectHolder::Own(runtime::ClassInstance{ cls_ });
-    if (const runtime::Method* class_method = cls_.GetMethod(INIT_METHOD); class_method) 
+    profile::NodeScope scope(*this);
+    const runtime::Method* class_method = cls_.GetMethod(INIT_METHOD);
+    vector<ObjectHolder> args;
+    if (class_method) 
     {
-        vector<ObjectHolder> args;
         for (const auto& arg : args_) 
         {
             args.push_back(arg->Execute(closure, context));
         }
+    }
+
+    // Аргументы вычисляются вне трассируемого вызова, так как относятся к вызывающему
+    trace::CallScope trace_scope(cls_.GetName(), NEW_INSTANCE, args_.size(),
+                                 trace::CallKind::NewInstance);
+    ObjectHolder obj_holder = Counted(ObjectHolder::Own(runtime::ClassInstance{ cls_ }), context);
+    if (class_method) 
+    {
         obj_holder.TryAs<runtime::ClassInstance>()->Call(class_method->name, args, context);
     }
     return obj_holder;
@@ -315,7 +627,14 @@ MethodBody::MethodBody(std::unique_ptr<Statement>&& body)
     :body_(move(body)) {}
 
 ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
-    return body_->Execute(closure, context);
+    profile::NodeScope scope(*this);
+    ObjectHolder result = body_->Execute(closure, context);
+    if (context.GetCompletion() != runtime::Completion::Return)
+    {
+        return {};
+    }
+    context.SetCompletion(runtime::Completion::Normal);
+    return result;
 }
 
 }  // namespace ast
\ No newline at end of file
@@ -1,14 +1,16 @@
 #pragma once
 
+#include "profiler.h"
 #include "runtime.h"
 
-#include <functional>
 #include <variant>
 
 namespace ast {
 
 using Statement = runtime::Executable;
 
+class Add;
+
 // Выражение, возвращающее значение типа T,
 // используется как основа для создания констант
 template <typename T>
@@ -18,11 +20,23 @@ public:
         : value_(std::move(v)) {
     }
 
+    // Создаёт значение из аргумента его конструктора, например NumericConst(57)
+    template <typename U, typename = std::enable_if_t<!std::is_same_v<std::decay_t<U>, T>
+                                                      && std::is_constructible_v<T, U>>>
+    explicit ValueStatement(U&& v)
+        : value_(std::forward<U>(v)) {
+    }
+
     runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
                                   runtime::Context& /*context*/) override {
+        profile::NodeScope scope(*this);
         return runtime::ObjectHolder::Share(value_);
     }
 
+    [[nodiscard]] const T& GetValue() const {
+        return value_;
+    }
+
 private:
     T value_;
 };
@@ -42,6 +56,16 @@ public:
     explicit VariableValue(std::vector<std::string> dotted_ids);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Возвращает true, если выражение - переменная name (object равен nullptr)
+    // либо поле object.name
+    [[nodiscard]] bool Names(const VariableValue* object, const std::string& name) const;
+    // Возвращает true, если выражение - цепочка полей id1.id2..., а не переменная
+    [[nodiscard]] bool IsField() const;
+    // Возвращает имя переменной либо nullptr, если выражение - цепочка полей
+    [[nodiscard]] const std::string* GetVariableName() const;
+    // Возвращает имена id1, id2, ... цепочки полей либо имя переменной как диапазон [begin, end)
+    [[nodiscard]] std::pair<const std::string*, const std::string*> GetIds() const;
 private:
     std::variant<const std::string, std::vector<std::string>> value_;
 };
@@ -53,9 +77,23 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const std::string& GetVar() const {
+        return var_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetRv() const {
+        return rv_;
+    }
+
+    std::unique_ptr<Statement>& GetRv() {
+        return rv_;
+    }
+
 private:
     std::string var_;
     std::unique_ptr<Statement> rv_;
+    // rv_, если это конкатенация вида var + ... (см. Add::ExecuteDeferred)
+    Add* concatenation_ = nullptr;
 };
 
 // Присваивает полю object.field_name значение выражения rv
@@ -65,10 +103,28 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const VariableValue& GetObject() const {
+        return object_;
+    }
+
+    [[nodiscard]] const std::string& GetFieldName() const {
+        return field_name_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetRv() const {
+        return rv_;
+    }
+
+    std::unique_ptr<Statement>& GetRv() {
+        return rv_;
+    }
+
 private:
     VariableValue object_;
     std::string field_name_;
     std::unique_ptr<Statement> rv_;
+    // rv_, если это конкатенация вида object.field_name + ... (см. Add::ExecuteDeferred)
+    Add* concatenation_ = nullptr;
 };
 
 // Значение None
@@ -76,6 +132,7 @@ class None : public Statement {
 public:
     runtime::ObjectHolder Execute([[maybe_unused]] runtime::Closure& closure,
                                   [[maybe_unused]] runtime::Context& context) override {
+        profile::NodeScope scope(*this);
         return {};
     }
 };
@@ -95,6 +152,19 @@ public:
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    // Возвращает аргумент, заданный одним выражением, либо nullptr, если задан список args
+    [[nodiscard]] const std::unique_ptr<Statement>& GetArgument() const {
+        return argument_;
+    }
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+
+    std::vector<std::unique_ptr<Statement>>& GetArgs() {
+        return args_;
+    }
+
 private:
     std::unique_ptr<Statement> argument_;
     std::vector<std::unique_ptr<Statement>> args_;
@@ -108,6 +178,30 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    // Вычисляет аргументы и объект, метод которого вызывается, и записывает вызов в call,
+    // не выполняя его
+    void PrepareTailCall(runtime::Closure& closure, runtime::Context& context, runtime::TailCall& call);
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetObject() const {
+        return object_;
+    }
+
+    std::unique_ptr<Statement>& GetObject() {
+        return object_;
+    }
+
+    [[nodiscard]] const std::string& GetMethod() const {
+        return method_;
+    }
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+
+    std::vector<std::unique_ptr<Statement>>& GetArgs() {
+        return args_;
+    }
+
 private:
     std::unique_ptr<Statement> object_;
     std::string method_;
@@ -133,6 +227,14 @@ public:
     NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
     // Возвращает объект, содержащий значение типа ClassInstance
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+
+    std::vector<std::unique_ptr<Statement>>& GetArgs() {
+        return args_;
+    }
 private:
     const runtime::Class& cls_;
     std::vector<std::unique_ptr<Statement>> args_;
@@ -143,6 +245,14 @@ class UnaryOperation : public Statement {
 public:
     explicit UnaryOperation(std::unique_ptr<Statement> argument) 
         :argument_(std::move(argument)) {}
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetArgument() const {
+        return argument_;
+    }
+
+    std::unique_ptr<Statement>& GetArgument() {
+        return argument_;
+    }
 protected:
     std::unique_ptr<Statement> argument_;
 };
@@ -159,9 +269,37 @@ class BinaryOperation : public Statement {
 public:
     BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs) 
         :lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+    // Отмечает, что операнды и результат операции над числами заведомо умещаются в 64 бита
+    // и она вычисляется без проверки переполнения (см. range::ElideOverflowChecks).
+    // Учитывается Add, Sub и Mult
+    void SetOverflowFree() {
+        overflow_free_ = true;
+    }
+
+    [[nodiscard]] bool IsOverflowFree() const {
+        return overflow_free_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetLhs() const {
+        return lhs_;
+    }
+
+    std::unique_ptr<Statement>& GetLhs() {
+        return lhs_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetRhs() const {
+        return rhs_;
+    }
+
+    std::unique_ptr<Statement>& GetRhs() {
+        return rhs_;
+    }
 protected:
     std::unique_ptr<Statement> lhs_;
     std::unique_ptr<Statement> rhs_;
+    bool overflow_free_ = false;
 };
 
 // Возвращает результат операции + над аргументами lhs и rhs
@@ -169,22 +307,23 @@ class Add : public BinaryOperation {
 public:
     using BinaryOperation::BinaryOperation;
 
-    template <typename CheckType, typename ResultType>
-    runtime::ObjectHolder AddStatements(const runtime::ObjectHolder& lhs, const runtime::ObjectHolder& rhs) 
-    {
-        if (lhs.TryAs<runtime::ValueObject<CheckType>>() && rhs.TryAs<runtime::ValueObject<CheckType>>()) 
-        {
-            CheckType result = lhs.TryAs<runtime::ValueObject<CheckType>>()->GetValue() + rhs.TryAs<runtime::ValueObject<CheckType>>()->GetValue();
-            return runtime::ObjectHolder::Own(ResultType(result));
-        }
-        return {};
-    }
     // Поддерживается сложение:
     //  число + число
     //  строка + строка
-    //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
+    //  объект1 + объект2, если у объект1 - пользовательский класс с методом __add__(rhs)
     // В противном случае при вычислении выбрасывается runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Возвращает true, если самый левый операнд цепочки сложений a + b + c - переменная name
+    // либо поле object.name (см. VariableValue::Names)
+    [[nodiscard]] bool StartsWith(const VariableValue* object, const std::string& name) const;
+
+    // Вычисляет цепочку сложений слева направо так же, как Execute, но строки, прибавляемые
+    // к строке, не копируются в новый объект, а дописываются в tail. Значение цепочки -
+    // результат, к которому дописан tail. Так присваивание s = s + a + b может дописать tail
+    // к строке s на месте, когда кроме самой переменной на строку никто не ссылается
+    runtime::ObjectHolder ExecuteDeferred(runtime::Closure& closure, runtime::Context& context,
+                                          std::string& tail);
 };
 
 // Возвращает результат вычитания аргументов lhs и rhs
@@ -194,7 +333,8 @@ public:
 
     // Поддерживается вычитание:
     //  число - число
-    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+    //  объект1 - объект2, если у объект1 - пользовательский класс с методом __sub__(rhs)
+    // В противном случае выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 };
 
@@ -205,7 +345,8 @@ public:
 
     // Поддерживается умножение:
     //  число * число
-    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+    //  объект1 * объект2, если у объект1 - пользовательский класс с методом __mul__(rhs)
+    // В противном случае выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 };
 
@@ -216,7 +357,8 @@ public:
 
     // Поддерживается деление:
     //  число / число
-    // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
+    //  объект1 / объект2, если у объект1 - пользовательский класс с методом __truediv__(rhs)
+    // В противном случае выбрасывается исключение runtime_error
     // Если rhs равен 0, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 };
@@ -260,9 +402,19 @@ public:
         stmts_.push_back(std::move(stmt));
     }
 
-    // Последовательно выполняет добавленные инструкции. Возвращает None
+    // Последовательно выполняет добавленные инструкции. Возвращает None, а если одна из них
+    // завершилась выполнением return - результат return, не выполняя остальные
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    // Возвращает добавленные инструкции
+    [[nodiscard]] const std::vector<std::unique_ptr<Statement>>& GetStatements() const {
+        return stmts_;
+    }
+
+    std::vector<std::unique_ptr<Statement>>& GetStatements() {
+        return stmts_;
+    }
+
 private:
     std::vector<std::unique_ptr<Statement>> stmts_;
 };
@@ -277,6 +429,10 @@ public:
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const std::unique_ptr<Statement>& GetBody() const {
+        return body_;
+    }
+
 private:
     std::unique_ptr<Statement> body_;
 };
@@ -284,14 +440,31 @@ private:
 // Выполняет инструкцию return с выражением statement
 class Return : public Statement {
 public:
-    explicit Return(std::unique_ptr<Statement> statement) 
-        :statement_(std::move(statement)) {}
+    explicit Return(std::unique_ptr<Statement> statement);
 
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
+    // Об остановке сообщает context.GetCompletion(), равный Completion::Return.
+    // Если statement - вызов метода, а return выполняется внутри метода, вызов не выполняется,
+    // а записывается в context.GetTailCall(), и GetCompletion() равен Completion::TailCall
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetStatement() const {
+        return statement_;
+    }
+
+    std::unique_ptr<Statement>& GetStatement() {
+        return statement_;
+    }
+
+    // Возвращает statement, если это вызов метода, иначе nullptr
+    [[nodiscard]] const MethodCall* GetTailCall() const {
+        return tail_call_;
+    }
 private:
     std::unique_ptr<Statement> statement_;
+    // statement_, если это вызов метода
+    MethodCall* tail_call_ = nullptr;
 };
 
 // Объявляет класс
@@ -304,6 +477,8 @@ public:
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const runtime::Class& GetClass() const;
+
 private:
     runtime::ObjectHolder cls_;
 };
@@ -317,27 +492,125 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] const std::unique_ptr<Statement>& GetCondition() const {
+        return condition_;
+    }
+
+    std::unique_ptr<Statement>& GetCondition() {
+        return condition_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetIfBody() const {
+        return if_body_;
+    }
+
+    std::unique_ptr<Statement>& GetIfBody() {
+        return if_body_;
+    }
+
+    // Возвращает nullptr, если ветки else нет
+    [[nodiscard]] const std::unique_ptr<Statement>& GetElseBody() const {
+        return else_body_;
+    }
+
+    std::unique_ptr<Statement>& GetElseBody() {
+        return else_body_;
+    }
+
 private:
     std::unique_ptr<Statement> condition_;
     std::unique_ptr<Statement> if_body_;
     std::unique_ptr<Statement> else_body_;
 };
 
+// Цикл while. Тело выполняется в текущей области видимости, пока condition приводится к True
+class While : public Statement {
+public:
+    While(std::unique_ptr<Statement> condition, std::unique_ptr<Statement> body);
+
+    // Возвращает значение инструкции return, выполненной в теле цикла
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetCondition() const {
+        return condition_;
+    }
+
+    std::unique_ptr<Statement>& GetCondition() {
+        return condition_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetBody() const {
+        return body_;
+    }
+
+private:
+    std::unique_ptr<Statement> condition_;
+    std::unique_ptr<Statement> body_;
+};
+
+// Цикл for var in range(begin, end). Границы вычисляются один раз до начала цикла и должны быть
+// числами. Перед каждой итерацией переменной var текущей области видимости присваивается
+// очередное число из [begin, end). Присваивание var в теле цикла не влияет на число итераций
+class ForRange : public Statement {
+public:
+    ForRange(std::string var, std::unique_ptr<Statement> begin, std::unique_ptr<Statement> end,
+             std::unique_ptr<Statement> body);
+
+    // Возвращает значение инструкции return, выполненной в теле цикла
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    [[nodiscard]] const std::string& GetVar() const {
+        return var_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetBegin() const {
+        return begin_;
+    }
+
+    std::unique_ptr<Statement>& GetBegin() {
+        return begin_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetEnd() const {
+        return end_;
+    }
+
+    std::unique_ptr<Statement>& GetEnd() {
+        return end_;
+    }
+
+    [[nodiscard]] const std::unique_ptr<Statement>& GetBody() const {
+        return body_;
+    }
+
+private:
+    std::string var_;
+    std::unique_ptr<Statement> begin_;
+    std::unique_ptr<Statement> end_;
+    std::unique_ptr<Statement> body_;
+};
+
 // Операция сравнения
 class Comparison : public BinaryOperation {
 public:
-    // Comparator задаёт функцию, выполняющую сравнение значений аргументов
-    using Comparator = std::function<bool(const runtime::ObjectHolder&,
-                                          const runtime::ObjectHolder&, runtime::Context&)>;
-
-    Comparison(Comparator cmp, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
+    // op задаёт операцию, выполняющую сравнение значений аргументов
+    Comparison(runtime::CompareOp op, std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs);
 
-    // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
+    // Вычисляет значение выражений lhs и rhs и возвращает результат runtime::Compare,
     // приведённый к типу runtime::Bool
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    [[nodiscard]] runtime::CompareOp GetOp() const {
+        return op_;
+    }
+
 private:
-    Comparator cmp_;
+    runtime::CompareOp op_;
 };
 
+// Выполняет арифметическую операцию op над уже вычисленными значениями lhs и rhs так же,
+// как Add, Sub, Mult и Div. Применяется кодом, скомпилированным из тела метода (см. jit.h)
+runtime::ObjectHolder Calculate(runtime::ArithmeticOp op, runtime::ObjectHolder lhs,
+                                const runtime::ObjectHolder& rhs, runtime::Context& context);
+
 }  // namespace ast
\ No newline at end of file
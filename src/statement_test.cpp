@@ -184,7 +184,9 @@ void TestStringify() {
         ASSERT(result.TryAs<runtime::String>());
     }
     {
-        auto result = Stringify(make_unique<StringConst>("Wazzup!"s)).Execute(empty, context);
+        // The result refers to the constant of the node
+        Stringify str(make_unique<StringConst>("Wazzup!"s));
+        auto result = str.Execute(empty, context);
         ASSERT_OBJECT_VALUE_EQUAL(result, "Wazzup!"s);
         ASSERT(result.TryAs<runtime::String>());
     }
@@ -212,6 +214,18 @@ void TestStringify() {
         Stringify str(make_unique<None>());
         ASSERT_OBJECT_VALUE_EQUAL(str.Execute(empty, context), "None"s);
     }
+    {
+        auto result = Stringify(make_unique<NumericConst>(-2147483647 - 1)).Execute(empty, context);
+        ASSERT_OBJECT_VALUE_EQUAL(result, "-2147483648"s);
+        result = Stringify(make_unique<BoolConst>(runtime::Bool(false))).Execute(empty, context);
+        ASSERT_OBJECT_VALUE_EQUAL(result, "False"s);
+    }
+    {
+        // A string is returned as is
+        runtime::Closure closure{{"s"s, ObjectHolder::Own(runtime::String("text"s))}};
+        Stringify str(make_unique<VariableValue>("s"s));
+        ASSERT(str.Execute(closure, context).Get() == closure.at("s"s).Get());
+    }
 
     ASSERT(context.output.str().empty());
 }
@@ -238,6 +252,58 @@ void TestStringsAddition() {
     ASSERT(context.output.str().empty());
 }
 
+void TestConcatenationInPlace() {
+    runtime::DummyContext context;
+    Closure closure;
+    const auto value_of = [&closure](const string& name) {
+        return closure.at(name).TryAs<runtime::String>()->GetValue();
+    };
+
+    Assignment init("s"s, make_unique<StringConst>("ab"s));
+    init.Execute(closure, context);
+    const runtime::Object* constant = closure.at("s"s).Get();
+
+    // s = s + "-" + "c"
+    Assignment append("s"s, make_unique<Add>(make_unique<Add>(make_unique<VariableValue>("s"s),
+                                                              make_unique<StringConst>("-"s)),
+                                             make_unique<StringConst>("c"s)));
+    append.Execute(closure, context);
+    ASSERT_EQUAL(value_of("s"s), "ab-c"s);
+    // The constant of the program is shared, so it is copied rather than changed
+    ASSERT_EQUAL(static_cast<const runtime::String*>(constant)->GetValue(), "ab"s);
+
+    // Nobody else refers to the result, so it is extended in place
+    const runtime::Object* result = closure.at("s"s).Get();
+    append.Execute(closure, context);
+    ASSERT_EQUAL(value_of("s"s), "ab-c-c"s);
+    ASSERT(closure.at("s"s).Get() == result);
+
+    // Another variable refers to the same string and must not see the change
+    closure["t"s] = closure.at("s"s);
+    append.Execute(closure, context);
+    ASSERT_EQUAL(value_of("s"s), "ab-c-c-c"s);
+    ASSERT_EQUAL(value_of("t"s), "ab-c-c"s);
+
+    // The operands on the right see the old value: t = t + "+" + t
+    Assignment doubled("t"s, make_unique<Add>(make_unique<Add>(make_unique<VariableValue>("t"s),
+                                                               make_unique<StringConst>("+"s)),
+                                              make_unique<VariableValue>("t"s)));
+    doubled.Execute(closure, context);
+    ASSERT_EQUAL(value_of("t"s), "ab-c-c+ab-c-c"s);
+
+    // Operands that are not strings are added as usual
+    closure["n"s] = ObjectHolder::Own(runtime::Number(1));
+    Assignment increment("n"s, make_unique<Add>(make_unique<Add>(make_unique<VariableValue>("n"s),
+                                                                 make_unique<NumericConst>(2)),
+                                                make_unique<NumericConst>(3)));
+    ASSERT_EQUAL(increment.Execute(closure, context).TryAs<runtime::Number>()->GetValue(), 6);
+    Assignment bad("s"s, make_unique<Add>(make_unique<Add>(make_unique<VariableValue>("s"s),
+                                                           make_unique<StringConst>("x"s)),
+                                          make_unique<NumericConst>(1)));
+    ASSERT_THROWS(bad.Execute(closure, context), std::runtime_error);
+    ASSERT_EQUAL(value_of("s"s), "ab-c-c-c"s);
+}
+
 void TestBadAddition() {
     runtime::DummyContext context;
 
@@ -288,6 +354,36 @@ void TestClassInstanceAddWithoutMethod() {
     ASSERT(context.output.str().empty());
 }
 
+void TestClassInstanceArithmetic() {
+    runtime::DummyContext context;
+
+    vector<runtime::Method> methods;
+    methods.push_back({"__sub__"s, {"rhs"s},
+                       make_unique<Sub>(make_unique<NumericConst>(10), make_unique<VariableValue>("rhs"s))});
+    methods.push_back({"__mul__"s, {"rhs"s},
+                       make_unique<Mult>(make_unique<NumericConst>(10), make_unique<VariableValue>("rhs"s))});
+    methods.push_back({"__truediv__"s, {"rhs"s},
+                       make_unique<Div>(make_unique<NumericConst>(10), make_unique<VariableValue>("rhs"s))});
+    runtime::Class base("Ten"s, std::move(methods), nullptr);
+    runtime::Class cls("DerivedTen"s, {}, &base);
+
+    Closure empty;
+    ASSERT_OBJECT_VALUE_EQUAL(Sub(make_unique<NewInstance>(cls), make_unique<NumericConst>(3)).Execute(empty, context),
+                              7);
+    ASSERT_OBJECT_VALUE_EQUAL(Mult(make_unique<NewInstance>(cls), make_unique<NumericConst>(3)).Execute(empty, context),
+                              30);
+    ASSERT_OBJECT_VALUE_EQUAL(Div(make_unique<NewInstance>(cls), make_unique<NumericConst>(3)).Execute(empty, context),
+                              3);
+    ASSERT_THROWS(Add(make_unique<NewInstance>(cls), make_unique<NumericConst>(3)).Execute(empty, context),
+                  std::runtime_error);
+    ASSERT_THROWS(Div(make_unique<NewInstance>(cls), make_unique<NumericConst>(0)).Execute(empty, context),
+                  std::runtime_error);
+    ASSERT_THROWS(Mult(make_unique<NumericConst>(3), make_unique<StringConst>("a"s)).Execute(empty, context),
+                  std::runtime_error);
+    ASSERT_THROWS(Sub(make_unique<NumericConst>(3), make_unique<NewInstance>(cls)).Execute(empty, context),
+                  std::runtime_error);
+}
+
 void TestCompound() {
     runtime::DummyContext context;
 
@@ -309,6 +405,37 @@ void TestCompound() {
     ASSERT(context.output.str().empty());
 }
 
+void TestCompletion() {
+    runtime::DummyContext context;
+    Closure closure;
+
+    // A value of a statement inside if is not a return value
+    vector<unique_ptr<Statement>> args;
+    args.push_back(make_unique<VariableValue>("x"s));
+    Compound cpd{
+        make_unique<IfElse>(make_unique<BoolConst>(true),
+                            make_unique<Assignment>("x"s, make_unique<NumericConst>(1)), nullptr),
+        make_unique<Print>(move(args)),
+    };
+    ASSERT(!cpd.Execute(closure, context));
+    ASSERT_EQUAL(context.output.str(), "1\n"s);
+    ASSERT(context.GetCompletion() == runtime::Completion::Normal);
+
+    // return None inside if stops the method
+    MethodBody method{make_unique<Compound>(
+        make_unique<IfElse>(make_unique<BoolConst>(true),
+                            make_unique<Compound>(make_unique<Return>(make_unique<None>())), nullptr),
+        make_unique<Assignment>("y"s, make_unique<NumericConst>(2)))};
+    ASSERT(!method.Execute(closure, context));
+    ASSERT(closure.count("y"s) == 0u);
+    ASSERT(context.GetCompletion() == runtime::Completion::Normal);
+
+    // The value of the last statement is not returned without return
+    MethodBody no_return{make_unique<Compound>(make_unique<Assignment>("y"s, make_unique<NumericConst>(2)))};
+    ASSERT(!no_return.Execute(closure, context));
+    ASSERT_OBJECT_VALUE_EQUAL(closure.at("y"s), 2);
+}
+
 void TestFields() {
     runtime::DummyContext context;
 
@@ -467,10 +594,13 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestStringify);
     RUN_TEST(tr, ast::TestNumbersAddition);
     RUN_TEST(tr, ast::TestStringsAddition);
+    RUN_TEST(tr, ast::TestConcatenationInPlace);
     RUN_TEST(tr, ast::TestBadAddition);
     RUN_TEST(tr, ast::TestSuccessfulClassInstanceAdd);
     RUN_TEST(tr, ast::TestClassInstanceAddWithoutMethod);
+    RUN_TEST(tr, ast::TestClassInstanceArithmetic);
     RUN_TEST(tr, ast::TestCompound);
+    RUN_TEST(tr, ast::TestCompletion);
     RUN_TEST(tr, ast::TestFields);
     RUN_TEST(tr, ast::TestBaseClass);
     RUN_TEST(tr, ast::TestInheritance);
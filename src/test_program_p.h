@@ -0,0 +1,64 @@
+#pragma once
+
+#include "lexer.h"
+#include "parse.h"
+#include "runtime.h"
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+// Steps of ExecuteProgram around the execution of the program. Each of them may be empty
+struct RunOptions {
+    // Registry the lexer reports its time to
+    metrics::Registry* metrics = nullptr;
+    // Called with the parsed program before it is executed, e.g. to transform it or to start
+    // an instrument
+    std::function<void(runtime::Executable&)> before;
+    // Called with the globals right after the program has been executed
+    std::function<void(runtime::Closure&)> executed;
+    // Called once the globals are gone. The program is still alive, so names and sites recorded
+    // by instruments, which point into it, can be checked here
+    std::function<void()> after;
+};
+
+// Parses the program and executes it in context with the steps of options
+inline void ExecuteProgram(const std::string& source, runtime::Context& context,
+                           const RunOptions& options) {
+    std::istringstream input(source);
+    parse::Lexer lexer(input, options.metrics);
+    auto program = ParseProgram(lexer);
+    if (options.before)
+    {
+        options.before(*program);
+    }
+    {
+        runtime::Closure closure;
+        program->Execute(closure, context);
+        if (options.executed)
+        {
+            options.executed(closure);
+        }
+    }
+    if (options.after)
+    {
+        options.after();
+    }
+}
+
+// Parses the program, passes it to transform, if one is given, and executes it in context.
+// Returns everything the program has printed to context
+inline std::string RunProgram(const std::string& source, runtime::DummyContext& context,
+                              const std::function<void(runtime::Executable&)>& transform = {}) {
+    RunOptions options;
+    options.before = transform;
+    ExecuteProgram(source, context, options);
+    return context.output.str();
+}
+
+// The same in a new DummyContext
+inline std::string RunProgram(const std::string& source,
+                              const std::function<void(runtime::Executable&)>& transform = {}) {
+    runtime::DummyContext context;
+    return RunProgram(source, context, transform);
+}
@@ -0,0 +1,217 @@
+#include "tracer.h"
+
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+namespace trace {
+
+namespace {
+
+double ToMicroseconds(Clock::duration duration) {
+    return chrono::duration<double, micro>(duration).count();
+}
+
+}  // namespace
+
+struct Tracer::CallTreeNode {
+    using Key = pair<const string*, const string*>;
+
+    CallTreeNode* parent = nullptr;
+    const string* class_name = nullptr;
+    const string* method_name = nullptr;
+    Clock::duration self_time{};
+    map<Key, unique_ptr<CallTreeNode>> children;
+
+    CallTreeNode& Child(const string& cls, const string& method) {
+        auto& child = children[Key{&cls, &method}];
+        if (!child)
+        {
+            child = make_unique<CallTreeNode>();
+            child->parent = this;
+            child->class_name = &cls;
+            child->method_name = &method;
+        }
+        return *child;
+    }
+};
+
+struct Tracer::ThreadState {
+    struct Frame {
+        CallTreeNode* node = nullptr;
+        Clock::time_point start;
+        Clock::duration children_time{};
+        uint32_t arity = 0u;
+        CallKind kind = CallKind::Method;
+    };
+
+    uint64_t thread_id = 0u;
+    CallTreeNode root;
+    CallTreeNode* current = &root;
+    vector<Frame> stack;
+    vector<CallEvent> events;
+};
+
+Tracer::Tracer(TracerOptions options)
+    :options_(options) {}
+
+Tracer::~Tracer() {
+    Stop();
+}
+
+void Tracer::Start() {
+    generation_ = next_generation_++;
+    origin_ = Clock::now();
+    if (options_.chrome_trace != nullptr)
+    {
+        *options_.chrome_trace << "{\"traceEvents\":[\n";
+        first_event_ = true;
+    }
+    active_ = this;
+}
+
+void Tracer::Stop() {
+    if (active_ != this)
+    {
+        return;
+    }
+    active_ = nullptr;
+    for (auto& state : threads_)
+    {
+        FlushEvents(*state);
+    }
+    if (options_.chrome_trace != nullptr)
+    {
+        *options_.chrome_trace << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        options_.chrome_trace->flush();
+    }
+}
+
+Tracer::ThreadState& Tracer::CurrentThread() {
+    thread_local ThreadState* cached_state = nullptr;
+    thread_local uint64_t cached_generation = 0u;
+
+    if (cached_generation != generation_)
+    {
+        lock_guard guard(mutex_);
+        auto state = make_unique<ThreadState>();
+        state->thread_id = threads_.size() + 1u;
+        state->events.reserve(options_.buffer_capacity);
+        cached_state = state.get();
+        cached_generation = generation_;
+        threads_.push_back(move(state));
+    }
+    return *cached_state;
+}
+
+void Tracer::Enter(const string& class_name, const string& method_name, size_t arity, CallKind kind) {
+    ThreadState& state = CurrentThread();
+    state.current = &state.current->Child(class_name, method_name);
+    state.stack.push_back({state.current, Clock::now(), {}, static_cast<uint32_t>(arity), kind});
+}
+
+void Tracer::Leave() {
+    ThreadState& state = CurrentThread();
+    if (state.stack.empty())
+    {
+        return;
+    }
+    const ThreadState::Frame frame = state.stack.back();
+    state.stack.pop_back();
+
+    const Clock::duration duration = Clock::now() - frame.start;
+    frame.node->self_time += duration - frame.children_time;
+    if (!state.stack.empty())
+    {
+        state.stack.back().children_time += duration;
+    }
+    state.current = frame.node->parent;
+
+    if (options_.chrome_trace == nullptr || duration < options_.threshold)
+    {
+        return;
+    }
+    state.events.push_back({frame.node->class_name, frame.node->method_name, frame.start, duration,
+                            frame.arity, static_cast<uint32_t>(state.stack.size()), frame.kind});
+    if (state.events.size() >= options_.buffer_capacity)
+    {
+        FlushEvents(state);
+    }
+}
+
+void Tracer::FlushEvents(ThreadState& state) {
+    lock_guard guard(mutex_);
+    for (const CallEvent& event : state.events)
+    {
+        WriteEvent(event, state.thread_id);
+    }
+    state.events.clear();
+}
+
+void Tracer::WriteEvent(const CallEvent& event, uint64_t thread_id) {
+    ostream& os = *options_.chrome_trace;
+    if (!first_event_)
+    {
+        os << ",\n";
+    }
+    first_event_ = false;
+
+    os << fixed << setprecision(3) << "{\"name\":\"" << *event.class_name << '.'
+       << *event.method_name << "\",\"cat\":\""
+       << (event.kind == CallKind::Method ? "call" : "new")
+       << "\",\"ph\":\"X\",\"ts\":" << ToMicroseconds(event.start - origin_)
+       << ",\"dur\":" << ToMicroseconds(event.duration) << ",\"pid\":1,\"tid\":" << thread_id
+       << ",\"args\":{\"arity\":" << event.arity << ",\"depth\":" << event.depth << "}}";
+}
+
+void Tracer::WriteFoldedStacks(ostream& os) const {
+    lock_guard guard(mutex_);
+    map<string, Clock::duration> stacks;
+
+    // Iterative DFS keeping the current path as a string
+    struct Item {
+        const CallTreeNode* node;
+        size_t prefix_length;
+    };
+    for (const auto& state : threads_)
+    {
+        string path;
+        vector<Item> pending;
+        for (const auto& [key, child] : state->root.children)
+        {
+            pending.push_back({child.get(), 0u});
+        }
+        while (!pending.empty())
+        {
+            const Item item = pending.back();
+            pending.pop_back();
+
+            path.resize(item.prefix_length);
+            if (!path.empty())
+            {
+                path += ';';
+            }
+            path += *item.node->class_name;
+            path += '.';
+            path += *item.node->method_name;
+
+            stacks[path] += item.node->self_time;
+            for (const auto& [key, child] : item.node->children)
+            {
+                pending.push_back({child.get(), path.size()});
+            }
+        }
+    }
+
+    for (const auto& [stack, self_time] : stacks)
+    {
+        auto microseconds = chrono::duration_cast<chrono::microseconds>(self_time).count();
+        if (microseconds > 0)
+        {
+            os << stack << ' ' << microseconds << '\n';
+        }
+    }
+}
+
+}  // namespace trace
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class CallKind : uint8_t {
+    Method,       // ClassInstance::Call
+    NewInstance,  // NewInstance::Execute, including the __init__ call
+};
+
+// A finished call. Names point into runtime::Class and runtime::Method, so events must be
+// flushed while the program is alive
+struct CallEvent {
+    const std::string* class_name = nullptr;
+    const std::string* method_name = nullptr;
+    Clock::time_point start;
+    Clock::duration duration{};
+    uint32_t arity = 0u;
+    uint32_t depth = 0u;
+    CallKind kind = CallKind::Method;
+};
+
+struct TracerOptions {
+    // Chrome trace_event JSON is written here if not null
+    std::ostream* chrome_trace = nullptr;
+    // Only calls lasting at least this long are written to the Chrome trace.
+    // Folded stacks always account for every call
+    Clock::duration threshold{};
+    // Capacity of the per-thread event buffer. A full buffer is written out and reused
+    size_t buffer_capacity = 1u << 16;
+};
+
+// Records Mython method calls in per-thread buffers. Calls are aggregated into a call tree
+// for folded stacks and optionally logged as Chrome trace events
+class Tracer {
+public:
+    explicit Tracer(TracerOptions options);
+    ~Tracer();
+
+    // Returns the active tracer or nullptr if tracing is off
+    static Tracer* Active() {
+        return active_;
+    }
+
+    // Makes this tracer the active one and opens the Chrome trace
+    void Start();
+    // Flushes buffers of all threads and closes the Chrome trace
+    void Stop();
+
+    void Enter(const std::string& class_name, const std::string& method_name, size_t arity,
+               CallKind kind);
+    void Leave();
+
+    // Writes the call tree in the folded format of flamegraph.pl: "A.f;B.g <self time in us>"
+    void WriteFoldedStacks(std::ostream& os) const;
+
+private:
+    struct CallTreeNode;
+    struct ThreadState;
+
+    ThreadState& CurrentThread();
+    void FlushEvents(ThreadState& state);
+    void WriteEvent(const CallEvent& event, uint64_t thread_id);
+
+    static inline Tracer* active_ = nullptr;
+    // Every tracer gets its own generation, so that thread-local caches of a stopped tracer
+    // are never reused by the next one
+    static inline uint64_t next_generation_ = 1u;
+
+    TracerOptions options_;
+    uint64_t generation_ = 0u;
+    Clock::time_point origin_;
+    bool first_event_ = true;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadState>> threads_;
+};
+
+// Guard placed around Mython calls. Does nothing unless tracing is on
+class CallScope {
+public:
+    CallScope(const std::string& class_name, const std::string& method_name, size_t arity,
+              CallKind kind) {
+        if (Tracer* tracer = Tracer::Active())
+        {
+            tracer_ = tracer;
+            tracer->Enter(class_name, method_name, arity, kind);
+        }
+    }
+
+    CallScope(const CallScope&) = delete;
+    CallScope& operator=(const CallScope&) = delete;
+
+    ~CallScope() {
+        if (tracer_ != nullptr)
+        {
+            tracer_->Leave();
+        }
+    }
+
+private:
+    Tracer* tracer_ = nullptr;
+};
+
+}  // namespace trace
@@ -0,0 +1,117 @@
+#include "statement.h"
+#include "tracer.h"
+
+#include "test_program_p.h"
+#include "test_runner_p.h"
+
+#include <functional>
+
+using namespace std;
+
+namespace trace {
+
+namespace {
+
+const string PROGRAM = R"(
+class Leaf:
+  def __init__(value):
+    self.value = value
+
+  def get():
+    return self.value
+
+class Tree:
+  def make(n):
+    leaf = Leaf(n)
+    return leaf.get()
+
+t = Tree()
+print t.make(1) + t.make(2)
+)"s;
+
+void RunTraced(Tracer& tracer, const function<void()>& on_stop = {}) {
+    runtime::DummyContext context;
+    RunOptions options;
+    options.before = [&tracer](runtime::Executable& /*program*/) {
+        tracer.Start();
+    };
+    options.executed = [&tracer](runtime::Closure& /*globals*/) {
+        tracer.Stop();
+    };
+    options.after = on_stop;
+    ExecuteProgram(PROGRAM, context, options);
+    ASSERT_EQUAL(context.output.str(), "3\n"s);
+}
+
+size_t CountOccurrences(const string& text, const string& pattern) {
+    size_t count = 0u;
+    for (size_t pos = text.find(pattern); pos != string::npos; pos = text.find(pattern, pos + 1u))
+    {
+        ++count;
+    }
+    return count;
+}
+
+void TestChromeTrace() {
+    ostringstream json;
+    TracerOptions options;
+    options.chrome_trace = &json;
+    options.buffer_capacity = 2u;
+    {
+        Tracer tracer(options);
+        RunTraced(tracer);
+        ASSERT(Tracer::Active() == nullptr);
+    }
+
+    const string trace = json.str();
+    ASSERT(trace.rfind("{\"traceEvents\":["s, 0) == 0u);
+    ASSERT_EQUAL(CountOccurrences(trace, "\"ph\":\"X\""s), 9u);
+    ASSERT_EQUAL(CountOccurrences(trace, "\"name\":\"Tree.make\""s), 2u);
+    ASSERT_EQUAL(CountOccurrences(trace, "\"name\":\"Leaf.<new>\",\"cat\":\"new\""s), 2u);
+    ASSERT_EQUAL(CountOccurrences(trace, "\"name\":\"Leaf.__init__\""s), 2u);
+    ASSERT(trace.find("\"name\":\"Leaf.get\",\"cat\":\"call\""s) != string::npos);
+    ASSERT(trace.find("\"args\":{\"arity\":1,\"depth\":2}"s) != string::npos);
+}
+
+void TestThreshold() {
+    ostringstream json;
+    TracerOptions options;
+    options.chrome_trace = &json;
+    options.threshold = chrono::hours(1);
+    Tracer tracer(options);
+    RunTraced(tracer);
+
+    ASSERT_EQUAL(CountOccurrences(json.str(), "\"ph\":\"X\""s), 0u);
+}
+
+void TestFoldedStacks() {
+    Tracer tracer(TracerOptions{});
+    ostringstream folded;
+    RunTraced(tracer, [&tracer, &folded] {
+        tracer.WriteFoldedStacks(folded);
+    });
+
+    // Each line is "<stack> <self time in us>". Calls shorter than a microsecond are omitted,
+    // so only check that every reported stack is a real one. leaf.get() is a tail call, it runs
+    // after Tree.make has returned
+    const set<string> expected = {"Tree.<new>"s, "Tree.make"s, "Tree.make;Leaf.<new>"s,
+                                  "Tree.make;Leaf.<new>;Leaf.__init__"s, "Leaf.get"s};
+    istringstream lines(folded.str());
+    size_t count = 0u;
+    for (string stack, time; lines >> stack >> time; ++count)
+    {
+        ASSERT(expected.count(stack) == 1u);
+        ASSERT(stoll(time) > 0);
+    }
+    ASSERT(count > 0u);
+}
+
+}  // namespace
+
+void RunTracerTests(TestRunner& tr) {
+    RUN_TEST(tr, trace::TestChromeTrace);
+    RUN_TEST(tr, trace::TestThreshold);
+    RUN_TEST(tr, trace::TestFoldedStacks);
+}
+
+}  // namespace trace